@@ -0,0 +1,145 @@
+#include "file_loader.h"
+#include <stdio.h>
+#include <string.h>
+#include <utility>
+#if defined(__unix__) || defined(__APPLE__)
+#define FILE_LOADER_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+mapped_file::mapped_file()
+  : m_data(NULL), m_size(0), m_mapped(false), m_open(false)
+{
+}
+
+mapped_file::~mapped_file()
+{
+  close();
+}
+
+mapped_file::mapped_file(mapped_file&& other)
+  : m_data(NULL), m_size(0), m_mapped(false), m_open(false)
+{
+  *this = std::move(other);
+}
+
+mapped_file& mapped_file::operator=(mapped_file&& other)
+{
+  if (this != &other) {
+    close();
+    // moving the vector keeps its heap block, so m_data stays valid
+    m_buffer = std::move(other.m_buffer);
+    m_data = other.m_data;
+    m_size = other.m_size;
+    m_mapped = other.m_mapped;
+    m_open = other.m_open;
+    other.m_data = NULL;
+    other.m_size = 0;
+    other.m_mapped = false;
+    other.m_open = false;
+  }
+  return *this;
+}
+
+/* reads to the end, however long that is. hint is the size a regular file
+reported; /proc files and pipes report 0 and the buffer grows as they go.
+buffer is a std::vector<char> or a std::string */
+template <typename T> static bool read_all(FILE* file, size_t hint, T* buffer)
+{
+  buffer->resize(hint);
+  size_t used = fread(buffer->data(), 1, hint, file);
+  int c;
+  while (used == buffer->size() && (c = fgetc(file)) != EOF) {
+    buffer->resize(buffer->size() * 2 + 4096);
+    (*buffer)[used++] = (char)c;
+    used += fread(buffer->data() + used, 1, buffer->size() - used, file);
+  }
+  bool failed = ferror(file) != 0;
+  buffer->resize(used);
+  buffer->shrink_to_fit();
+  return !failed;
+}
+
+bool mapped_file::open(const char* path)
+{
+  close();
+  size_t hint = 0;
+#if defined(FILE_LOADER_HAVE_MMAP)
+  int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    hint = (size_t)st.st_size;
+    void* p = mmap(NULL, hint, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED) {
+      // the mapping holds its own reference to the file
+      ::close(fd);
+      m_data = (const char*)p;
+      m_size = hint;
+      m_mapped = true;
+      m_open = true;
+      return true;
+    }
+  }
+  ::close(fd);
+#endif
+  FILE* file = fopen(path, "rb");
+  if (!file) {
+    return false;
+  }
+  bool ok = read_all(file, hint, &m_buffer);
+  fclose(file);
+  if (!ok) {
+    m_buffer.clear();
+    return false;
+  }
+  m_data = m_buffer.data();
+  m_size = m_buffer.size();
+  m_open = true;
+  return true;
+}
+
+void mapped_file::close()
+{
+#if defined(FILE_LOADER_HAVE_MMAP)
+  if (m_mapped) {
+    munmap((void*)m_data, m_size);
+  }
+#endif
+  m_buffer.clear();
+  m_buffer.shrink_to_fit();
+  m_data = NULL;
+  m_size = 0;
+  m_mapped = false;
+  m_open = false;
+}
+
+/* read straight into the string, never mapped: shader sources are saved in
+place by editors while the watcher reloads them, and a mapped file cut short
+mid-copy would fault instead of just reading short */
+bool load_text_file(const char* path, std::string* text)
+{
+  FILE* file = fopen(path, "rb");
+  if (!file) {
+    return false;
+  }
+  size_t hint = 0;
+  if (fseek(file, 0, SEEK_END) == 0) {
+    long size = ftell(file);
+    hint = size > 0 ? (size_t)size : 0;
+    rewind(file);
+  }
+  std::string buffer;
+  bool ok = read_all(file, hint, &buffer);
+  fclose(file);
+  if (!ok) {
+    return false;
+  }
+  text->swap(buffer);
+  return true;
+}
@@ -0,0 +1,53 @@
+#ifndef _FILE_LOADER_H
+#define _FILE_LOADER_H
+
+#include <stddef.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* whole files, with no size limit. mapped_file maps a file read-only and
+view() points straight at the page cache, so nothing is copied until it is
+read. files that can't be mapped (pipes, /proc entries, empty files, systems
+without mmap) are read into a buffer of exactly their size instead. either
+way the bytes are not NUL-terminated; use size(). the view lasts until
+close() or the destructor.
+a mapping shares its pages with the file. a file cut shorter in place while
+mapped makes reads past its new end fault, so only keep a mapping of files
+that get replaced by rename (the program cache, rotated logs). text that is
+edited in place while it's being read, like shader sources that are
+hot-reloaded, goes through load_text_file, which reads it with plain stdio
+and never maps it. */
+class mapped_file
+{
+public:
+  mapped_file();
+  ~mapped_file();
+  mapped_file(mapped_file&& other);
+  mapped_file& operator=(mapped_file&& other);
+  mapped_file(const mapped_file&) = delete;
+  mapped_file& operator=(const mapped_file&) = delete;
+
+  // false when the file can't be opened or read, errno says why
+  bool open(const char* path);
+  void close();
+  bool is_open() const { return m_open; }
+  const char* data() const { return m_data; }
+  size_t size() const { return m_size; }
+  std::string_view view() const { return std::string_view(m_data, m_size); }
+  // data() is the mapping itself, not a copy
+  bool is_mapped() const { return m_mapped; }
+
+private:
+  const char* m_data;
+  size_t m_size;
+  bool m_mapped;
+  bool m_open;
+  std::vector<char> m_buffer; // the copy when the file isn't mapped
+};
+
+// replaces text with the whole file, read rather than mapped. false when it
+// can't be read, and text is left alone
+bool load_text_file(const char* path, std::string* text);
+
+#endif
@@ -0,0 +1,436 @@
+#include "frame_capture.h"
+#include "logging.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct capture_slot
+{
+  GLuint pbo;
+  GLsync fence;
+  long frame;
+};
+
+struct captured_frame
+{
+  std::vector<unsigned char>* pixels; // rgba, bottom row first
+  long frame;
+};
+
+// GL thread only
+static bool g_active = false;
+static capture_slot g_slots[CAPTURE_RING_SIZE];
+static int g_next_slot = 0;
+static int g_pending = 0;
+static long g_frame = 0;
+static long g_stalls = 0; // waits on the GPU or on the writer
+
+static capture_format g_format = CAPTURE_RAW;
+static char g_path[512];
+static int g_width = 0;
+static int g_height = 0;
+
+/* frames go GL thread -> g_queue -> writer thread -> g_free -> GL thread.
+there are a few more buffers than ring slots so the writer can run a frame or
+two behind before capture_frame has to wait for it */
+static std::mutex g_mutex;
+static std::condition_variable g_queued;
+static std::condition_variable g_freed;
+static std::deque<captured_frame> g_queue;
+static std::vector<std::vector<unsigned char>*> g_free;
+static std::vector<std::vector<unsigned char>*> g_buffers;
+static std::thread* g_writer = NULL;
+static bool g_stop = false;
+
+// writer thread only
+static FILE* g_raw = NULL;
+static std::vector<unsigned char> g_rgb;
+static std::vector<unsigned char> g_encoded;
+static long g_written = 0;
+static double g_write_seconds = 0.0;
+
+/* upright rgb24 rows from bottom-up rgba */
+static void to_rgb(const unsigned char* rgba)
+{
+  g_rgb.resize((size_t)g_width * g_height * 3);
+  for (int y = 0; y < g_height; y++) {
+    const unsigned char* src = rgba + (size_t)(g_height - 1 - y) * g_width * 4;
+    unsigned char* dst = g_rgb.data() + (size_t)y * g_width * 3;
+    for (int x = 0; x < g_width; x++) {
+      dst[x * 3 + 0] = src[x * 4 + 0];
+      dst[x * 3 + 1] = src[x * 4 + 1];
+      dst[x * 3 + 2] = src[x * 4 + 2];
+    }
+  }
+}
+
+static uint32_t crc32_update(uint32_t crc, const unsigned char* p, size_t n)
+{
+  static uint32_t table[256];
+  static bool have_table = false;
+  if (!have_table) {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++) {
+	c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      }
+      table[i] = c;
+    }
+    have_table = true;
+  }
+  for (size_t i = 0; i < n; i++) {
+    crc = table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+static void put_u32_be(std::vector<unsigned char>& out, uint32_t v)
+{
+  unsigned char b[4] = {(unsigned char)(v >> 24), (unsigned char)(v >> 16),
+			(unsigned char)(v >> 8), (unsigned char)v};
+  out.insert(out.end(), b, b + 4);
+}
+
+static void put_png_chunk(std::vector<unsigned char>& out, const char* type,
+			  const unsigned char* data, size_t n)
+{
+  put_u32_be(out, (uint32_t)n);
+  size_t start = out.size();
+  out.insert(out.end(), type, type + 4);
+  out.insert(out.end(), data, data + n);
+  put_u32_be(out, crc32_update(0xffffffffu, out.data() + start, n + 4) ^
+	     0xffffffffu);
+}
+
+/* rgb24 png, filter type 0 on every row, zlib stream of stored blocks. big
+files, but encoding is a memcpy so the writer keeps up with the renderer */
+static void encode_png()
+{
+  std::vector<unsigned char> raw;
+  size_t row = (size_t)g_width * 3;
+  raw.reserve((row + 1) * g_height);
+  for (int y = 0; y < g_height; y++) {
+    raw.push_back(0);
+    raw.insert(raw.end(), g_rgb.data() + row * y, g_rgb.data() + row * (y + 1));
+  }
+
+  std::vector<unsigned char> z;
+  z.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+  z.push_back(0x78);
+  z.push_back(0x01);
+  size_t pos = 0;
+  do {
+    size_t n = raw.size() - pos < 65535 ? raw.size() - pos : 65535;
+    z.push_back(pos + n == raw.size() ? 1 : 0); // BFINAL, BTYPE 00
+    z.push_back((unsigned char)n);
+    z.push_back((unsigned char)(n >> 8));
+    z.push_back((unsigned char)~n);
+    z.push_back((unsigned char)(~n >> 8));
+    z.insert(z.end(), raw.begin() + pos, raw.begin() + pos + n);
+    pos += n;
+  } while (pos < raw.size());
+  // adler32. 5552 bytes is the most that can be summed before b overflows
+  uint32_t a = 1, b = 0;
+  for (size_t i = 0; i < raw.size();) {
+    size_t end = raw.size() - i < 5552 ? raw.size() : i + 5552;
+    for (; i < end; i++) {
+      a += raw[i];
+      b += a;
+    }
+    a %= 65521;
+    b %= 65521;
+  }
+  put_u32_be(z, (b << 16) | a);
+
+  static const unsigned char signature[8] = {0x89, 'P', 'N', 'G',
+					     '\r', '\n', 0x1a, '\n'};
+  g_encoded.assign(signature, signature + 8);
+  std::vector<unsigned char> ihdr;
+  put_u32_be(ihdr, (uint32_t)g_width);
+  put_u32_be(ihdr, (uint32_t)g_height);
+  const unsigned char rest[5] = {8, 2, 0, 0, 0}; // 8 bit rgb
+  ihdr.insert(ihdr.end(), rest, rest + 5);
+  put_png_chunk(g_encoded, "IHDR", ihdr.data(), ihdr.size());
+  put_png_chunk(g_encoded, "IDAT", z.data(), z.size());
+  put_png_chunk(g_encoded, "IEND", NULL, 0);
+}
+
+static void encode_ppm()
+{
+  char header[64];
+  int n = snprintf(header, sizeof(header), "P6\n%i %i\n255\n", g_width,
+		   g_height);
+  g_encoded.assign(header, header + n);
+  g_encoded.insert(g_encoded.end(), g_rgb.begin(), g_rgb.end());
+}
+
+static void write_frame(const captured_frame& f)
+{
+  auto started = std::chrono::steady_clock::now();
+  to_rgb(f.pixels->data());
+  if (CAPTURE_RAW == g_format) {
+    if (g_raw && fwrite(g_rgb.data(), 1, g_rgb.size(), g_raw) != g_rgb.size()) {
+      gl_log_err("ERROR: capture: writing frame %li to %s\n", f.frame, g_path);
+    }
+  } else {
+    if (CAPTURE_PNG == g_format) {
+      encode_png();
+    } else {
+      encode_ppm();
+    }
+    char name[600];
+    snprintf(name, sizeof(name), g_path, (int)f.frame);
+    FILE* file = fopen(name, "wb");
+    if (!file) {
+      gl_log_err("ERROR: capture: could not open %s\n", name);
+    } else {
+      if (fwrite(g_encoded.data(), 1, g_encoded.size(), file) != g_encoded.size()) {
+	gl_log_err("ERROR: capture: writing %s\n", name);
+      }
+      fclose(file);
+    }
+  }
+  g_written++;
+  g_write_seconds += std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - started).count();
+}
+
+static void writer_main()
+{
+  std::unique_lock<std::mutex> lock(g_mutex);
+  for (;;) {
+    g_queued.wait(lock, [] { return g_stop || !g_queue.empty(); });
+    if (g_queue.empty()) {
+      break;
+    }
+    captured_frame f = g_queue.front();
+    g_queue.pop_front();
+    lock.unlock();
+    write_frame(f);
+    lock.lock();
+    g_free.push_back(f.pixels);
+    g_freed.notify_one();
+  }
+}
+
+/* maps the oldest slot and queues its pixels for the writer. with wait false
+it gives up if the GPU hasn't finished the copy yet */
+static bool retire_oldest(bool wait)
+{
+  capture_slot& slot = g_slots[(g_next_slot - g_pending + CAPTURE_RING_SIZE) %
+			       CAPTURE_RING_SIZE];
+  if (GL_TIMEOUT_EXPIRED == glClientWaitSync(slot.fence, 0, 0)) {
+    if (!wait) {
+      return false;
+    }
+    g_stalls++;
+    while (GL_TIMEOUT_EXPIRED == glClientWaitSync(slot.fence,
+						  GL_SYNC_FLUSH_COMMANDS_BIT,
+						  1000000000ull)) {
+    }
+  }
+  glDeleteSync(slot.fence);
+  slot.fence = 0;
+  g_pending--;
+
+  std::vector<unsigned char>* pixels;
+  {
+    std::unique_lock<std::mutex> lock(g_mutex);
+    if (g_free.empty()) {
+      g_stalls++;
+      g_freed.wait(lock, [] { return !g_free.empty(); });
+    }
+    pixels = g_free.back();
+    g_free.pop_back();
+  }
+  size_t size = (size_t)g_width * g_height * 4;
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+  const void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size,
+					GL_MAP_READ_BIT);
+  if (mapped) {
+    memcpy(pixels->data(), mapped, size);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  } else {
+    gl_log_err("ERROR: capture: could not map the buffer for frame %li\n",
+	       slot.frame);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  std::lock_guard<std::mutex> lock(g_mutex);
+  g_queue.push_back({pixels, slot.frame});
+  g_queued.notify_one();
+  return true;
+}
+
+/* the frame number is printed with path as the format, so it must take
+exactly one int: one of %d %i %u %o %x %X with flags, width and precision
+but no '*' or length modifier. %% is the only other conversion allowed */
+static bool is_frame_pattern(const char* path)
+{
+  int conversions = 0;
+  for (const char* p = path; *p; p++) {
+    if ('%' != *p) {
+      continue;
+    }
+    p++;
+    if ('%' == *p) {
+      continue;
+    }
+    p += strspn(p, "-+ #0");
+    p += strspn(p, "0123456789");
+    if ('.' == *p) {
+      p++;
+      p += strspn(p, "0123456789");
+    }
+    if (!*p || !strchr("diuoxX", *p)) {
+      return false;
+    }
+    conversions++;
+  }
+  return 1 == conversions;
+}
+
+bool start_capture(const char* path, capture_format format, int width,
+		   int height)
+{
+  if (g_active) {
+    stop_capture();
+  }
+  if (!path || strlen(path) >= sizeof(g_path) || width <= 0 || height <= 0) {
+    gl_log_err("ERROR: capture: bad path or size\n");
+    return false;
+  }
+  if (CAPTURE_RAW != format && !is_frame_pattern(path)) {
+    gl_log_err("ERROR: capture: %s needs exactly one int conversion for the "
+	       "frame number, like %%05d, and no other %% but %%%%\n", path);
+    return false;
+  }
+  strcpy(g_path, path);
+  g_format = format;
+  g_width = width;
+  g_height = height;
+  if (CAPTURE_RAW == format) {
+    if (strcmp(path, "-") == 0) {
+      // the frames get stdout to themselves, printf output goes to stderr
+      fflush(stdout);
+      int fd = dup(1);
+      if (fd >= 0 && dup2(2, 1) >= 0) {
+	g_raw = fdopen(fd, "wb");
+      }
+    } else {
+      g_raw = fopen(path, "wb");
+    }
+    if (!g_raw) {
+      gl_log_err("ERROR: capture: could not open %s\n", path);
+      return false;
+    }
+  }
+
+  size_t size = (size_t)width * height * 4;
+  for (int i = 0; i < CAPTURE_RING_SIZE; i++) {
+    glGenBuffers(1, &g_slots[i].pbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, g_slots[i].pbo);
+    glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+    g_slots[i].fence = 0;
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  for (int i = 0; i < CAPTURE_RING_SIZE + 2; i++) {
+    g_buffers.push_back(new std::vector<unsigned char>(size));
+  }
+  g_free = g_buffers;
+  g_next_slot = 0;
+  g_pending = 0;
+  g_frame = 0;
+  g_stalls = 0;
+  g_written = 0;
+  g_write_seconds = 0.0;
+  g_stop = false;
+  g_writer = new std::thread(writer_main);
+  g_active = true;
+  gl_log("capture: %ix%i %s to %s\n", width, height,
+	 CAPTURE_PNG == format ? "png" : CAPTURE_PPM == format ? "ppm" : "raw rgb24",
+	 path);
+  return true;
+}
+
+bool start_capture(const char* path, int width, int height)
+{
+  const char* ext = path ? strrchr(path, '.') : NULL;
+  capture_format format = CAPTURE_RAW;
+  if (ext && strcmp(ext, ".png") == 0) {
+    format = CAPTURE_PNG;
+  } else if (ext && strcmp(ext, ".ppm") == 0) {
+    format = CAPTURE_PPM;
+  }
+  return start_capture(path, format, width, height);
+}
+
+bool capture_active()
+{
+  return g_active;
+}
+
+void capture_frame()
+{
+  if (!g_active) {
+    return;
+  }
+  if (CAPTURE_RING_SIZE == g_pending) {
+    retire_oldest(true);
+  }
+  capture_slot& slot = g_slots[g_next_slot];
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  // rgba/ubyte is the layout drivers can copy without converting
+  glReadPixels(0, 0, g_width, g_height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  slot.frame = g_frame++;
+  g_next_slot = (g_next_slot + 1) % CAPTURE_RING_SIZE;
+  g_pending++;
+  // anything the GPU already finished can go to the writer now
+  while (g_pending > 0 && retire_oldest(false)) {
+  }
+}
+
+void stop_capture()
+{
+  if (!g_active) {
+    return;
+  }
+  while (g_pending > 0) {
+    retire_oldest(true);
+  }
+  {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_stop = true;
+    g_queued.notify_one();
+  }
+  g_writer->join();
+  delete g_writer;
+  g_writer = NULL;
+
+  for (int i = 0; i < CAPTURE_RING_SIZE; i++) {
+    glDeleteBuffers(1, &g_slots[i].pbo);
+  }
+  for (size_t i = 0; i < g_buffers.size(); i++) {
+    delete g_buffers[i];
+  }
+  g_buffers.clear();
+  g_free.clear();
+  if (g_raw) {
+    fclose(g_raw);
+    g_raw = NULL;
+  }
+  g_active = false;
+  gl_log("capture: %li frames written, %.2f ms each to encode and write, "
+	 "%li stalls\n", g_written,
+	 g_written ? g_write_seconds * 1000.0 / g_written : 0.0, g_stalls);
+}
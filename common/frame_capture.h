@@ -0,0 +1,39 @@
+#ifndef _FRAME_CAPTURE_H
+#define _FRAME_CAPTURE_H
+
+#include <GL/glew.h>
+
+/* copies rendered frames to disk without stalling the GL pipeline.
+capture_frame reads the current read framebuffer (the back buffer, or the
+headless FBO) into one of a ring of pixel-pack buffers and fences it; the copy
+finishes while the next frames are drawn. only once a buffer comes round
+again is it mapped and its pixels handed to a writer thread that flips them
+upright, drops alpha and encodes them.
+if the writer falls behind, capture_frame waits for it rather than dropping
+frames, so every frame of a run ends up on disk.
+
+CAPTURE_PNG and CAPTURE_PPM write one file per frame: the path is a printf
+pattern with an int for the frame number, e.g. "out/cam_%05d.png". any other
+conversion but %% fails start_capture, as does a second one. PNGs are
+stored uncompressed (no zlib dependency). CAPTURE_RAW appends tightly packed
+top-down rgb24 frames to a single file, or to stdout when the path is "-"
+(anything else printed to stdout goes to stderr from then on):
+  GL_CAPTURE=- ./cam | ffmpeg -f rawvideo -pix_fmt rgb24 -s 640x480 -i - out.mp4
+start_gl starts a capture when the GL_CAPTURE environment variable holds a
+path, picking the format from its extension (.png, .ppm, anything else raw),
+and gl_end_frame captures each frame. */
+#define CAPTURE_RING_SIZE 3 // frames in flight between glReadPixels and map
+
+enum capture_format { CAPTURE_PNG, CAPTURE_PPM, CAPTURE_RAW };
+
+// width x height from the bottom left corner of the read framebuffer
+bool start_capture(const char* path, capture_format format, int width, int height);
+// format from path's extension
+bool start_capture(const char* path, int width, int height);
+bool capture_active();
+// queue a readback of the frame just drawn. call before swapping
+void capture_frame();
+// writes out every queued frame, then stops the writer thread
+void stop_capture();
+
+#endif
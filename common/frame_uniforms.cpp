@@ -0,0 +1,59 @@
+#include "frame_uniforms.h"
+#include "logging.h"
+#include "shader_program.h"
+#include "stream_buffer.h"
+
+static stream_buffer g_stream;
+static GLsizeiptr g_align = 0; // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+
+bool start_frame_uniforms()
+{
+  if (g_stream.buffer()) {
+    return true;
+  }
+  // each frame's copy is bound at its own offset, which has to be aligned
+  g_align = stream_buffer::uniform_alignment();
+  GLsizeiptr slice = ((GLsizeiptr)sizeof(frame_block) + g_align - 1) /
+    g_align * g_align;
+  if (!g_stream.create(slice)) {
+    return false;
+  }
+  set_uniform_block_binding("frame_block", FRAME_UBO_BINDING,
+			    sizeof(frame_block));
+  gl_log("frame uniforms: %i x %i byte slices at binding %i\n",
+	 STREAM_BUFFER_FRAMES, (int)slice, FRAME_UBO_BINDING);
+  return true;
+}
+
+void update_frame_uniforms(const frame_block& frame)
+{
+  if (!g_stream.buffer()) {
+    return;
+  }
+  g_stream.next_frame();
+  GLintptr offset = g_stream.push(&frame, sizeof(frame_block), g_align);
+  if (offset < 0) {
+    return;
+  }
+  glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_UBO_BINDING, g_stream.buffer(),
+		    offset, sizeof(frame_block));
+}
+
+void update_frame_uniforms(const mat4& view, const mat4& proj, int width,
+			   int height, float time, float delta_time)
+{
+  frame_block frame;
+  frame.view = view;
+  frame.proj = proj;
+  frame.view_proj = proj * view;
+  frame.viewport = vec4(0.0f, 0.0f, (float)width, (float)height);
+  frame.time = time;
+  frame.delta_time = delta_time;
+  frame.pad[0] = frame.pad[1] = 0.0f;
+  update_frame_uniforms(frame);
+}
+
+void stop_frame_uniforms()
+{
+  g_stream.destroy();
+}
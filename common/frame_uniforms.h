@@ -0,0 +1,55 @@
+#ifndef _FRAME_UNIFORMS_H
+#define _FRAME_UNIFORMS_H
+
+#include <GL/glew.h>
+#include <stddef.h>
+#include "math_funcs.h"
+
+/* per-frame camera data in one uniform buffer shared by every program.
+shaders declare the block as
+
+  layout(std140) uniform frame_block {
+    mat4 view;
+    mat4 proj;
+    mat4 view_proj;
+    vec4 viewport; // x, y, width, height in pixels
+    float time;    // seconds
+    float delta_time;
+  };
+
+and shader_program binds any program that has it to FRAME_UBO_BINDING when
+it is built, checking the block size GL reports against sizeof(frame_block).
+update_frame_uniforms writes the frame's copy into a stream_buffer, so it
+never overwrites data a frame the GPU is still drawing uses, and binds that
+slice. one upload per frame in place of view and proj uniforms set on each
+program. */
+#define FRAME_UBO_BINDING 0
+
+// std140: mat4 is four vec4 columns, vec4 aligns to 16, floats pack after it
+struct frame_block {
+  mat4 view;
+  mat4 proj;
+  mat4 view_proj;
+  vec4 viewport;
+  float time;
+  float delta_time;
+  float pad[2]; // std140 rounds the block up to a multiple of 16
+};
+static_assert(offsetof(frame_block, view) == 0, "std140 layout");
+static_assert(offsetof(frame_block, proj) == 64, "std140 layout");
+static_assert(offsetof(frame_block, view_proj) == 128, "std140 layout");
+static_assert(offsetof(frame_block, viewport) == 192, "std140 layout");
+static_assert(offsetof(frame_block, time) == 208, "std140 layout");
+static_assert(offsetof(frame_block, delta_time) == 212, "std140 layout");
+static_assert(sizeof(frame_block) == 224, "std140 layout");
+
+// needs a current context. also registers "frame_block" with shader_program,
+// so do it before building programs
+bool start_frame_uniforms();
+void update_frame_uniforms(const frame_block& frame);
+// fills in view_proj
+void update_frame_uniforms(const mat4& view, const mat4& proj, int width,
+			   int height, float time, float delta_time);
+void stop_frame_uniforms();
+
+#endif
@@ -0,0 +1,146 @@
+/******************************************************************************\
+| View-frustum culling. See frustum.h                                          |
+\******************************************************************************/
+#include "frustum.h"
+#include "maths_simd.h"
+#include <math.h>
+
+#if defined( MATHS_SIMD_SSE ) && defined( __AVX__ )
+#define FRUSTUM_AVX 1
+#endif
+
+frustum frustum_from_mat4( const mat4& proj_view ) {
+  // rows of the column-major matrix
+  const float* m = proj_view.m;
+  vec4 row[4];
+  for ( int i = 0; i < 4; i++ ) { row[i] = vec4( m[i], m[4 + i], m[8 + i], m[12 + i] ); }
+  // clip space -w <= x,y,z <= w, e.g. left is x + w >= 0
+  frustum f;
+  for ( int axis = 0; axis < 3; axis++ ) {
+    for ( int side = 0; side < 2; side++ ) {
+      float sign = side == 0 ? 1.0f : -1.0f;
+      vec4 p;
+      for ( int j = 0; j < 4; j++ ) { p.v[j] = row[3].v[j] + sign * row[axis].v[j]; }
+      float l = sqrtf( p.v[0] * p.v[0] + p.v[1] * p.v[1] + p.v[2] * p.v[2] );
+      if ( l > 0.0f ) {
+        for ( int j = 0; j < 4; j++ ) { p.v[j] /= l; }
+      }
+      f.planes[axis * 2 + side] = p;
+    }
+  }
+  return f;
+}
+
+bool frustum_sphere_visible( const frustum& f, const vec3& centre, float radius ) {
+  for ( int i = 0; i < FRUSTUM_PLANE_COUNT; i++ ) {
+    const float* p = f.planes[i].v;
+    if ( p[0] * centre.v[0] + p[1] * centre.v[1] + p[2] * centre.v[2] + p[3] + radius < 0.0f ) { return false; }
+  }
+  return true;
+}
+
+bool frustum_aabb_visible( const frustum& f, const vec3& centre, const vec3& extents ) {
+  for ( int i = 0; i < FRUSTUM_PLANE_COUNT; i++ ) {
+    const float* p = f.planes[i].v;
+    // projected half-size of the box onto the plane normal
+    float r = fabsf( p[0] ) * extents.v[0] + fabsf( p[1] ) * extents.v[1] + fabsf( p[2] ) * extents.v[2];
+    if ( p[0] * centre.v[0] + p[1] * centre.v[1] + p[2] * centre.v[2] + p[3] + r < 0.0f ) { return false; }
+  }
+  return true;
+}
+
+/* appends base + k for every set bit k of the visible mask. the store always
+happens and the count only moves for visible lanes, so no branch per element.
+n <= base + k here, so it never writes past the final element */
+static MATHS_FORCE_INLINE int emit_visible( int mask, int base, int lanes, int* visible, int n ) {
+  for ( int k = 0; k < lanes; k++ ) {
+    visible[n] = base + k;
+    n += ( mask >> k ) & 1;
+  }
+  return n;
+}
+
+int cull_spheres( const frustum& f, const vec3_soa& centres, const float* radii, int* visible ) {
+  int count = centres.count, i = 0, n = 0;
+#if defined( FRUSTUM_AVX )
+  for ( ; i + 8 <= count; i += 8 ) {
+    __m256 x = _mm256_loadu_ps( centres.x + i ), y = _mm256_loadu_ps( centres.y + i ), z = _mm256_loadu_ps( centres.z + i );
+    __m256 r       = _mm256_loadu_ps( radii + i );
+    __m256 zero    = _mm256_setzero_ps();
+    __m256 outside = zero;
+    for ( int p = 0; p < FRUSTUM_PLANE_COUNT; p++ ) {
+      const float* pl = f.planes[p].v;
+      __m256 d        = _mm256_add_ps( r, _mm256_set1_ps( pl[3] ) );
+      d               = _mm256_add_ps( d, _mm256_mul_ps( x, _mm256_set1_ps( pl[0] ) ) );
+      d               = _mm256_add_ps( d, _mm256_mul_ps( y, _mm256_set1_ps( pl[1] ) ) );
+      d               = _mm256_add_ps( d, _mm256_mul_ps( z, _mm256_set1_ps( pl[2] ) ) );
+      outside         = _mm256_or_ps( outside, _mm256_cmp_ps( d, zero, _CMP_LT_OQ ) );
+    }
+    n = emit_visible( ~_mm256_movemask_ps( outside ) & 0xff, i, 8, visible, n );
+  }
+#endif
+  for ( ; i + 4 <= count; i += 4 ) {
+    simd4f x = simd4f_load( centres.x + i ), y = simd4f_load( centres.y + i ), z = simd4f_load( centres.z + i );
+    simd4f r       = simd4f_load( radii + i );
+    simd4f zero    = simd4f_splat( 0.0f );
+    simd4f outside = simd4f_cmplt( zero, zero ); // all clear
+    for ( int p = 0; p < FRUSTUM_PLANE_COUNT; p++ ) {
+      const float* pl = f.planes[p].v;
+      simd4f d        = simd4f_madd( z, simd4f_splat( pl[2] ), simd4f_madd( y, simd4f_splat( pl[1] ), simd4f_madd( x, simd4f_splat( pl[0] ), simd4f_add( r, simd4f_splat( pl[3] ) ) ) ) );
+      outside         = simd4f_or( outside, simd4f_cmplt( d, zero ) );
+    }
+    n = emit_visible( ~simd4f_movemask( outside ) & 0xf, i, 4, visible, n );
+  }
+  for ( ; i < count; i++ ) {
+    visible[n] = i;
+    n += frustum_sphere_visible( f, vec3( centres.x[i], centres.y[i], centres.z[i] ), radii[i] ) ? 1 : 0;
+  }
+  return n;
+}
+
+int cull_aabbs( const frustum& f, const vec3_soa& centres, const vec3_soa& extents, int* visible ) {
+  int count = centres.count, i = 0, n = 0;
+  // |normal| per plane, so the box radius is one dot product with the extents
+  float abs_n[FRUSTUM_PLANE_COUNT][3];
+  for ( int p = 0; p < FRUSTUM_PLANE_COUNT; p++ ) {
+    for ( int j = 0; j < 3; j++ ) { abs_n[p][j] = fabsf( f.planes[p].v[j] ); }
+  }
+#if defined( FRUSTUM_AVX )
+  for ( ; i + 8 <= count; i += 8 ) {
+    __m256 x = _mm256_loadu_ps( centres.x + i ), y = _mm256_loadu_ps( centres.y + i ), z = _mm256_loadu_ps( centres.z + i );
+    __m256 ex = _mm256_loadu_ps( extents.x + i ), ey = _mm256_loadu_ps( extents.y + i ), ez = _mm256_loadu_ps( extents.z + i );
+    __m256 zero    = _mm256_setzero_ps();
+    __m256 outside = zero;
+    for ( int p = 0; p < FRUSTUM_PLANE_COUNT; p++ ) {
+      const float* pl = f.planes[p].v;
+      __m256 d        = _mm256_set1_ps( pl[3] );
+      d               = _mm256_add_ps( d, _mm256_mul_ps( x, _mm256_set1_ps( pl[0] ) ) );
+      d               = _mm256_add_ps( d, _mm256_mul_ps( y, _mm256_set1_ps( pl[1] ) ) );
+      d               = _mm256_add_ps( d, _mm256_mul_ps( z, _mm256_set1_ps( pl[2] ) ) );
+      d               = _mm256_add_ps( d, _mm256_mul_ps( ex, _mm256_set1_ps( abs_n[p][0] ) ) );
+      d               = _mm256_add_ps( d, _mm256_mul_ps( ey, _mm256_set1_ps( abs_n[p][1] ) ) );
+      d               = _mm256_add_ps( d, _mm256_mul_ps( ez, _mm256_set1_ps( abs_n[p][2] ) ) );
+      outside         = _mm256_or_ps( outside, _mm256_cmp_ps( d, zero, _CMP_LT_OQ ) );
+    }
+    n = emit_visible( ~_mm256_movemask_ps( outside ) & 0xff, i, 8, visible, n );
+  }
+#endif
+  for ( ; i + 4 <= count; i += 4 ) {
+    simd4f x = simd4f_load( centres.x + i ), y = simd4f_load( centres.y + i ), z = simd4f_load( centres.z + i );
+    simd4f ex = simd4f_load( extents.x + i ), ey = simd4f_load( extents.y + i ), ez = simd4f_load( extents.z + i );
+    simd4f zero    = simd4f_splat( 0.0f );
+    simd4f outside = simd4f_cmplt( zero, zero ); // all clear
+    for ( int p = 0; p < FRUSTUM_PLANE_COUNT; p++ ) {
+      const float* pl = f.planes[p].v;
+      simd4f r        = simd4f_madd( ez, simd4f_splat( abs_n[p][2] ), simd4f_madd( ey, simd4f_splat( abs_n[p][1] ), simd4f_mul( ex, simd4f_splat( abs_n[p][0] ) ) ) );
+      simd4f d        = simd4f_madd( z, simd4f_splat( pl[2] ), simd4f_madd( y, simd4f_splat( pl[1] ), simd4f_madd( x, simd4f_splat( pl[0] ), simd4f_add( r, simd4f_splat( pl[3] ) ) ) ) );
+      outside         = simd4f_or( outside, simd4f_cmplt( d, zero ) );
+    }
+    n = emit_visible( ~simd4f_movemask( outside ) & 0xf, i, 4, visible, n );
+  }
+  for ( ; i < count; i++ ) {
+    visible[n] = i;
+    n += frustum_aabb_visible( f, vec3( centres.x[i], centres.y[i], centres.z[i] ), vec3( extents.x[i], extents.y[i], extents.z[i] ) ) ? 1 : 0;
+  }
+  return n;
+}
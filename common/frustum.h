@@ -0,0 +1,37 @@
+/******************************************************************************\
+| View-frustum culling                                                         |
+| frustum_from_mat4 pulls the 6 clip planes out of a projection * view matrix  |
+| (Gribb & Hartmann). Planes are normalised and face inwards, so for a point p |
+| dot( plane.xyz, p ) + plane.w is its signed distance inside that plane.      |
+| The cull_ functions test whole arrays of bounding volumes held in vec3_soa   |
+| streams, 4 at a time (8 with AVX), and write the indices of the ones that    |
+| are at least partly inside to visible[] in ascending order. They return how  |
+| many were written. visible needs room for centres.count ints.                |
+| The tests are conservative: a volume that straddles two planes outside a     |
+| frustum corner can be kept, but nothing on screen is ever dropped.           |
+\******************************************************************************/
+#ifndef _FRUSTUM_H_
+#define _FRUSTUM_H_
+
+#include "math_funcs.h"
+#include "vec3_soa.h"
+
+enum frustum_plane { FRUSTUM_LEFT = 0, FRUSTUM_RIGHT, FRUSTUM_BOTTOM, FRUSTUM_TOP, FRUSTUM_NEAR, FRUSTUM_FAR, FRUSTUM_PLANE_COUNT };
+
+struct frustum {
+  // a, b, c, d of a x + b y + c z + d = 0 in world space (or whatever space
+  // the matrix maps from)
+  vec4 planes[FRUSTUM_PLANE_COUNT];
+};
+
+frustum frustum_from_mat4( const mat4& proj_view );
+
+bool frustum_sphere_visible( const frustum& f, const vec3& centre, float radius );
+// boxes are centre +- extents (half the size on each axis)
+bool frustum_aabb_visible( const frustum& f, const vec3& centre, const vec3& extents );
+
+// radii holds centres.count floats
+int cull_spheres( const frustum& f, const vec3_soa& centres, const float* radii, int* visible );
+int cull_aabbs( const frustum& f, const vec3_soa& centres, const vec3_soa& extents, int* visible );
+
+#endif
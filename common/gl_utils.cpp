@@ -1,4 +1,19 @@
 #include "gl_utils.h"
+#include "frame_capture.h"
+#include "shader_watch.h"
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#if defined(GL_UTILS_HAVE_EGL)
+// only the platform-independent EGL types, no X11 headers
+#define EGL_NO_X11
+#define MESA_EGL_NO_X11_HEADERS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+#endif
 
 /* log glfw errors */
 void glfw_error_callback(int error, const char* description) {
@@ -185,58 +200,238 @@ bool is_valid (GLuint programme) {
   return true;
 }
 
-/* load plain text shader to a character array */
-bool parse_file_into_str(const char* file_name, char* shader_str,
-			 int max_len) {
-  FILE* file = fopen(file_name, "r");
-  if(!file) {
-    gl_log_err("ERROR: opening file for reading: %s\n", file_name);
+void _update_fps_counter(GLFWwindow* window) {
+  static double previous_seconds = gl_get_time();
+  static int frame_count;
+  double current_seconds = gl_get_time();
+  double elapse_seconds = current_seconds - previous_seconds;
+  // no title bar to put it in when headless, so log it once a second
+  if (elapse_seconds > (window ? 0.25 : 1.0)) {
+    previous_seconds = current_seconds;
+    double fps = (double)frame_count / elapse_seconds;
+    if (window) {
+      char tmp[128];
+      sprintf(tmp, "opengl @ fps: %.2f", fps);
+      glfwSetWindowTitle(window, tmp);
+    } else {
+      GL_LOG_INFO("fps", "%.2f fps (%.3f ms/frame)\n", fps,
+		  1000.0 / (fps > 0.0 ? fps : 1.0));
+    }
+    frame_count = 0;
+  }
+  frame_count++;
+}
+
+gl_backend g_gl_backend = GL_BACKEND_WINDOW;
+
+static std::chrono::steady_clock::time_point g_headless_start;
+static long g_headless_frame = 0;
+static long g_headless_frames = 300;
+static bool g_headless_close = false;
+static GLuint g_offscreen_fbo = 0;
+static GLuint g_offscreen_rbos[2] = {0, 0};
+
+#if defined(GL_UTILS_HAVE_EGL)
+static EGLDisplay g_egl_display = EGL_NO_DISPLAY;
+static EGLContext g_egl_context = EGL_NO_CONTEXT;
+static EGLSurface g_egl_surface = EGL_NO_SURFACE;
+
+static bool has_extension(const char* list, const char* name)
+{
+  size_t n = strlen(name);
+  for (const char* p = list; p && (p = strstr(p, name)); p += n) {
+    if ((p == list || p[-1] == ' ') && (p[n] == ' ' || p[n] == 0)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* the surfaceless platform needs no X, wayland or GPU device, so try it
+first. the default display covers drivers without it */
+static EGLDisplay open_egl_display()
+{
+  const char* client = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+    (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+  if (get_platform_display &&
+      has_extension(client, "EGL_MESA_platform_surfaceless")) {
+    EGLDisplay display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+					      EGL_DEFAULT_DISPLAY, NULL);
+    if (display != EGL_NO_DISPLAY && eglInitialize(display, NULL, NULL)) {
+      return display;
+    }
+  }
+  EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  if (display != EGL_NO_DISPLAY && eglInitialize(display, NULL, NULL)) {
+    return display;
+  }
+  return EGL_NO_DISPLAY;
+}
+
+static bool start_egl()
+{
+  g_egl_display = open_egl_display();
+  if (g_egl_display == EGL_NO_DISPLAY) {
+    gl_log_err("ERROR: could not open an EGL display (0x%x)\n", eglGetError());
+    return false;
+  }
+  gl_log("EGL %s %s\n", eglQueryString(g_egl_display, EGL_VENDOR),
+	 eglQueryString(g_egl_display, EGL_VERSION));
+  if (!eglBindAPI(EGL_OPENGL_API)) {
+    gl_log_err("ERROR: EGL has no desktop OpenGL\n");
     return false;
   }
 
-  size_t cnt = fread(shader_str, 1, max_len - 1, file);
-  if ((int)cnt >= max_len -1) {
-    gl_log_err("WARNING: file %s too big - truncated.\n", file_name);
+  // pbuffer capable if possible, any surface type otherwise
+  EGLint config_attribs[] = {
+    EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+    EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+    EGL_NONE
+  };
+  EGLConfig config;
+  EGLint n_configs = 0;
+  if (!eglChooseConfig(g_egl_display, config_attribs, &config, 1, &n_configs) ||
+      n_configs < 1) {
+    config_attribs[1] = 0;
+    if (!eglChooseConfig(g_egl_display, config_attribs, &config, 1,
+			 &n_configs) || n_configs < 1) {
+      gl_log_err("ERROR: no EGL config for desktop OpenGL\n");
+      return false;
+    }
   }
-  if (ferror(file)) {
-    gl_log_err("ERROR: reading shader file %s\n", file_name);
-    fclose(file);
+
+  // same 3.2 core context the window backend asks GLFW for
+  const EGLint context_attribs[] = {
+    EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+    EGL_CONTEXT_MINOR_VERSION_KHR, 2,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+    EGL_NONE
+  };
+  g_egl_context = eglCreateContext(g_egl_display, config, EGL_NO_CONTEXT,
+				   context_attribs);
+  if (g_egl_context == EGL_NO_CONTEXT) {
+    gl_log_err("ERROR: could not create an EGL context (0x%x)\n",
+	       eglGetError());
     return false;
   }
-  // append \0 to end of string
-  shader_str[cnt] = 0;
-  fclose(file);
+
+  // everything is drawn to the FBO, the surface (if any) is never used
+  const char* display_exts = eglQueryString(g_egl_display, EGL_EXTENSIONS);
+  if (!has_extension(display_exts, "EGL_KHR_surfaceless_context") ||
+      !eglMakeCurrent(g_egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+		      g_egl_context)) {
+    const EGLint pbuffer_attribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+    g_egl_surface = eglCreatePbufferSurface(g_egl_display, config,
+					    pbuffer_attribs);
+    if (g_egl_surface == EGL_NO_SURFACE ||
+	!eglMakeCurrent(g_egl_display, g_egl_surface, g_egl_surface,
+			g_egl_context)) {
+      gl_log_err("ERROR: could not make the EGL context current (0x%x)\n",
+		 eglGetError());
+      return false;
+    }
+  }
   return true;
 }
 
-void _update_fps_counter(GLFWwindow* window) {
-  static double previous_seconds = glfwGetTime();
-  static int frame_count;
-  double current_seconds = glfwGetTime();
-  double elapse_seconds = current_seconds - previous_seconds;
-  if (elapse_seconds > 0.25) {
-    previous_seconds = current_seconds;
-    double fps = (double)frame_count / elapse_seconds;
-    char tmp[128];
-    sprintf(tmp, "opengl @ fps: %.2f", fps);
-    glfwSetWindowTitle(window, tmp);
-    frame_count = 0;
+static void stop_egl()
+{
+  if (g_egl_display == EGL_NO_DISPLAY) {
+    return;
   }
-  frame_count++;
+  eglMakeCurrent(g_egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+		 EGL_NO_CONTEXT);
+  if (g_egl_surface != EGL_NO_SURFACE) {
+    eglDestroySurface(g_egl_display, g_egl_surface);
+  }
+  if (g_egl_context != EGL_NO_CONTEXT) {
+    eglDestroyContext(g_egl_display, g_egl_context);
+  }
+  eglTerminate(g_egl_display);
+  g_egl_display = EGL_NO_DISPLAY;
+  g_egl_context = EGL_NO_CONTEXT;
+  g_egl_surface = EGL_NO_SURFACE;
 }
+#endif
 
-bool start_gl() {
+/* colour and depth renderbuffers standing in for the window's back buffer */
+static bool create_offscreen_fbo()
+{
+  glGenRenderbuffers(2, g_offscreen_rbos);
+  glBindRenderbuffer(GL_RENDERBUFFER, g_offscreen_rbos[0]);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, g_gl_width, g_gl_height);
+  glBindRenderbuffer(GL_RENDERBUFFER, g_offscreen_rbos[1]);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, g_gl_width,
+			g_gl_height);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  glGenFramebuffers(1, &g_offscreen_fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, g_offscreen_fbo);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+			    GL_RENDERBUFFER, g_offscreen_rbos[0]);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+			    GL_RENDERBUFFER, g_offscreen_rbos[1]);
+  GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  if (GL_FRAMEBUFFER_COMPLETE != status) {
+    gl_log_err("ERROR: offscreen framebuffer incomplete (0x%x)\n", status);
+    return false;
+  }
+  glViewport(0, 0, g_gl_width, g_gl_height);
+  return true;
+}
 
+static bool start_headless()
+{
+#if defined(GL_UTILS_HAVE_EGL)
+  gl_log("starting headless EGL context %ix%i\n", g_gl_width, g_gl_height);
+  if (!start_egl()) {
+    stop_egl();
+    return false;
+  }
+
+  // glewInit also wants a GLX display, which there isn't one of here
+  glewExperimental = GL_TRUE;
+  GLenum err = glewContextInit();
+  if (GLEW_OK != err) {
+    gl_log_err("ERROR: GLEW: %s\n", glewGetErrorString(err));
+    stop_egl();
+    return false;
+  }
+  // a core context may flag the extension string query glew does
+  while (glGetError() != GL_NO_ERROR) {
+  }
+
+  if (!create_offscreen_fbo()) {
+    stop_gl();
+    return false;
+  }
+
+  const char* frames = getenv("GL_HEADLESS_FRAMES");
+  if (frames) {
+    g_headless_frames = atol(frames);
+  }
+  g_headless_frame = 0;
+  g_headless_close = false;
+  g_headless_start = std::chrono::steady_clock::now();
+  return true;
+#else
+  gl_log_err("ERROR: built without EGL, no headless backend\n");
+  return false;
+#endif
+}
+
+static bool start_window()
+{
   // starg GL context and O/S window using GLFW helper library
   gl_log("starting GLFW\n%s\n", glfwGetVersionString());
   // register the error call-back function we wrote
   glfwSetErrorCallback(glfw_error_callback);
-
-
   
   if (!glfwInit()) {
     fprintf(stderr, "Error: could not start GLFW\n");
-    return -1;
+    return false;
   }
 
   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -262,7 +457,7 @@ bool start_gl() {
   if(!g_window) {
     fprintf(stderr, "Error: could not open window GLFW3\n");
     glfwTerminate();
-    return 1;
+    return false;
   }
 
 
@@ -273,6 +468,29 @@ bool start_gl() {
   // start GLEW extension handler
   glewExperimental = GL_TRUE;
   glewInit();
+  return true;
+}
+
+bool start_gl() {
+  const char* headless = getenv("GL_HEADLESS");
+  bool want_headless = headless && headless[0] && strcmp(headless, "0") != 0;
+  return start_gl(want_headless ? GL_BACKEND_HEADLESS : GL_BACKEND_WINDOW);
+}
+
+bool start_gl(gl_backend backend) {
+  g_gl_backend = backend;
+  bool started = GL_BACKEND_HEADLESS == backend ? start_headless()
+						: start_window();
+  if (!started) {
+    return false;
+  }
+
+  // e.g. GL_CAPTURE=frames/cam_%05d.png, see frame_capture.h. before any
+  // printing, as GL_CAPTURE=- takes stdout over
+  const char* capture = getenv("GL_CAPTURE");
+  if (capture && capture[0]) {
+    start_capture(capture, g_gl_width, g_gl_height);
+  }
 
   // get version info
   const GLubyte* renderer = glGetString (GL_RENDERER);
@@ -283,3 +501,81 @@ bool start_gl() {
   
   return true;
 }
+
+void stop_gl()
+{
+  stop_capture();
+  stop_shader_watch();
+  if (GL_BACKEND_WINDOW == g_gl_backend) {
+    // close GL context and any other GLFW resources
+    glfwTerminate();
+    g_window = NULL;
+    return;
+  }
+  if (g_offscreen_fbo) {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &g_offscreen_fbo);
+    glDeleteRenderbuffers(2, g_offscreen_rbos);
+    g_offscreen_fbo = 0;
+  }
+#if defined(GL_UTILS_HAVE_EGL)
+  stop_egl();
+#endif
+}
+
+GLuint gl_offscreen_fbo()
+{
+  return g_offscreen_fbo;
+}
+
+bool gl_should_close()
+{
+  if (GL_BACKEND_WINDOW == g_gl_backend) {
+    return glfwWindowShouldClose(g_window);
+  }
+  return g_headless_close ||
+    (g_headless_frames > 0 && g_headless_frame >= g_headless_frames);
+}
+
+void gl_request_close()
+{
+  if (GL_BACKEND_WINDOW == g_gl_backend) {
+    glfwSetWindowShouldClose(g_window, 1);
+  } else {
+    g_headless_close = true;
+  }
+}
+
+void gl_end_frame()
+{
+  capture_frame();
+  apply_shader_reloads();
+  if (GL_BACKEND_WINDOW == g_gl_backend) {
+    //update other events like input handling
+    glfwPollEvents();
+    //put the stuff we've been drawing onto the display
+    glfwSwapBuffers(g_window);
+    return;
+  }
+  // nothing to present. flush so the driver starts on the frame now, as a
+  // swap would
+  glFlush();
+  g_headless_frame++;
+}
+
+double gl_get_time()
+{
+  if (GL_BACKEND_WINDOW == g_gl_backend) {
+    return glfwGetTime();
+  }
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+				       g_headless_start).count();
+}
+
+bool gl_key_pressed(int key)
+{
+  if (GL_BACKEND_WINDOW == g_gl_backend) {
+    return GLFW_PRESS == glfwGetKey(g_window, key);
+  }
+  return false;
+}
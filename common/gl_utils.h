@@ -10,7 +10,36 @@ extern int g_gl_width;
 extern int g_gl_height;
 extern GLFWwindow* g_window;
 
+/* where start_gl puts the context. GL_BACKEND_WINDOW is a GLFW window as
+before. GL_BACKEND_HEADLESS needs no display: an EGL context (surfaceless, or
+a 1x1 pbuffer when the driver can't do that) that draws into a
+g_gl_width x g_gl_height framebuffer object, which stays bound. it works on
+Mesa llvmpipe, so CPU-only boxes can run the demos. g_window is NULL there,
+so frame loops should use the gl_ functions below instead of glfw ones.
+start_gl() without an argument is headless when the GL_HEADLESS environment
+variable is set to anything but 0. GL_HEADLESS_FRAMES (default 300, 0 for
+no limit) is how many frames a headless run lasts. */
+enum gl_backend { GL_BACKEND_WINDOW, GL_BACKEND_HEADLESS };
+extern gl_backend g_gl_backend;
+
 bool start_gl();
+bool start_gl(gl_backend backend);
+// destroys the context and window (glfwTerminate for the window backend)
+void stop_gl();
+// the headless colour + depth target, 0 with a window
+GLuint gl_offscreen_fbo();
+
+// frame loop for either backend
+bool gl_should_close();
+void gl_request_close();
+// swaps buffers and polls events, or in headless mode counts the frame.
+// also hands the frame to frame_capture when a capture is running and swaps
+// in shaders hot-reloaded by shader_watch
+void gl_end_frame();
+// seconds since start_gl
+double gl_get_time();
+// always false in headless mode
+bool gl_key_pressed(int key);
 void glfw_error_callback(int, const char*);
 void glfw_window_size_callback(GLFWwindow*, int, int);
 void _update_fps_counter(GLFWwindow*);
@@ -20,7 +49,8 @@ void _print_shader_info_log(GLuint);
 void _print_programme_info_log(GLuint);
 void print_all(GLuint);
 bool is_valid(GLuint);
-bool parse_file_into_str(const char*, char*, int);
+// whole files, see file_loader.h
+#include "file_loader.h"
 
 
 #endif 
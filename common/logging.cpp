@@ -1,54 +1,846 @@
 #include "logging.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
 
-bool restart_gl_log()
+/* bounded multi-producer ring (Vyukov). every slot carries a sequence number:
+seq == pos means free for the producer that claims pos, seq == pos + 1 means
+filled and waiting for the writer. producers only CAS the shared enqueue
+position and never wait on each other or on the writer */
+struct log_slot
+{
+  std::atomic<unsigned long> seq;
+  int length;
+  char text[GL_LOG_MSG_MAX];
+};
+
+static log_slot g_ring[GL_LOG_RING_SLOTS];
+static std::atomic<unsigned long> g_enqueue_pos(0);
+// only the writer thread moves this
+static std::atomic<unsigned long> g_dequeue_pos(0);
+static std::atomic<unsigned long> g_dropped(0);
+
+static std::mutex g_writer_mutex; // writer start/stop and the wait below
+static std::condition_variable g_writer_wake;
+static std::condition_variable g_flush_done;
+static std::thread* g_writer = NULL;
+static std::atomic<bool> g_running(false); // g_writer != NULL, without the lock
+static FILE* g_file = NULL;
+static bool g_stop = false;
+static unsigned long g_flush_target = 0; // write and flush up to here
+static unsigned long g_flushed_pos = 0;
+static std::atomic<int> g_flush_policy(GL_LOG_FLUSH_EVERY_BATCH);
+static std::atomic<int> g_flush_interval_ms(0);
+// the writer thread owns these while it runs
+static long g_file_bytes = 0;
+static std::chrono::steady_clock::time_point g_file_opened;
+
+static std::atomic<long> g_rotate_bytes(8L * 1024 * 1024);
+static std::atomic<int> g_rotate_seconds(0);
+static std::atomic<int> g_rotate_files(5);
+
+std::atomic<unsigned char> g_gl_log_levels[GL_LOG_MAX_CATEGORIES];
+static std::mutex g_category_mutex;
+static std::atomic<bool> g_levels_ready(false); // init_levels has run
+// written once before an id is handed out, read without the lock after
+static char g_category_names[GL_LOG_MAX_CATEGORIES][32] = { "gl" };
+static int g_category_count = 1;
+// every gl_log_set_level call in order, replayed for categories that are
+// registered later
+static std::vector<std::pair<std::string, int> > g_level_rules;
+static const char* g_level_names[] = { "trace", "debug", "info ", "warn ",
+				       "error", "fatal" };
+
+/* <name> -> <name>.1 -> <name>.2 ... keeping at most g_rotate_files old
+files. afterwards <name> is gone, so the next fopen starts a new one */
+static void rotate_files(const char* name)
 {
-  FILE *file = fopen(GL_LOG_FILE, "w");
-  if (!file) {
+  int keep = g_rotate_files.load();
+  char from[512], to[512];
+  if (keep <= 0) {
+    remove(name);
+    return;
+  }
+  snprintf(to, sizeof(to), "%s.%i", name, keep);
+  remove(to);
+  for (int i = keep - 1; i >= 1; i--) {
+    snprintf(from, sizeof(from), "%s.%i", name, i);
+    snprintf(to, sizeof(to), "%s.%i", name, i + 1);
+    rename(from, to);
+  }
+  snprintf(to, sizeof(to), "%s.1", name);
+  rename(name, to);
+}
+
+// rotates name away if there is anything in it
+static void rotate_if_used(const char* name)
+{
+  FILE* f = fopen(name, "rb");
+  if (!f) {
+    return;
+  }
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fclose(f);
+  if (size > 0) {
+    rotate_files(name);
+  }
+}
+
+static bool rotation_due(long bytes, std::chrono::steady_clock::time_point opened)
+{
+  long max_bytes = g_rotate_bytes.load(std::memory_order_relaxed);
+  int max_seconds = g_rotate_seconds.load(std::memory_order_relaxed);
+  if (max_bytes > 0 && bytes >= max_bytes) {
+    return true;
+  }
+  return max_seconds > 0 && std::chrono::steady_clock::now() - opened >=
+    std::chrono::seconds(max_seconds);
+}
+
+static void init_ring()
+{
+  static bool done = false;
+  if (done) {
+    return;
+  }
+  for (unsigned long i = 0; i < GL_LOG_RING_SLOTS; i++) {
+    g_ring[i].seq.store(i, std::memory_order_relaxed);
+  }
+  done = true;
+}
+
+/* writer thread only. leaves g_file NULL if the new file can't be opened;
+the writer then keeps draining, counts what it can't write as dropped and
+tries again every GL_LOG_REOPEN_MS */
+static void rotate_log_file()
+{
+  fclose(g_file);
+  rotate_files(GL_LOG_FILE);
+  g_file = fopen(GL_LOG_FILE, "w");
+  if (!g_file) {
     fprintf(stderr, "Error: could not open GL_LOG_FILE log file %s for writing\n",
 	    GL_LOG_FILE);
-    return false;
   }
+  g_file_bytes = 0;
+  g_file_opened = std::chrono::steady_clock::now();
+}
 
-  time_t now = time (NULL);
-  char *date = ctime(&now);
-  fprintf(file, "GL_LOG_FILE log. local time %s\n", date);
-  fclose(file);
-  return true;
+#define GL_LOG_REOPEN_MS 1000
+
+// writer thread only, while g_file is NULL
+static void reopen_log_file()
+{
+  g_file = fopen(GL_LOG_FILE, "a");
+  if (g_file) {
+    fseek(g_file, 0, SEEK_END);
+    g_file_bytes = ftell(g_file);
+    g_file_opened = std::chrono::steady_clock::now();
+  }
 }
 
-bool gl_log(const char* message, ...)
+// writes every filled slot, returns how many it took
+static int drain_ring()
 {
-  va_list argptr;
-  FILE* file = fopen(GL_LOG_FILE, "a");
-  if (!file) {
-    fprintf(stderr, "Error: could not open GL_LOG_FILE %s file for appending\n",
+  int n = 0;
+  unsigned long pos = g_dequeue_pos.load(std::memory_order_relaxed);
+  for (;;) {
+    log_slot& slot = g_ring[pos & (GL_LOG_RING_SLOTS - 1)];
+    if (slot.seq.load(std::memory_order_acquire) != pos + 1) {
+      break;
+    }
+    // rotate before a message rather than after, so a new file is never
+    // left empty
+    if (g_file && g_file_bytes > 0 && rotation_due(g_file_bytes, g_file_opened)) {
+      rotate_log_file();
+    }
+    if (g_file) {
+      fwrite(slot.text, 1, slot.length, g_file);
+      g_file_bytes += slot.length;
+    } else {
+      g_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    // hand the slot back for the producer one lap ahead
+    slot.seq.store(pos + GL_LOG_RING_SLOTS, std::memory_order_release);
+    pos++;
+    n++;
+  }
+  g_dequeue_pos.store(pos, std::memory_order_release);
+  return n;
+}
+
+// the binary log's side of the writer, further down
+static int drain_bin_queue();
+static bool bin_queue_empty();
+static void bin_close();
+
+static void writer_main()
+{
+  unsigned long reported_drops = 0;
+  std::chrono::steady_clock::time_point last_flush =
+    std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point last_reopen = last_flush;
+  bool dirty = false;
+  for (;;) {
+    if (!g_file && std::chrono::steady_clock::now() - last_reopen >=
+	std::chrono::milliseconds(GL_LOG_REOPEN_MS)) {
+      reopen_log_file();
+      last_reopen = std::chrono::steady_clock::now();
+    }
+    int n = drain_ring() + drain_bin_queue();
+    unsigned long drops = g_dropped.load(std::memory_order_relaxed);
+    if (drops != reported_drops && g_file) {
+      g_file_bytes += fprintf(g_file,
+			      "[gl_log] dropped %lu message(s)\n",
+			      drops - reported_drops);
+      reported_drops = drops;
+      n++;
+    }
+    dirty = g_file && (dirty || n > 0);
+
+    std::chrono::steady_clock::time_point now =
+      std::chrono::steady_clock::now();
+    int policy = g_flush_policy.load(std::memory_order_relaxed);
+    if (dirty && ((GL_LOG_FLUSH_EVERY_BATCH == policy && n > 0) ||
+		  (GL_LOG_FLUSH_INTERVAL == policy && now - last_flush >=
+		   std::chrono::milliseconds(g_flush_interval_ms.load())))) {
+      fflush(g_file);
+      last_flush = now;
+      dirty = false;
+    }
+    if (n > 0) {
+      continue;
+    }
+
+    // ring is empty. answer flush requests, then sleep until woken. producers
+    // don't take the lock to wake us so a missed wake-up costs one timeout
+    std::unique_lock<std::mutex> lock(g_writer_mutex);
+    if (g_flushed_pos < g_flush_target &&
+	g_dequeue_pos.load() >= g_flush_target) {
+      if (g_file) {
+	fflush(g_file);
+      }
+      dirty = false;
+      g_flushed_pos = g_flush_target;
+      g_flush_done.notify_all();
+    }
+    if (g_stop && g_dequeue_pos.load() == g_enqueue_pos.load() &&
+	bin_queue_empty()) {
+      break;
+    }
+    g_writer_wake.wait_for(lock, std::chrono::milliseconds(5));
+  }
+  if (g_file) {
+    fflush(g_file);
+  }
+}
+
+static void stop_at_exit()
+{
+  stop_gl_log();
+}
+
+// after a failed start, no lazy start is tried before this, in steady_clock ticks
+static std::atomic<long long> g_retry_at(0);
+
+// caller holds g_writer_mutex
+static bool start_writer(const char* mode)
+{
+  g_file = fopen(GL_LOG_FILE, mode);
+  if (!g_file) {
+    fprintf(stderr, "Error: could not open GL_LOG_FILE log file %s for writing\n",
 	    GL_LOG_FILE);
+    g_retry_at.store((std::chrono::steady_clock::now() +
+		      std::chrono::milliseconds(GL_LOG_RETRY_MS))
+		     .time_since_epoch().count());
     return false;
   }
+  static bool registered = false;
+  if (!registered) {
+    atexit(stop_at_exit);
+    registered = true;
+  }
+  fseek(g_file, 0, SEEK_END);
+  g_file_bytes = ftell(g_file);
+  g_file_opened = std::chrono::steady_clock::now();
+  init_ring();
+  g_stop = false;
+  g_writer = new std::thread(writer_main);
+  g_running.store(true, std::memory_order_release);
+  return true;
+}
 
-  va_start (argptr, message);
-  vfprintf (file, message, argptr);
-  va_end (argptr);
-  fclose(file);
+// caller holds g_writer_mutex, releases it while waiting for the writer
+static void stop_writer(std::unique_lock<std::mutex>& lock)
+{
+  if (!g_writer) {
+    return;
+  }
+  g_stop = true;
+  g_writer_wake.notify_one();
+  std::thread* writer = g_writer;
+  g_writer = NULL;
+  g_running.store(false, std::memory_order_release);
+  lock.unlock();
+  writer->join();
+  delete writer;
+  lock.lock();
+  if (g_file) {
+    fclose(g_file);
+    g_file = NULL;
+  }
+  bin_close();
+}
+
+/* lazily starts the writer in append mode so logging before restart_gl_log
+(or with restart_gl_log compiled out inside an assert) still works. once the
+file has failed to open, callers don't retry it until GL_LOG_RETRY_MS have
+passed; restart_gl_log always tries */
+static bool ensure_writer()
+{
+  if (g_running.load(std::memory_order_acquire)) {
+    return true;
+  }
+  if (std::chrono::steady_clock::now().time_since_epoch().count() <
+      g_retry_at.load(std::memory_order_relaxed)) {
+    return false;
+  }
+  std::unique_lock<std::mutex> lock(g_writer_mutex);
+  return g_writer || start_writer("a");
+}
+
+static void init_levels();
+
+// init_levels without the lock once it has run
+static void ensure_levels()
+{
+  if (!g_levels_ready.load(std::memory_order_acquire)) {
+    std::lock_guard<std::mutex> lock(g_category_mutex);
+    init_levels();
+  }
+}
+
+static bool enqueue(const char* prefix, const char* message, va_list args)
+{
+  if (!ensure_writer()) {
+    g_dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  unsigned long pos = g_enqueue_pos.load(std::memory_order_relaxed);
+  log_slot* slot;
+  for (;;) {
+    slot = &g_ring[pos & (GL_LOG_RING_SLOTS - 1)];
+    unsigned long seq = slot->seq.load(std::memory_order_acquire);
+    long diff = (long)(seq - pos);
+    if (0 == diff) {
+      if (g_enqueue_pos.compare_exchange_weak(pos, pos + 1,
+					      std::memory_order_relaxed)) {
+	break;
+      }
+    } else if (diff < 0) {
+      // the writer hasn't got round to this slot from the last lap
+      g_dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    } else {
+      pos = g_enqueue_pos.load(std::memory_order_relaxed);
+    }
+  }
+  int len = 0;
+  if (prefix) {
+    len = snprintf(slot->text, GL_LOG_MSG_MAX, "%s", prefix);
+    if (len < 0 || len >= GL_LOG_MSG_MAX) {
+      len = 0;
+    }
+  }
+  int msg_len = vsnprintf(slot->text + len, GL_LOG_MSG_MAX - len, message, args);
+  if (msg_len > 0) {
+    len += msg_len;
+  }
+  if (len >= GL_LOG_MSG_MAX) {
+    len = GL_LOG_MSG_MAX - 1;
+  }
+  slot->length = len;
+  slot->seq.store(pos + 1, std::memory_order_release);
+  g_writer_wake.notify_one();
   return true;
 }
 
-bool gl_log_err(const char* message, ...)
+bool restart_gl_log()
 {
-  va_list argptr;
-  FILE* file = fopen(GL_LOG_FILE, "a");
-  if (!file) {
-    fprintf(stderr, "Error: could not open GL_LOG_FILE %s file for appending\n",
-	    GL_LOG_FILE);
+  // GL_LOG_LEVELS is in place before anything is logged, plain gl_log too
+  ensure_levels();
+  std::unique_lock<std::mutex> lock(g_writer_mutex);
+  stop_writer(lock);
+  // keep the last run's log as gl.log.1 instead of truncating it
+  rotate_if_used(GL_LOG_FILE);
+  if (!start_writer("w")) {
     return false;
   }
+  lock.unlock();
 
+  time_t now = time (NULL);
+  char *date = ctime(&now);
+  return gl_log("GL_LOG_FILE log. local time %s\n", date);
+}
+
+bool gl_log_plain(int level, const char* message, ...)
+{
+  ensure_levels();
+  if (level < g_gl_log_levels[0].load(std::memory_order_relaxed)) {
+    return true;
+  }
+  va_list argptr;
   va_start (argptr, message);
-  vfprintf (file, message, argptr);
+  bool result = enqueue(NULL, message, argptr);
   va_end (argptr);
+  if (level >= GL_LOG_LEVEL_ERROR) {
+    va_start (argptr, message);
+    vfprintf (stderr, message, argptr);
+    va_end(argptr);
+  }
+  return result;
+}
+
+void gl_log_set_flush_policy(gl_log_flush_policy policy, int interval_ms)
+{
+  g_flush_interval_ms.store(interval_ms);
+  g_flush_policy.store(policy);
+}
+
+void gl_log_flush()
+{
+  std::unique_lock<std::mutex> lock(g_writer_mutex);
+  if (!g_writer) {
+    return;
+  }
+  unsigned long target = g_enqueue_pos.load();
+  if (target > g_flush_target) {
+    g_flush_target = target;
+  }
+  g_writer_wake.notify_one();
+  while (g_writer && g_flushed_pos < target) {
+    g_flush_done.wait_for(lock, std::chrono::milliseconds(5));
+  }
+}
+
+void stop_gl_log()
+{
+  std::unique_lock<std::mutex> lock(g_writer_mutex);
+  stop_writer(lock);
+}
+
+unsigned long gl_log_dropped()
+{
+  return g_dropped.load(std::memory_order_relaxed);
+}
+
+static int parse_level(const char* s, size_t len)
+{
+  static const char* names[] = { "trace", "debug", "info", "warn", "error",
+				 "fatal", "off" };
+  for (int i = 0; i <= GL_LOG_LEVEL_OFF; i++) {
+    if (strlen(names[i]) == len && 0 == strncmp(s, names[i], len)) {
+      return i;
+    }
+  }
+  if (7 == len && 0 == strncmp(s, "warning", len)) {
+    return GL_LOG_LEVEL_WARN;
+  }
+  if (1 == len && s[0] >= '0' && s[0] <= '6') {
+    return s[0] - '0';
+  }
+  return -1;
+}
+
+// caller holds g_category_mutex
+static void apply_level(const char* name, int level)
+{
+  bool all = 0 == strcmp(name, "*");
+  if (all) {
+    g_level_rules.clear();
+  }
+  g_level_rules.push_back(std::make_pair(std::string(name), level));
+  for (int i = 0; i < g_category_count; i++) {
+    if (all || 0 == strcmp(name, g_category_names[i])) {
+      g_gl_log_levels[i].store((unsigned char)level);
+    }
+  }
+}
+
+// caller holds g_category_mutex
+static bool apply_levels(const char* spec)
+{
+  bool ok = true;
+  while (*spec) {
+    size_t len = strcspn(spec, ",");
+    const char* eq = (const char*)memchr(spec, '=', len);
+    std::string name = eq ? std::string(spec, eq - spec) : std::string("*");
+    const char* value = eq ? eq + 1 : spec;
+    int level = parse_level(value, len - (value - spec));
+    if (level < 0 || name.empty()) {
+      ok = false;
+    } else {
+      apply_level(name.c_str(), level);
+    }
+    spec += len;
+    if (',' == *spec) {
+      spec++;
+    }
+  }
+  return ok;
+}
+
+// caller holds g_category_mutex. GL_LOG_LEVELS applies before any call
+static void init_levels()
+{
+  static bool done = false;
+  if (done) {
+    return;
+  }
+  done = true;
+  const char* env = getenv("GL_LOG_LEVELS");
+  if (env && !apply_levels(env)) {
+    fprintf(stderr, "WARNING: could not parse GL_LOG_LEVELS \"%s\"\n", env);
+  }
+  g_levels_ready.store(true, std::memory_order_release);
+}
+
+int gl_log_category(const char* name)
+{
+  std::lock_guard<std::mutex> lock(g_category_mutex);
+  init_levels();
+  for (int i = 0; i < g_category_count; i++) {
+    if (0 == strcmp(name, g_category_names[i])) {
+      return i;
+    }
+  }
+  if (g_category_count == GL_LOG_MAX_CATEGORIES) {
+    return GL_LOG_MAX_CATEGORIES - 1;
+  }
+  int id = g_category_count++;
+  snprintf(g_category_names[id], sizeof(g_category_names[id]), "%s", name);
+  int level = GL_LOG_LEVEL_TRACE;
+  for (size_t i = 0; i < g_level_rules.size(); i++) {
+    if (g_level_rules[i].first == "*" || g_level_rules[i].first == name) {
+      level = g_level_rules[i].second;
+    }
+  }
+  g_gl_log_levels[id].store((unsigned char)level);
+  return id;
+}
+
+void gl_log_set_level(const char* name, int level)
+{
+  std::lock_guard<std::mutex> lock(g_category_mutex);
+  init_levels();
+  apply_level(name, level);
+}
+
+bool gl_log_set_levels(const char* spec)
+{
+  std::lock_guard<std::mutex> lock(g_category_mutex);
+  init_levels();
+  return apply_levels(spec);
+}
+
+bool gl_log_at(int level, int category, const char* message, ...)
+{
+  if (level < GL_LOG_LEVEL_TRACE) {
+    level = GL_LOG_LEVEL_TRACE;
+  } else if (level > GL_LOG_LEVEL_FATAL) {
+    level = GL_LOG_LEVEL_FATAL;
+  }
+  char prefix[64];
+  snprintf(prefix, sizeof(prefix), "[%s] [%s] ", g_level_names[level],
+	   g_category_names[category]);
+  va_list argptr;
   va_start (argptr, message);
-  vfprintf (stderr, message, argptr);
-  va_end(argptr);
-  fclose(file);
+  bool result = enqueue(prefix, message, argptr);
+  va_end (argptr);
+  if (level >= GL_LOG_LEVEL_ERROR) {
+    fputs(prefix, stderr);
+    va_start (argptr, message);
+    vfprintf (stderr, message, argptr);
+    va_end(argptr);
+  }
+  if (GL_LOG_LEVEL_FATAL == level) {
+    gl_log_flush();
+  }
+  return result;
+}
+
+void gl_log_set_rotation(long max_bytes, int max_seconds, int max_files)
+{
+  g_rotate_bytes.store(max_bytes);
+  g_rotate_seconds.store(max_seconds);
+  g_rotate_files.store(max_files);
+}
+
+/*------------------------------BINARY LOG-----------------------------------*/
+#define GL_LOG_BIN_HEADER_SIZE 15 // 'M' u32 id, u64 ns, u16 size
+
+/* a thread fills its own buffer and hands it to the gl_log writer thread
+whole, taking a spare one back. the queue lock is only ever held to push or
+pop, all the file work and rotation happen on the writer. data == NULL asks
+the writer to start a new file */
+struct bin_buffer
+{
+  unsigned char* data;
+  size_t used;
+  int messages;
+};
+
+static std::mutex g_bin_queue_mutex; // g_bin_queue and g_bin_spare
+static std::vector<bin_buffer> g_bin_queue;
+static std::vector<unsigned char*> g_bin_spare;
+static std::atomic<unsigned long> g_bin_queued(0); // buffers handed over
+static std::atomic<unsigned long> g_bin_written(0); // and dealt with
+static std::atomic<bool> g_bin_restarted(false); // last restart got a file
+
+static std::mutex g_bin_format_mutex;
+static std::vector<std::string> g_bin_formats;
+
+// writer thread only, or with the writer stopped
+static FILE* g_bin_file = NULL;
+static long g_bin_bytes = 0;
+static std::chrono::steady_clock::time_point g_bin_opened;
+static size_t g_bin_formats_written = 0; // to g_bin_file
+
+static void bin_write_format(unsigned int id, const std::string& f)
+{
+  uint16_t len = (uint16_t)(f.size() > 0xffff ? 0xffff : f.size());
+  unsigned char kind = GL_LOG_BIN_FORMAT;
+  fwrite(&kind, 1, 1, g_bin_file);
+  fwrite(&id, 4, 1, g_bin_file);
+  fwrite(&len, 2, 1, g_bin_file);
+  fwrite(f.data(), 1, len, g_bin_file);
+  g_bin_bytes += 7 + len;
+}
+
+/* the formats registered since the last call. copied out first so a thread
+registering one never waits on the file. a buffer is only handed over after
+its formats are registered, so writing these before it is enough */
+static void bin_write_new_formats()
+{
+  std::vector<std::string> formats;
+  {
+    std::lock_guard<std::mutex> lock(g_bin_format_mutex);
+    formats.assign(g_bin_formats.begin() + g_bin_formats_written,
+		   g_bin_formats.end());
+  }
+  for (size_t i = 0; i < formats.size(); i++) {
+    bin_write_format((unsigned int)(g_bin_formats_written + i), formats[i]);
+  }
+  g_bin_formats_written += formats.size();
+}
+
+/* every open starts a session and repeats the format table, ids are only
+unique within one run of a program */
+static bool bin_open(const char* mode)
+{
+  g_bin_file = fopen(GL_LOG_BIN_FILE, mode);
+  if (!g_bin_file) {
+    fprintf(stderr, "Error: could not open GL_LOG_BIN_FILE log file %s for writing\n",
+	    GL_LOG_BIN_FILE);
+    return false;
+  }
+  fseek(g_bin_file, 0, SEEK_END);
+  if (0 == ftell(g_bin_file)) {
+    uint32_t version = GL_LOG_BIN_VERSION;
+    fwrite(GL_LOG_BIN_MAGIC, 1, 4, g_bin_file);
+    fwrite(&version, 4, 1, g_bin_file);
+  }
+  unsigned char kind = GL_LOG_BIN_SESSION;
+  int64_t now = (int64_t)time(NULL);
+  fwrite(&kind, 1, 1, g_bin_file);
+  fwrite(&now, 8, 1, g_bin_file);
+  g_bin_bytes = ftell(g_bin_file);
+  g_bin_opened = std::chrono::steady_clock::now();
+  g_bin_formats_written = 0;
+  bin_write_new_formats();
   return true;
 }
+
+static void bin_close()
+{
+  if (g_bin_file) {
+    fclose(g_bin_file);
+    g_bin_file = NULL;
+  }
+}
+
+// writer thread only. writes out the buffers handed over, returns how many
+static int drain_bin_queue()
+{
+  std::vector<bin_buffer> queue;
+  {
+    std::lock_guard<std::mutex> lock(g_bin_queue_mutex);
+    if (g_bin_queue.empty()) {
+      return 0;
+    }
+    queue.swap(g_bin_queue);
+  }
+  for (const bin_buffer& b : queue) {
+    if (!b.data) {
+      bin_close();
+      rotate_if_used(GL_LOG_BIN_FILE);
+      g_bin_restarted.store(bin_open("wb"));
+      continue;
+    }
+    if (!g_bin_file && !bin_open("ab")) {
+      g_dropped.fetch_add(b.messages, std::memory_order_relaxed);
+      continue;
+    }
+    bin_write_new_formats();
+    fwrite(b.data, 1, b.used, g_bin_file);
+    g_bin_bytes += (long)b.used;
+    if (rotation_due(g_bin_bytes, g_bin_opened)) {
+      bin_close();
+      rotate_files(GL_LOG_BIN_FILE);
+      bin_open("wb");
+    }
+  }
+  if (g_bin_file) {
+    fflush(g_bin_file);
+  }
+  {
+    std::lock_guard<std::mutex> lock(g_bin_queue_mutex);
+    for (const bin_buffer& b : queue) {
+      if (b.data) {
+	g_bin_spare.push_back(b.data);
+      }
+    }
+  }
+  g_bin_written.fetch_add(queue.size(), std::memory_order_release);
+  g_flush_done.notify_all();
+  return (int)queue.size();
+}
+
+static bool bin_queue_empty()
+{
+  return g_bin_written.load(std::memory_order_acquire) ==
+    g_bin_queued.load(std::memory_order_acquire);
+}
+
+// until the writer has dealt with the first target buffers handed over
+static void wait_for_bin(unsigned long target)
+{
+  std::unique_lock<std::mutex> lock(g_writer_mutex);
+  g_writer_wake.notify_one();
+  while (g_writer && g_bin_written.load(std::memory_order_acquire) < target) {
+    g_flush_done.wait_for(lock, std::chrono::milliseconds(5));
+  }
+}
+
+struct bin_thread_buffer
+{
+  bin_thread_buffer() : data(NULL), used(0), messages(0) {}
+  ~bin_thread_buffer()
+  {
+    hand_over(false);
+    delete[] data;
+  }
+  /* queues what this thread has logged for the writer, never waiting on the
+  file. with the queue full the messages are counted as dropped and the
+  buffer reused. refill takes a spare buffer back */
+  void hand_over(bool refill)
+  {
+    if (0 == used) {
+      return;
+    }
+    bool queued = false;
+    if (ensure_writer()) {
+      std::lock_guard<std::mutex> lock(g_bin_queue_mutex);
+      if (g_bin_queue.size() < GL_LOG_BIN_QUEUE_MAX) {
+	bin_buffer b = {data, used, messages};
+	g_bin_queue.push_back(b);
+	g_bin_queued.fetch_add(1, std::memory_order_release);
+	data = NULL;
+	queued = true;
+	if (refill && !g_bin_spare.empty()) {
+	  data = g_bin_spare.back();
+	  g_bin_spare.pop_back();
+	}
+      }
+    }
+    if (queued) {
+      g_writer_wake.notify_one();
+    } else {
+      g_dropped.fetch_add(messages, std::memory_order_relaxed);
+    }
+    if (refill && !data) {
+      data = new unsigned char[GL_LOG_BIN_BUFFER_SIZE];
+    }
+    used = 0;
+    messages = 0;
+  }
+  unsigned char* data;
+  size_t used;
+  int messages;
+};
+
+static thread_local bin_thread_buffer t_bin_buffer;
+
+bool restart_gl_log_bin()
+{
+  // what this thread logged so far goes to the old file
+  t_bin_buffer.hand_over(true);
+  if (!ensure_writer()) {
+    return false;
+  }
+  unsigned long target;
+  {
+    std::lock_guard<std::mutex> lock(g_bin_queue_mutex);
+    bin_buffer restart = {NULL, 0, 0};
+    g_bin_queue.push_back(restart);
+    target = g_bin_queued.fetch_add(1, std::memory_order_release) + 1;
+  }
+  wait_for_bin(target);
+  return g_bin_restarted.load();
+}
+
+void gl_log_bin_flush()
+{
+  t_bin_buffer.hand_over(true);
+  wait_for_bin(g_bin_queued.load(std::memory_order_acquire));
+}
+
+unsigned int gl_log_bin_register(const char* format)
+{
+  std::lock_guard<std::mutex> lock(g_bin_format_mutex);
+  unsigned int id = (unsigned int)g_bin_formats.size();
+  g_bin_formats.push_back(format);
+  return id;
+}
+
+unsigned char* gl_log_bin_begin(unsigned int id, size_t args_size)
+{
+  size_t size = GL_LOG_BIN_HEADER_SIZE + args_size;
+  if (size > GL_LOG_BIN_BUFFER_SIZE || args_size > 0xffff) {
+    return NULL;
+  }
+  bin_thread_buffer& b = t_bin_buffer;
+  if (b.used + size > GL_LOG_BIN_BUFFER_SIZE) {
+    b.hand_over(true);
+  }
+  if (!b.data) {
+    b.data = new unsigned char[GL_LOG_BIN_BUFFER_SIZE];
+  }
+  unsigned char* p = b.data + b.used;
+  b.used += size;
+  b.messages++;
+  uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+  uint16_t args = (uint16_t)args_size;
+  p[0] = GL_LOG_BIN_MESSAGE;
+  memcpy(p + 1, &id, 4);
+  memcpy(p + 5, &ns, 8);
+  memcpy(p + 13, &args, 2);
+  return p + GL_LOG_BIN_HEADER_SIZE;
+}
@@ -3,11 +3,261 @@
 
 #include <time.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
 #include <cstdio>
+#include <type_traits>
 #define GL_LOG_FILE "gl.log"
+#define GL_LOG_BIN_FILE "gl.log.bin"
+
+/* gl_log and gl_log_err never touch the file themselves. they format the
+message into a slot of a lock-free ring buffer and return; a background
+thread writes the ring out to GL_LOG_FILE, which stays open. if the ring is
+full the message is dropped (the call returns false) and the writer notes how
+many were lost in the log. so is a message logged while the file can't be
+opened; after a failed open the next try is GL_LOG_RETRY_MS later, not on
+every call. messages longer than GL_LOG_MSG_MAX are cut short.
+gl_log_err still prints to stderr straight away. */
+#define GL_LOG_RING_SLOTS 1024 // must be a power of two
+#define GL_LOG_MSG_MAX 512
+#define GL_LOG_RETRY_MS 3000 // between tries at a log file that won't open
+
+// when the writer thread calls fflush
+enum gl_log_flush_policy {
+  GL_LOG_FLUSH_EVERY_BATCH, // after each run of queued messages (default)
+  GL_LOG_FLUSH_INTERVAL,    // at most every interval_ms
+  GL_LOG_FLUSH_MANUAL       // only in gl_log_flush and stop_gl_log
+};
 
 bool restart_gl_log();
-bool gl_log(const char*, ...);
-bool gl_log_err(const char*, ...);
+// gl_log( "fmt", args... ) and gl_log_err( "fmt", args... ) are macros, see
+// LEVELS below
+
+void gl_log_set_flush_policy(gl_log_flush_policy policy, int interval_ms = 0);
+// blocks until everything logged so far is written and flushed
+void gl_log_flush();
+// drains the ring, stops the writer thread and closes the file. also runs at
+// exit, logging again afterwards starts a new writer
+void stop_gl_log();
+// total messages lost since the start of the program, to a full ring or to a
+// log file that couldn't be opened
+unsigned long gl_log_dropped();
+
+/*------------------------------LEVELS---------------------------------------*/
+/* GL_LOG_INFO( "shader", "fmt", args... ) etc. log at a level under a
+category name. lines come out as "[info ] [shader] message".
+calls below GL_LOG_MIN_LEVEL are compiled out, arguments and all. build with
+e.g. -DGL_LOG_MIN_LEVEL=2 to keep info and up. above that, each category has
+a runtime minimum level; see gl_log_set_level and gl_log_set_levels.
+error and fatal are echoed to stderr. fatal also waits for the log to reach
+the disk, so the line survives whatever happens next.
+plain gl_log and gl_log_err are info and error in the "gl" category, and keep
+their old unprefixed output. they are compiled out below GL_LOG_MIN_LEVEL
+like the rest, and return true when they are. */
+#define GL_LOG_LEVEL_TRACE 0
+#define GL_LOG_LEVEL_DEBUG 1
+#define GL_LOG_LEVEL_INFO 2
+#define GL_LOG_LEVEL_WARN 3
+#define GL_LOG_LEVEL_ERROR 4
+#define GL_LOG_LEVEL_FATAL 5
+#define GL_LOG_LEVEL_OFF 6
+#ifndef GL_LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define GL_LOG_MIN_LEVEL GL_LOG_LEVEL_INFO
+#else
+#define GL_LOG_MIN_LEVEL GL_LOG_LEVEL_TRACE
+#endif
+#endif
+#define GL_LOG_MAX_CATEGORIES 64
+
+// per-category runtime minimum levels, indexed by gl_log_category()
+extern std::atomic<unsigned char> g_gl_log_levels[GL_LOG_MAX_CATEGORIES];
+
+// id for a category name, registering it on first use. past
+// GL_LOG_MAX_CATEGORIES names every new one shares the last id
+int gl_log_category(const char* name);
+// minimum level for one category, or every category when name is "*"
+void gl_log_set_level(const char* name, int level);
+/* a list like "*=warn,shader=debug,glfw=off". applied left to right. the
+GL_LOG_LEVELS environment variable is read the same way when logging starts */
+bool gl_log_set_levels(const char* spec);
+bool gl_log_at(int level, int category, const char* message, ...)
+#if defined(__GNUC__)
+  __attribute__((format(printf, 3, 4)))
+#endif
+  ;
+
+#define GL_LOG_AT_(level, category, ...)                                      \
+  do {                                                                        \
+    if ((level) >= GL_LOG_MIN_LEVEL) {                                        \
+      static const int gl_log_cat_ = gl_log_category(category);               \
+      if ((level) >= g_gl_log_levels[gl_log_cat_].load(                       \
+		       std::memory_order_relaxed)) {                          \
+	gl_log_at((level), gl_log_cat_, __VA_ARGS__);                         \
+      }                                                                       \
+    }                                                                         \
+  } while (0)
+#define GL_LOG_TRACE(category, ...) GL_LOG_AT_(GL_LOG_LEVEL_TRACE, category, __VA_ARGS__)
+#define GL_LOG_DEBUG(category, ...) GL_LOG_AT_(GL_LOG_LEVEL_DEBUG, category, __VA_ARGS__)
+#define GL_LOG_INFO(category, ...) GL_LOG_AT_(GL_LOG_LEVEL_INFO, category, __VA_ARGS__)
+#define GL_LOG_WARN(category, ...) GL_LOG_AT_(GL_LOG_LEVEL_WARN, category, __VA_ARGS__)
+#define GL_LOG_ERROR(category, ...) GL_LOG_AT_(GL_LOG_LEVEL_ERROR, category, __VA_ARGS__)
+#define GL_LOG_FATAL(category, ...) GL_LOG_AT_(GL_LOG_LEVEL_FATAL, category, __VA_ARGS__)
+
+// what gl_log and gl_log_err call: level filtering, no prefix
+bool gl_log_plain(int level, const char* message, ...)
+#if defined(__GNUC__)
+  __attribute__((format(printf, 2, 3)))
+#endif
+  ;
+#define gl_log(...)                                                           \
+  ((GL_LOG_LEVEL_INFO >= GL_LOG_MIN_LEVEL) ?                                  \
+   gl_log_plain(GL_LOG_LEVEL_INFO, __VA_ARGS__) : true)
+#define gl_log_err(...)                                                       \
+  ((GL_LOG_LEVEL_ERROR >= GL_LOG_MIN_LEVEL) ?                                 \
+   gl_log_plain(GL_LOG_LEVEL_ERROR, __VA_ARGS__) : true)
+
+/*------------------------------ROTATION-------------------------------------*/
+/* restart_gl_log and restart_gl_log_bin no longer truncate: the old file is
+moved to <name>.1 (and .1 to .2 ...) and a new one is started, keeping at
+most max_files old files. a running log rotates the same way once it grows
+past max_bytes, or has been open max_seconds. 0 turns either limit off.
+defaults are 8 MB, no age limit and 5 old files */
+void gl_log_set_rotation(long max_bytes, int max_seconds, int max_files);
+
+/*------------------------------BINARY LOG-----------------------------------*/
+/* GL_LOG_BIN( "fmt", args... ) is a gl_log that skips printf at the call site.
+the format string gets an id the first time a call site runs; after that a
+call copies the id, a timestamp and the raw arguments into a per-thread
+buffer. a full buffer is handed to the gl_log writer thread, which appends it
+to GL_LOG_BIN_FILE and does any rotation, so the logging thread never waits
+on the disk. a thread's buffer is handed over too when it exits or calls
+gl_log_bin_flush. if the writer falls GL_LOG_BIN_QUEUE_MAX buffers behind,
+their messages are counted in gl_log_dropped instead. the gl_log_decode tool
+turns the file back into text. arguments are stored as 32/64 bit integers,
+doubles, pointers or copied strings (char pointers), so the usual printf
+conversions all work.
+
+file layout, host byte order:
+  "GLLB" u32 version                          once, at the start of the file
+  'S' i64 unix time                           each time a program opens it
+  'F' u32 id u16 length chars                 a format string, ids restart
+                                              at each 'S'
+  'M' u32 id u64 nanoseconds u16 size args    a message. each arg is a type
+                                              tag then its value (see below) */
+#define GL_LOG_BIN_MAGIC "GLLB"
+#define GL_LOG_BIN_VERSION 1
+#define GL_LOG_BIN_BUFFER_SIZE 16384 // per thread
+#define GL_LOG_BIN_QUEUE_MAX 64       // full buffers waiting for the writer
+#define GL_LOG_BIN_STRING_MAX 1024   // longer %s arguments are cut short
+enum gl_log_bin_record { GL_LOG_BIN_SESSION = 'S', GL_LOG_BIN_FORMAT = 'F', GL_LOG_BIN_MESSAGE = 'M' };
+enum gl_log_bin_arg {
+  GL_LOG_BIN_I32 = 'i',
+  GL_LOG_BIN_I64 = 'I',
+  GL_LOG_BIN_U32 = 'u',
+  GL_LOG_BIN_U64 = 'U',
+  GL_LOG_BIN_F64 = 'd',
+  GL_LOG_BIN_PTR = 'p',
+  GL_LOG_BIN_STR = 's' // u16 length then the chars, no terminator
+};
+
+// starts a new GL_LOG_BIN_FILE, see rotation below, and waits for the writer
+// to open it. without it the first message appends
+bool restart_gl_log_bin();
+// hands the calling thread's buffer to the writer and waits until it's written
+void gl_log_bin_flush();
+unsigned int gl_log_bin_register(const char* format);
+// space for a message of args_size bytes in this thread's buffer, with the
+// record header already written. NULL if it can never fit
+unsigned char* gl_log_bin_begin(unsigned int id, size_t args_size);
+// only here so the compiler checks GL_LOG_BIN formats against their args
+inline void gl_log_bin_check_format(const char*, ...)
+#if defined(__GNUC__)
+  __attribute__((format(printf, 1, 2)))
+#endif
+  ;
+inline void gl_log_bin_check_format(const char*, ...) {}
+
+#define GL_LOG_BIN(format, ...)                                               \
+  do {                                                                        \
+    static const unsigned int gl_log_bin_id_ = gl_log_bin_register(format);   \
+    if (false) {                                                              \
+      gl_log_bin_check_format(format, ##__VA_ARGS__);                         \
+    }                                                                         \
+    gl_log_bin_write(gl_log_bin_id_, ##__VA_ARGS__);                          \
+  } while (0)
+
+template <typename T> inline size_t gl_log_bin_arg_size(const T&)
+{
+  static_assert(std::is_arithmetic<T>::value || std::is_pointer<T>::value ||
+		std::is_enum<T>::value,
+		"GL_LOG_BIN only takes numbers, enums and pointers");
+  return 1 + ((std::is_arithmetic<T>::value || std::is_enum<T>::value) &&
+	      sizeof(T) <= 4 && !std::is_floating_point<T>::value ? 4 : 8);
+}
+
+inline size_t gl_log_bin_str_len(const char* s)
+{
+  size_t n = s ? strlen(s) : 6; // "(null)"
+  return n > GL_LOG_BIN_STRING_MAX ? GL_LOG_BIN_STRING_MAX : n;
+}
+inline size_t gl_log_bin_arg_size(const char* s) { return 3 + gl_log_bin_str_len(s); }
+inline size_t gl_log_bin_arg_size(char* s) { return 3 + gl_log_bin_str_len(s); }
+// glGetString hands back GLubyte pointers
+inline size_t gl_log_bin_arg_size(const unsigned char* s) { return 3 + gl_log_bin_str_len((const char*)s); }
+
+template <typename V> inline unsigned char* gl_log_bin_put_raw(unsigned char* p, char tag, V v)
+{
+  *p++ = (unsigned char)tag;
+  memcpy(p, &v, sizeof(V));
+  return p + sizeof(V);
+}
+
+template <typename T> inline unsigned char* gl_log_bin_put(unsigned char* p, const T& v)
+{
+  if constexpr (std::is_pointer<T>::value) {
+    return gl_log_bin_put_raw(p, GL_LOG_BIN_PTR, (uint64_t)(uintptr_t)v);
+  } else if constexpr (std::is_floating_point<T>::value) {
+    return gl_log_bin_put_raw(p, GL_LOG_BIN_F64, (double)v);
+  } else if constexpr (std::is_enum<T>::value) {
+    return gl_log_bin_put(p, (typename std::underlying_type<T>::type)v);
+  } else if constexpr (std::is_signed<T>::value) {
+    if constexpr (sizeof(T) <= 4) {
+      return gl_log_bin_put_raw(p, GL_LOG_BIN_I32, (int32_t)v);
+    } else {
+      return gl_log_bin_put_raw(p, GL_LOG_BIN_I64, (int64_t)v);
+    }
+  } else {
+    if constexpr (sizeof(T) <= 4) {
+      return gl_log_bin_put_raw(p, GL_LOG_BIN_U32, (uint32_t)v);
+    } else {
+      return gl_log_bin_put_raw(p, GL_LOG_BIN_U64, (uint64_t)v);
+    }
+  }
+}
+
+inline unsigned char* gl_log_bin_put(unsigned char* p, const char* s)
+{
+  uint16_t n = (uint16_t)gl_log_bin_str_len(s);
+  *p++ = GL_LOG_BIN_STR;
+  memcpy(p, &n, 2);
+  memcpy(p + 2, s ? s : "(null)", n);
+  return p + 2 + n;
+}
+inline unsigned char* gl_log_bin_put(unsigned char* p, char* s) { return gl_log_bin_put(p, (const char*)s); }
+inline unsigned char* gl_log_bin_put(unsigned char* p, const unsigned char* s) { return gl_log_bin_put(p, (const char*)s); }
+
+template <typename... Args> inline void gl_log_bin_write(unsigned int id, const Args&... args)
+{
+  // decay so string literals and char arrays go down the char pointer path
+  size_t size = (0 + ... + gl_log_bin_arg_size((typename std::decay<Args>::type)args));
+  unsigned char* p = gl_log_bin_begin(id, size);
+  if (!p) {
+    return;
+  }
+  ((p = gl_log_bin_put(p, (typename std::decay<Args>::type)args)), ...);
+  (void)p;
+}
 
 #endif
@@ -0,0 +1,252 @@
+/******************************************************************************\
+| Batch mat4 transforms. See math_batch.h                                      |
+\******************************************************************************/
+#include "math_batch.h"
+#include "maths_simd.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// below this many elements per thread, waking a worker costs more than it saves
+#define BATCH_MIN_PER_THREAD 16384
+
+/* worker threads started on first use and kept until exit, so a threaded call
+only pays for waking them (a few us) instead of creating and joining threads
+(tens of us). one job at a time: a call that finds the pool busy, or comes
+from inside a job, runs on its own thread. workers and the caller take chunks
+off a shared counter, so a slow thread just ends up with fewer of them */
+static thread_local bool t_in_batch_job = false;
+
+class batch_pool {
+public:
+  ~batch_pool() {
+    {
+      std::lock_guard<std::mutex> lock( m_mutex );
+      m_stop = true;
+    }
+    m_wake.notify_all();
+    for ( size_t i = 0; i < m_threads.size(); i++ ) { m_threads[i].join(); }
+  }
+
+  // false if the pool is busy, otherwise runs fn( ctx, begin, end ) on every chunk
+  bool run( void ( *fn )( void*, int, int ), void* ctx, int count, int chunk, int n_threads ) {
+    std::unique_lock<std::mutex> busy( m_busy, std::try_to_lock );
+    if ( !busy.owns_lock() ) { return false; }
+    std::unique_lock<std::mutex> lock( m_mutex );
+    // the caller is one of the n_threads
+    while ( (int)m_threads.size() < n_threads - 1 ) { m_threads.push_back( std::thread( &batch_pool::worker_main, this ) ); }
+    m_fn       = fn;
+    m_ctx      = ctx;
+    m_count    = count;
+    m_chunk    = chunk;
+    m_n_chunks = ( count + chunk - 1 ) / chunk;
+    m_next.store( 0 );
+    m_chunks_done.store( 0 );
+    m_wanted = n_threads - 1;
+    m_generation++;
+    lock.unlock();
+    m_wake.notify_all();
+    work();
+    // no worker may still be in work() when the next job is set up
+    lock.lock();
+    m_done.wait( lock, [this] { return m_chunks_done.load() == m_n_chunks && 0 == m_active; } );
+    m_wanted = 0;
+    return true;
+  }
+
+private:
+  void work() {
+    t_in_batch_job = true;
+    for ( ;; ) {
+      int c = m_next.fetch_add( 1 );
+      if ( c >= m_n_chunks ) { break; }
+      int begin = c * m_chunk;
+      int end   = begin + m_chunk < m_count ? begin + m_chunk : m_count;
+      m_fn( m_ctx, begin, end );
+      m_chunks_done.fetch_add( 1 );
+    }
+    t_in_batch_job = false;
+  }
+
+  void worker_main() {
+    unsigned seen = 0;
+    std::unique_lock<std::mutex> lock( m_mutex );
+    for ( ;; ) {
+      m_wake.wait( lock, [&] { return m_stop || ( seen != m_generation && m_wanted > 0 ); } );
+      if ( m_stop ) { return; }
+      seen = m_generation;
+      m_wanted--;
+      m_active++;
+      lock.unlock();
+      work();
+      lock.lock();
+      if ( 0 == --m_active ) { m_done.notify_one(); }
+    }
+  }
+
+  std::mutex m_busy; // held for a whole job
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::condition_variable m_done;
+  std::vector<std::thread> m_threads;
+  // the job. set under m_mutex while no worker is in work()
+  void ( *m_fn )( void*, int, int ) = nullptr;
+  void* m_ctx                       = nullptr;
+  int m_count = 0, m_chunk = 0, m_n_chunks = 0;
+  std::atomic<int> m_next{ 0 };
+  std::atomic<int> m_chunks_done{ 0 };
+  unsigned m_generation = 0;
+  int m_wanted          = 0; // workers still to join this job
+  int m_active          = 0; // workers in work()
+  bool m_stop           = false;
+};
+
+static batch_pool g_batch_pool;
+
+void batch_for_chunks( int count, int chunk, int n_threads, void ( *fn )( void*, int, int ), void* ctx ) {
+  if ( count <= 0 || chunk <= 0 ) { return; }
+  int n_chunks = ( count + chunk - 1 ) / chunk;
+  if ( n_threads <= 0 ) { n_threads = (int)std::thread::hardware_concurrency(); }
+  if ( n_threads > n_chunks ) { n_threads = n_chunks; }
+  if ( n_threads > 1 && !t_in_batch_job && g_batch_pool.run( fn, ctx, count, chunk, n_threads ) ) { return; }
+  for ( int begin = 0; begin < count; begin += chunk ) { fn( ctx, begin, begin + chunk < count ? begin + chunk : count ); }
+}
+
+/* splits [0, count) into chunks (multiples of 4 so the 4-wide kernels stay
+aligned to the groups) and runs fn( begin, end ) on each, spread over the
+pool's workers and the calling thread. */
+template <typename F> static void run_chunked( int count, int n_threads, F fn ) {
+  if ( n_threads <= 0 ) { n_threads = (int)std::thread::hardware_concurrency(); }
+  int max_threads = count / BATCH_MIN_PER_THREAD;
+  if ( n_threads > max_threads ) { n_threads = max_threads; }
+  if ( n_threads <= 1 || t_in_batch_job ) {
+    fn( 0, count );
+    return;
+  }
+  int chunk = ( ( count + n_threads - 1 ) / n_threads + 3 ) & ~3;
+  batch_for_chunks( count, chunk, n_threads, fn );
+}
+
+/* x,y,z of 4 consecutive points (12 floats) <-> 3 registers of x's, y's, z's
+a = x0 y0 z0 x1, b = y1 z1 x2 y2, c = z2 x3 y3 z3 */
+static MATHS_FORCE_INLINE void load_xyz4( const float* p, simd4f& x, simd4f& y, simd4f& z ) {
+  simd4f a = simd4f_load( p );
+  simd4f b = simd4f_load( p + 4 );
+  simd4f c = simd4f_load( p + 8 );
+  x        = SIMD4F_SHUFFLE( SIMD4F_SHUFFLE( a, a, 0, 0, 3, 3 ), SIMD4F_SHUFFLE( b, c, 2, 2, 1, 1 ), 0, 2, 0, 2 );
+  y        = SIMD4F_SHUFFLE( SIMD4F_SHUFFLE( a, b, 1, 1, 0, 0 ), SIMD4F_SHUFFLE( b, c, 3, 3, 2, 2 ), 0, 2, 0, 2 );
+  z        = SIMD4F_SHUFFLE( SIMD4F_SHUFFLE( a, b, 2, 2, 1, 1 ), SIMD4F_SHUFFLE( c, c, 0, 0, 3, 3 ), 0, 2, 0, 2 );
+}
+
+static MATHS_FORCE_INLINE void store_xyz4( float* p, simd4f x, simd4f y, simd4f z ) {
+  simd4f a = SIMD4F_SHUFFLE( SIMD4F_SHUFFLE( x, y, 0, 0, 0, 0 ), SIMD4F_SHUFFLE( z, x, 0, 0, 1, 1 ), 0, 2, 0, 2 );
+  simd4f b = SIMD4F_SHUFFLE( SIMD4F_SHUFFLE( y, z, 1, 1, 1, 1 ), SIMD4F_SHUFFLE( x, y, 2, 2, 2, 2 ), 0, 2, 0, 2 );
+  simd4f c = SIMD4F_SHUFFLE( SIMD4F_SHUFFLE( z, x, 2, 2, 3, 3 ), SIMD4F_SHUFFLE( y, z, 3, 3, 3, 3 ), 0, 2, 0, 2 );
+  simd4f_store( p, a );
+  simd4f_store( p + 4, b );
+  simd4f_store( p + 8, c );
+}
+
+/* transforms points [begin, end) of a packed xyz array. w is 1 for points and
+0 for directions. 4 points at a time are swizzled to x/y/z registers so every
+lane does useful work, the remainder goes through the scalar path */
+static void transform_xyz_range( const mat4& m, const float* in, float* out, int begin, int end, float w ) {
+  const float* mm = m.m;
+  int i           = begin;
+  if ( end - begin >= 4 ) {
+    simd4f m0 = simd4f_splat( mm[0] ), m1 = simd4f_splat( mm[1] ), m2 = simd4f_splat( mm[2] );
+    simd4f m4 = simd4f_splat( mm[4] ), m5 = simd4f_splat( mm[5] ), m6 = simd4f_splat( mm[6] );
+    simd4f m8 = simd4f_splat( mm[8] ), m9 = simd4f_splat( mm[9] ), m10 = simd4f_splat( mm[10] );
+    simd4f tx = simd4f_splat( mm[12] * w ), ty = simd4f_splat( mm[13] * w ), tz = simd4f_splat( mm[14] * w );
+    for ( ; i + 4 <= end; i += 4 ) {
+      simd4f x, y, z;
+      load_xyz4( &in[i * 3], x, y, z );
+      simd4f rx = simd4f_madd( m8, z, simd4f_madd( m4, y, simd4f_madd( m0, x, tx ) ) );
+      simd4f ry = simd4f_madd( m9, z, simd4f_madd( m5, y, simd4f_madd( m1, x, ty ) ) );
+      simd4f rz = simd4f_madd( m10, z, simd4f_madd( m6, y, simd4f_madd( m2, x, tz ) ) );
+      store_xyz4( &out[i * 3], rx, ry, rz );
+    }
+  }
+  for ( ; i < end; i++ ) {
+    float x        = in[i * 3 + 0];
+    float y        = in[i * 3 + 1];
+    float z        = in[i * 3 + 2];
+    out[i * 3 + 0] = mm[0] * x + mm[4] * y + mm[8] * z + mm[12] * w;
+    out[i * 3 + 1] = mm[1] * x + mm[5] * y + mm[9] * z + mm[13] * w;
+    out[i * 3 + 2] = mm[2] * x + mm[6] * y + mm[10] * z + mm[14] * w;
+  }
+}
+
+void transform_points( const mat4& m, const float* in, float* out, int count, int n_threads ) {
+  run_chunked( count, n_threads, [&]( int begin, int end ) { transform_xyz_range( m, in, out, begin, end, 1.0f ); } );
+}
+
+void transform_points( const mat4& m, const vec3* in, vec3* out, int count, int n_threads ) {
+  if ( count <= 0 ) { return; } // in may be empty, in[0] isn't there
+  // vec3 is just float v[3] so an array of them is a packed xyz array
+  transform_points( m, in[0].v, out[0].v, count, n_threads );
+}
+
+void transform_directions( const mat4& m, const vec3* in, vec3* out, int count, int n_threads ) {
+  if ( count <= 0 ) { return; }
+  const float* fin = in[0].v;
+  float* fout      = out[0].v;
+  run_chunked( count, n_threads, [&]( int begin, int end ) { transform_xyz_range( m, fin, fout, begin, end, 0.0f ); } );
+}
+
+void transform_vec4s( const mat4& m, const vec4* in, vec4* out, int count, int n_threads ) {
+  run_chunked( count, n_threads, [&]( int begin, int end ) {
+    simd4f c0 = simd4f_load( &m.m[0] );
+    simd4f c1 = simd4f_load( &m.m[4] );
+    simd4f c2 = simd4f_load( &m.m[8] );
+    simd4f c3 = simd4f_load( &m.m[12] );
+    for ( int i = begin; i < end; i++ ) {
+      simd4f v = simd4f_load( in[i].v );
+      simd4f r = simd4f_mul( c0, SIMD4F_SPLAT_LANE( v, 0 ) );
+      r        = simd4f_madd( c1, SIMD4F_SPLAT_LANE( v, 1 ), r );
+      r        = simd4f_madd( c2, SIMD4F_SPLAT_LANE( v, 2 ), r );
+      r        = simd4f_madd( c3, SIMD4F_SPLAT_LANE( v, 3 ), r );
+      simd4f_store( out[i].v, r );
+    }
+  } );
+}
+
+// r = a * b with a's columns already in registers. r may alias b
+static MATHS_FORCE_INLINE void mul_mat4_cols( simd4f c0, simd4f c1, simd4f c2, simd4f c3, const float* b, float* r ) {
+  simd4f b0 = simd4f_load( b );
+  simd4f b1 = simd4f_load( b + 4 );
+  simd4f b2 = simd4f_load( b + 8 );
+  simd4f b3 = simd4f_load( b + 12 );
+  simd4f bc[4] = { b0, b1, b2, b3 };
+  for ( int col = 0; col < 4; col++ ) {
+    simd4f sum = simd4f_mul( c0, SIMD4F_SPLAT_LANE( bc[col], 0 ) );
+    sum        = simd4f_madd( c1, SIMD4F_SPLAT_LANE( bc[col], 1 ), sum );
+    sum        = simd4f_madd( c2, SIMD4F_SPLAT_LANE( bc[col], 2 ), sum );
+    sum        = simd4f_madd( c3, SIMD4F_SPLAT_LANE( bc[col], 3 ), sum );
+    simd4f_store( r + col * 4, sum );
+  }
+}
+
+void mul_mat4_array( const mat4& lhs, const mat4* in, mat4* out, int count, int n_threads ) {
+  run_chunked( count, n_threads, [&]( int begin, int end ) {
+    simd4f c0 = simd4f_load( &lhs.m[0] );
+    simd4f c1 = simd4f_load( &lhs.m[4] );
+    simd4f c2 = simd4f_load( &lhs.m[8] );
+    simd4f c3 = simd4f_load( &lhs.m[12] );
+    for ( int i = begin; i < end; i++ ) { mul_mat4_cols( c0, c1, c2, c3, in[i].m, out[i].m ); }
+  } );
+}
+
+void mul_mat4_arrays( const mat4* a, const mat4* b, mat4* out, int count, int n_threads ) {
+  run_chunked( count, n_threads, [&]( int begin, int end ) {
+    for ( int i = begin; i < end; i++ ) {
+      simd4f c0 = simd4f_load( &a[i].m[0] );
+      simd4f c1 = simd4f_load( &a[i].m[4] );
+      simd4f c2 = simd4f_load( &a[i].m[8] );
+      simd4f c3 = simd4f_load( &a[i].m[12] );
+      mul_mat4_cols( c0, c1, c2, c3, b[i].m, out[i].m );
+    }
+  } );
+}
@@ -0,0 +1,40 @@
+/******************************************************************************\
+| Batch versions of the mat4 transforms in math_funcs.h                        |
+| Work on contiguous arrays so a whole vertex cloud or node list goes through  |
+| one call instead of N out-of-line operator calls. The inner loops use the    |
+| maths_simd.h layer (4 points / 1 matrix column per register).                |
+| in and out may be the same array. n_threads > 1 splits the array into        |
+| chunks run on a pool of worker threads, started on first use and kept;       |
+| n_threads <= 0 means "one per hardware core". Small batches always run on    |
+| the calling thread.                                                          |
+\******************************************************************************/
+#ifndef _MATH_BATCH_H_
+#define _MATH_BATCH_H_
+
+#include "math_funcs.h"
+
+// out[i] = m * vec4( in[i], 1 )  - positions
+void transform_points( const mat4& m, const vec3* in, vec3* out, int count, int n_threads = 1 );
+// same for a flat x,y,z,x,y,z... float array like the points[] fed to glBufferData
+void transform_points( const mat4& m, const float* in, float* out, int count, int n_threads = 1 );
+// out[i] = m * vec4( in[i], 0 ) - directions, ignores translation
+void transform_directions( const mat4& m, const vec3* in, vec3* out, int count, int n_threads = 1 );
+// out[i] = m * in[i]
+void transform_vec4s( const mat4& m, const vec4* in, vec4* out, int count, int n_threads = 1 );
+// out[i] = lhs * in[i] - e.g. view-projection times every model matrix
+void mul_mat4_array( const mat4& lhs, const mat4* in, mat4* out, int count, int n_threads = 1 );
+// out[i] = a[i] * b[i] - e.g. joint world matrices times inverse bind poses
+void mul_mat4_arrays( const mat4* a, const mat4* b, mat4* out, int count, int n_threads = 1 );
+
+/* the pool behind the functions above, for other chunked work. runs
+fn( ctx, begin, end ) on [0, count) in chunks of chunk elements (the last one
+may be short), spread over up to n_threads threads including the caller, and
+returns once all are done. with one thread, a busy pool or from inside another
+chunk, every chunk runs in turn on the calling thread */
+void batch_for_chunks( int count, int chunk, int n_threads, void ( *fn )( void*, int, int ), void* ctx );
+// the same with fn( begin, end ), e.g. a lambda
+template <typename F> void batch_for_chunks( int count, int chunk, int n_threads, F fn ) {
+  batch_for_chunks( count, chunk, n_threads, []( void* ctx, int begin, int end ) { ( *(F*)ctx )( begin, end ); }, &fn );
+}
+
+#endif
@@ -7,19 +7,93 @@
 | See individual libraries' separate legal notices                             |
 |******************************************************************************|
 | Commonly-used maths structures and functions                                 |
-| Simple-as-possible. No templates. Not optimised.                             |
+| Simple-as-possible. No templates. mat4 kernels use SIMD, see maths_simd.h   |
 | Structs vec3, mat4, versor. just hold arrays of floats called "v","m","q",   |
 | respectively. So, for example, to get values from a mat4 do: my_mat.m        |
 | A versor is the proper name for a unit quaternion.                           |
 | This is C++ because it's sort-of convenient to be able to use maths operators|
+|******************************************************************************|
+| Header-only. Everything is inline so small ops fold into the render loop     |
+| without LTO, and anything that doesn't need SIMD or libm is constexpr so     |
+| constant matrices can be built at compile time. The structs are trivially   |
+| copyable; default construction leaves them uninitialised as before.         |
 \******************************************************************************/
 #ifndef _MATHS_FUNCS_H_
 #define _MATHS_FUNCS_H_
 
+#include "maths_simd.h"
+#include <math.h>
+#include <stdio.h>
+#include <limits>
+#include <type_traits>
+
 // const used to convert degrees into radians
-#define TAU 2.0 * M_PI
-#define ONE_DEG_IN_RAD ( 2.0 * M_PI ) / 360.0 // 0.017444444
-#define ONE_RAD_IN_DEG 360.0 / ( 2.0 * M_PI ) // 57.2957795
+constexpr float TAU            = 6.28318530717958647692f;
+constexpr float ONE_DEG_IN_RAD = TAU / 360.0f; // 0.017453292
+constexpr float ONE_RAD_IN_DEG = 360.0f / TAU; // 57.2957795
+
+/* libm isn't constexpr, so the few functions that need tan/sqrt use these.
+at run time they are always plain tanf/sqrtf; only in a constant expression,
+where the compiler can tell us it is in one, do they use a series / Newton
+iteration instead. compilers that can't tell (before GCC 9 or MSVC 19.25,
+clang without the builtin) keep tanf/sqrtf and lose compile-time use */
+#if defined( __cpp_lib_is_constant_evaluated )
+#define MATHS_IS_CONSTANT_EVALUATED() std::is_constant_evaluated()
+#elif ( defined( __GNUC__ ) && __GNUC__ >= 9 ) || ( defined( _MSC_VER ) && _MSC_VER >= 1925 )
+#define MATHS_IS_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#elif defined( __has_builtin )
+#if __has_builtin( __builtin_is_constant_evaluated )
+#define MATHS_IS_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#endif
+#endif
+
+// tan(x) for |x| < pi/2 from the sin and cos series in double
+constexpr float maths_tan_series( float x ) {
+  double xd = x, x2 = xd * xd;
+  double s = 0.0, c = 0.0, term_s = xd, term_c = 1.0;
+  for ( int i = 1; i <= 12; i++ ) {
+    s += term_s;
+    c += term_c;
+    term_s *= -x2 / ( ( 2.0 * i ) * ( 2.0 * i + 1.0 ) );
+    term_c *= -x2 / ( ( 2.0 * i - 1.0 ) * ( 2.0 * i ) );
+  }
+  return (float)( s / c );
+}
+
+/* sqrtf in a constant expression. x is scaled by powers of 4 into [1, 4),
+which is exact, so Newton from ( y + 1 ) / 2 has converged in double within 6
+steps whatever the exponent. nan, inf, -0 and negatives come out as from
+sqrtf */
+constexpr float maths_sqrt_newton( float x ) {
+  if ( x != x || 0.0f == x || x > std::numeric_limits<float>::max() ) { return x; }
+  if ( x < 0.0f ) { return std::numeric_limits<float>::quiet_NaN(); }
+  double y = x, scale = 1.0;
+  while ( y >= 4.0 ) {
+    y *= 0.25;
+    scale *= 2.0;
+  }
+  while ( y < 1.0 ) {
+    y *= 4.0;
+    scale *= 0.5;
+  }
+  double r = 0.5 * ( y + 1.0 );
+  for ( int i = 0; i < 6; i++ ) { r = 0.5 * ( r + y / r ); }
+  return (float)( r * scale );
+}
+
+constexpr float maths_tan( float x ) {
+#if defined( MATHS_IS_CONSTANT_EVALUATED )
+  if ( MATHS_IS_CONSTANT_EVALUATED() ) { return maths_tan_series( x ); }
+#endif
+  return tanf( x );
+}
+
+constexpr float maths_sqrt( float x ) {
+#if defined( MATHS_IS_CONSTANT_EVALUATED )
+  if ( MATHS_IS_CONSTANT_EVALUATED() ) { return maths_sqrt_newton( x ); }
+#endif
+  return sqrtf( x );
+}
 
 struct vec2;
 struct vec3;
@@ -27,60 +101,75 @@ struct vec4;
 struct versor;
 
 struct vec2 {
-  vec2();
-  vec2( float x, float y );
+  vec2() = default;
+  constexpr vec2( float x, float y ) : v{ x, y } {}
   float v[2];
 };
 
 struct vec3 {
-  vec3();
+  vec3() = default;
   // create from 3 scalars
-  vec3( float x, float y, float z );
+  constexpr vec3( float x, float y, float z ) : v{ x, y, z } {}
   // create from vec2 and a scalar
-  vec3( const vec2& vv, float z );
+  constexpr vec3( const vec2& vv, float z ) : v{ vv.v[0], vv.v[1], z } {}
   // create from truncated vec4
-  vec3( const vec4& vv );
+  constexpr vec3( const vec4& vv );
   // add vector to vector
-  vec3 operator+( const vec3& rhs );
+  constexpr vec3 operator+( const vec3& rhs ) const { return vec3( v[0] + rhs.v[0], v[1] + rhs.v[1], v[2] + rhs.v[2] ); }
   // add scalar to vector
-  vec3 operator+( float rhs );
+  constexpr vec3 operator+( float rhs ) const { return vec3( v[0] + rhs, v[1] + rhs, v[2] + rhs ); }
   // because user's expect this too
-  vec3& operator+=( const vec3& rhs );
+  constexpr vec3& operator+=( const vec3& rhs ) {
+    v[0] += rhs.v[0];
+    v[1] += rhs.v[1];
+    v[2] += rhs.v[2];
+    return *this; // return self
+  }
   // subtract vector from vector
-  vec3 operator-( const vec3& rhs );
+  constexpr vec3 operator-( const vec3& rhs ) const { return vec3( v[0] - rhs.v[0], v[1] - rhs.v[1], v[2] - rhs.v[2] ); }
   // add vector to vector
-  vec3 operator-( float rhs );
+  constexpr vec3 operator-( float rhs ) const { return vec3( v[0] - rhs, v[1] - rhs, v[2] - rhs ); }
   // because users expect this too
-  vec3& operator-=( const vec3& rhs );
+  constexpr vec3& operator-=( const vec3& rhs ) {
+    v[0] -= rhs.v[0];
+    v[1] -= rhs.v[1];
+    v[2] -= rhs.v[2];
+    return *this;
+  }
   // multiply with scalar
-  vec3 operator*( float rhs );
+  constexpr vec3 operator*( float rhs ) const { return vec3( v[0] * rhs, v[1] * rhs, v[2] * rhs ); }
   // because users expect this too
-  vec3& operator*=( float rhs );
+  constexpr vec3& operator*=( float rhs ) {
+    v[0] = v[0] * rhs;
+    v[1] = v[1] * rhs;
+    v[2] = v[2] * rhs;
+    return *this;
+  }
   // divide vector by scalar
-  vec3 operator/( float rhs );
-  // because users expect this too
-  vec3& operator=( const vec3& rhs );
+  constexpr vec3 operator/( float rhs ) const { return vec3( v[0] / rhs, v[1] / rhs, v[2] / rhs ); }
 
   // internal data
   float v[3];
 };
 
 struct vec4 {
-  vec4();
-  vec4( float x, float y, float z, float w );
-  vec4( const vec2& vv, float z, float w );
-  vec4( const vec3& vv, float w );
+  vec4() = default;
+  constexpr vec4( float x, float y, float z, float w ) : v{ x, y, z, w } {}
+  constexpr vec4( const vec2& vv, float z, float w ) : v{ vv.v[0], vv.v[1], z, w } {}
+  constexpr vec4( const vec3& vv, float w ) : v{ vv.v[0], vv.v[1], vv.v[2], w } {}
   float v[4];
 };
 
+constexpr vec3::vec3( const vec4& vv ) : v{ vv.v[0], vv.v[1], vv.v[2] } {}
+
 /* stored like this:
 0 3 6
 1 4 7
 2 5 8 */
 struct mat3 {
-  mat3();
+  mat3() = default;
   // note! this is entering components in ROW-major order
-  mat3( float a, float b, float c, float d, float e, float f, float g, float h, float i );
+  constexpr mat3( float a, float b, float c, float d, float e, float f, float g, float h, float i ) : m{ a, b, c, d, e, f, g, h, i } {}
   float m[9];
 };
 
@@ -90,63 +179,645 @@ struct mat3 {
 2 6 10 14
 3 7 11 15*/
 struct mat4 {
-  mat4();
+  mat4() = default;
   // note! this is entering components in ROW-major order
-  mat4( float a, float b, float c, float d, float e, float f, float g, float h, float i, float j, float k, float l, float mm, float n, float o, float p );
-  vec4 operator*( const vec4& rhs );
-  mat4 operator*( const mat4& rhs );
-  mat4& operator=( const mat4& rhs );
+  constexpr mat4( float a, float b, float c, float d, float e, float f, float g, float h, float i, float j, float k, float l, float mm, float n, float o, float p )
+    : m{ a, b, c, d, e, f, g, h, i, j, k, l, mm, n, o, p } {}
+  vec4 operator*( const vec4& rhs ) const;
+  mat4 operator*( const mat4& rhs ) const;
   float m[16];
 };
 
 struct versor {
-  versor();
-  versor operator/( float rhs );
-  versor operator*( float rhs );
-  versor operator*( const versor& rhs );
-  versor operator+( const versor& rhs );
+  versor() = default;
+  constexpr versor( float w, float x, float y, float z ) : q{ w, x, y, z } {}
+  constexpr versor operator/( float rhs ) const { return versor( q[0] / rhs, q[1] / rhs, q[2] / rhs, q[3] / rhs ); }
+  constexpr versor operator*( float rhs ) const { return versor( q[0] * rhs, q[1] * rhs, q[2] * rhs, q[3] * rhs ); }
+  versor operator*( const versor& rhs ) const;
+  versor operator+( const versor& rhs ) const;
   float q[4];
 };
 
-void print( const vec2& v );
-void print( const vec3& v );
-void print( const vec4& v );
-void print( const mat3& m );
-void print( const mat4& m );
-// vector functions
-float length( const vec3& v );
-float length2( const vec3& v );
-vec3 normalise( const vec3& v );
-float dot( const vec3& a, const vec3& b );
-vec3 cross( const vec3& a, const vec3& b );
-float get_squared_dist( vec3 from, vec3 to );
-float direction_to_heading( vec3 d );
-vec3 heading_to_direction( float degrees );
-// matrix functions
-mat3 zero_mat3();
-mat3 identity_mat3();
-mat4 zero_mat4();
-mat4 identity_mat4();
-float determinant( const mat4& mm );
-mat4 inverse( const mat4& mm );
-mat4 transpose( const mat4& mm );
-// affine functions
-mat4 translate( const mat4& m, const vec3& v );
-mat4 rotate_x_deg( const mat4& m, float deg );
-mat4 rotate_y_deg( const mat4& m, float deg );
-mat4 rotate_z_deg( const mat4& m, float deg );
-mat4 scale( const mat4& m, const vec3& v );
-// camera functions
-mat4 look_at( const vec3& cam_pos, vec3 targ_pos, const vec3& up );
-mat4 perspective( float fovy, float aspect, float near, float far );
-// quaternion functions
-versor quat_from_axis_rad( float radians, float x, float y, float z );
-versor quat_from_axis_deg( float degrees, float x, float y, float z );
-mat4 quat_to_mat4( const versor& q );
-float dot( const versor& q, const versor& r );
-versor slerp( const versor& q, const versor& r );
+/*-----------------------------PRINT FUNCTIONS--------------------------------*/
+inline void print( const vec2& v ) { printf( "[%.2f, %.2f]\n", v.v[0], v.v[1] ); }
+
+inline void print( const vec3& v ) { printf( "[%.2f, %.2f, %.2f]\n", v.v[0], v.v[1], v.v[2] ); }
+
+inline void print( const vec4& v ) { printf( "[%.2f, %.2f, %.2f, %.2f]\n", v.v[0], v.v[1], v.v[2], v.v[3] ); }
+
+inline void print( const mat3& m ) {
+  printf( "\n" );
+  printf( "[%.2f][%.2f][%.2f]\n", m.m[0], m.m[3], m.m[6] );
+  printf( "[%.2f][%.2f][%.2f]\n", m.m[1], m.m[4], m.m[7] );
+  printf( "[%.2f][%.2f][%.2f]\n", m.m[2], m.m[5], m.m[8] );
+}
+
+inline void print( const mat4& m ) {
+  printf( "\n" );
+  printf( "[%.2f][%.2f][%.2f][%.2f]\n", m.m[0], m.m[4], m.m[8], m.m[12] );
+  printf( "[%.2f][%.2f][%.2f][%.2f]\n", m.m[1], m.m[5], m.m[9], m.m[13] );
+  printf( "[%.2f][%.2f][%.2f][%.2f]\n", m.m[2], m.m[6], m.m[10], m.m[14] );
+  printf( "[%.2f][%.2f][%.2f][%.2f]\n", m.m[3], m.m[7], m.m[11], m.m[15] );
+}
+
+/*------------------------------VECTOR FUNCTIONS------------------------------*/
+constexpr float length( const vec3& v ) { return maths_sqrt( v.v[0] * v.v[0] + v.v[1] * v.v[1] + v.v[2] * v.v[2] ); }
+
+// squared length
+constexpr float length2( const vec3& v ) { return v.v[0] * v.v[0] + v.v[1] * v.v[1] + v.v[2] * v.v[2]; }
+
+// note: proper spelling (hehe)
+constexpr vec3 normalise( const vec3& v ) {
+  float l = length( v );
+  if ( 0.0f == l ) { return vec3( 0.0f, 0.0f, 0.0f ); }
+  return vec3( v.v[0] / l, v.v[1] / l, v.v[2] / l );
+}
+
+constexpr float dot( const vec3& a, const vec3& b ) { return a.v[0] * b.v[0] + a.v[1] * b.v[1] + a.v[2] * b.v[2]; }
+
+constexpr vec3 cross( const vec3& a, const vec3& b ) {
+  float x = a.v[1] * b.v[2] - a.v[2] * b.v[1];
+  float y = a.v[2] * b.v[0] - a.v[0] * b.v[2];
+  float z = a.v[0] * b.v[1] - a.v[1] * b.v[0];
+  return vec3( x, y, z );
+}
+
+constexpr float get_squared_dist( vec3 from, vec3 to ) {
+  float x = ( to.v[0] - from.v[0] ) * ( to.v[0] - from.v[0] );
+  float y = ( to.v[1] - from.v[1] ) * ( to.v[1] - from.v[1] );
+  float z = ( to.v[2] - from.v[2] ) * ( to.v[2] - from.v[2] );
+  return x + y + z;
+}
+
+/* converts an un-normalised direction into a heading in degrees
+NB i suspect that the z is backwards here but i've used in in
+several places like this. d'oh! */
+inline float direction_to_heading( vec3 d ) { return atan2f( -d.v[0], -d.v[2] ) * ONE_RAD_IN_DEG; }
+
+inline vec3 heading_to_direction( float degrees ) {
+  float rad = degrees * ONE_DEG_IN_RAD;
+  return vec3( -sinf( rad ), 0.0f, -cosf( rad ) );
+}
+
+/*-----------------------------MATRIX FUNCTIONS-------------------------------*/
+constexpr mat3 zero_mat3() { return mat3( 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f ); }
+
+constexpr mat3 identity_mat3() { return mat3( 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f ); }
+
+constexpr mat4 zero_mat4() { return mat4( 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f ); }
+
+constexpr mat4 identity_mat4() { return mat4( 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f ); }
+
+/* mat4 array layout
+ 0  4  8 12
+ 1  5  9 13
+ 2  6 10 14
+ 3  7 11 15
+ each column is one simd4f register, see maths_simd.h
+*/
+
+MATHS_FORCE_INLINE vec4 mat4::operator*( const vec4& rhs ) const {
+  // x * col0 + y * col1 + z * col2 + w * col3
+  simd4f r = simd4f_mul( simd4f_load( &m[0] ), simd4f_splat( rhs.v[0] ) );
+  r        = simd4f_madd( simd4f_load( &m[4] ), simd4f_splat( rhs.v[1] ), r );
+  r        = simd4f_madd( simd4f_load( &m[8] ), simd4f_splat( rhs.v[2] ), r );
+  r        = simd4f_madd( simd4f_load( &m[12] ), simd4f_splat( rhs.v[3] ), r );
+  vec4 result;
+  simd4f_store( result.v, r );
+  return result;
+}
+
+MATHS_FORCE_INLINE mat4 mat4::operator*( const mat4& rhs ) const {
+  mat4 r;
+#if defined( MATHS_SIMD_SSE ) && defined( __AVX__ )
+  // two result columns per 256-bit register
+  __m256 c0 = _mm256_broadcast_ps( (const __m128*)&m[0] );
+  __m256 c1 = _mm256_broadcast_ps( (const __m128*)&m[4] );
+  __m256 c2 = _mm256_broadcast_ps( (const __m128*)&m[8] );
+  __m256 c3 = _mm256_broadcast_ps( (const __m128*)&m[12] );
+  for ( int col = 0; col < 4; col += 2 ) {
+    __m256 b   = _mm256_loadu_ps( &rhs.m[col * 4] );
+    __m256 sum = _mm256_mul_ps( c0, _mm256_shuffle_ps( b, b, 0x00 ) );
+#if defined( __FMA__ )
+    sum = _mm256_fmadd_ps( c1, _mm256_shuffle_ps( b, b, 0x55 ), sum );
+    sum = _mm256_fmadd_ps( c2, _mm256_shuffle_ps( b, b, 0xaa ), sum );
+    sum = _mm256_fmadd_ps( c3, _mm256_shuffle_ps( b, b, 0xff ), sum );
+#else
+    sum = _mm256_add_ps( sum, _mm256_mul_ps( c1, _mm256_shuffle_ps( b, b, 0x55 ) ) );
+    sum = _mm256_add_ps( sum, _mm256_mul_ps( c2, _mm256_shuffle_ps( b, b, 0xaa ) ) );
+    sum = _mm256_add_ps( sum, _mm256_mul_ps( c3, _mm256_shuffle_ps( b, b, 0xff ) ) );
+#endif
+    _mm256_storeu_ps( &r.m[col * 4], sum );
+  }
+#else
+  simd4f c0 = simd4f_load( &m[0] );
+  simd4f c1 = simd4f_load( &m[4] );
+  simd4f c2 = simd4f_load( &m[8] );
+  simd4f c3 = simd4f_load( &m[12] );
+  for ( int col = 0; col < 4; col++ ) {
+    const float* b = &rhs.m[col * 4];
+    simd4f sum     = simd4f_mul( c0, simd4f_splat( b[0] ) );
+    sum            = simd4f_madd( c1, simd4f_splat( b[1] ), sum );
+    sum            = simd4f_madd( c2, simd4f_splat( b[2] ), sum );
+    sum            = simd4f_madd( c3, simd4f_splat( b[3] ), sum );
+    simd4f_store( &r.m[col * 4], sum );
+  }
+#endif
+  return r;
+}
+
+/* 2x2 helpers for the block-wise determinant and inverse below. each simd4f
+holds a 2x2 matrix as (a, b, c, d) =
+a b
+c d */
+// A * B
+MATHS_FORCE_INLINE simd4f mat2_mul( simd4f a, simd4f b ) {
+  return simd4f_madd( a, SIMD4F_SHUFFLE( b, b, 0, 3, 0, 3 ), simd4f_mul( SIMD4F_SHUFFLE( a, a, 1, 0, 3, 2 ), SIMD4F_SHUFFLE( b, b, 2, 1, 2, 1 ) ) );
+}
+
+// adjugate(A) * B
+MATHS_FORCE_INLINE simd4f mat2_adj_mul( simd4f a, simd4f b ) {
+  return simd4f_sub( simd4f_mul( SIMD4F_SHUFFLE( a, a, 3, 3, 0, 0 ), b ), simd4f_mul( SIMD4F_SHUFFLE( a, a, 1, 1, 2, 2 ), SIMD4F_SHUFFLE( b, b, 2, 3, 0, 1 ) ) );
+}
+
+// A * adjugate(B)
+MATHS_FORCE_INLINE simd4f mat2_mul_adj( simd4f a, simd4f b ) {
+  return simd4f_sub( simd4f_mul( a, SIMD4F_SHUFFLE( b, b, 3, 0, 3, 0 ) ), simd4f_mul( SIMD4F_SHUFFLE( a, a, 1, 0, 3, 2 ), SIMD4F_SHUFFLE( b, b, 2, 1, 2, 1 ) ) );
+}
+
+/* the 4x4 is split into four 2x2 blocks
+| A B |
+| C D |
+and |M| = |A||D| + |B||C| - tr( adj(A)B adj(D)C ). det(M) == det(transpose(M))
+so the columns can be fed in as if they were rows. see
+https://lxjk.github.io/2017/09/03/Fast-4x4-Matrix-Inverse-with-SSE-SIMD-Explained.html
+*/
+struct mat4_blocks {
+  simd4f a, b, c, d;     // the blocks
+  simd4f det_sub;        // ( |A|, |B|, |C|, |D| )
+  simd4f a_b, d_c;       // adj(A)B and adj(D)C
+  simd4f det;            // |M| in every lane
+};
+
+MATHS_FORCE_INLINE void mat4_split_blocks( const mat4& mm, mat4_blocks& bl ) {
+  simd4f r0 = simd4f_load( &mm.m[0] );
+  simd4f r1 = simd4f_load( &mm.m[4] );
+  simd4f r2 = simd4f_load( &mm.m[8] );
+  simd4f r3 = simd4f_load( &mm.m[12] );
+  bl.a      = SIMD4F_SHUFFLE( r0, r1, 0, 1, 0, 1 );
+  bl.b      = SIMD4F_SHUFFLE( r0, r1, 2, 3, 2, 3 );
+  bl.c      = SIMD4F_SHUFFLE( r2, r3, 0, 1, 0, 1 );
+  bl.d      = SIMD4F_SHUFFLE( r2, r3, 2, 3, 2, 3 );
+  bl.det_sub =
+    simd4f_sub( simd4f_mul( SIMD4F_SHUFFLE( r0, r2, 0, 2, 0, 2 ), SIMD4F_SHUFFLE( r1, r3, 1, 3, 1, 3 ) ), simd4f_mul( SIMD4F_SHUFFLE( r0, r2, 1, 3, 1, 3 ), SIMD4F_SHUFFLE( r1, r3, 0, 2, 0, 2 ) ) );
+  bl.a_b = mat2_adj_mul( bl.a, bl.b );
+  bl.d_c = mat2_adj_mul( bl.d, bl.c );
+  // |A||D| + |B||C|
+  simd4f det = simd4f_madd( SIMD4F_SPLAT_LANE( bl.det_sub, 0 ), SIMD4F_SPLAT_LANE( bl.det_sub, 3 ),
+    simd4f_mul( SIMD4F_SPLAT_LANE( bl.det_sub, 1 ), SIMD4F_SPLAT_LANE( bl.det_sub, 2 ) ) );
+  // - tr( adj(A)B adj(D)C ), horizontal sum left in every lane
+  simd4f tr = simd4f_mul( bl.a_b, SIMD4F_SHUFFLE( bl.d_c, bl.d_c, 0, 2, 1, 3 ) );
+  tr        = simd4f_add( tr, SIMD4F_SHUFFLE( tr, tr, 1, 0, 3, 2 ) );
+  tr        = simd4f_add( tr, SIMD4F_SHUFFLE( tr, tr, 2, 3, 0, 1 ) );
+  bl.det    = simd4f_sub( det, tr );
+}
+
+// returns a scalar value with the determinant for a 4x4 matrix
+inline float determinant( const mat4& mm ) {
+  mat4_blocks bl;
+  mat4_split_blocks( mm, bl );
+  return simd4f_get_x( bl.det );
+}
+
+// affine fast path, defined with the affine functions below
+constexpr bool is_affine( const mat4& m );
+inline mat4 inverse_affine( const mat4& m, bool* invertible = NULL );
+
+/* returns a 16-element array that is the inverse of a 16-element array (4x4
+matrix). block-wise inverse, each block of the result is
+1/|M| * adj( |D|A - B adj(D)C ) etc. */
+inline mat4 inverse( const mat4& mm ) {
+  // nearly everything we invert comes from look_at/translate/rotate/scale
+  if ( is_affine( mm ) ) {
+    bool invertible;
+    mat4 r = inverse_affine( mm, &invertible );
+    if ( invertible ) { return r; }
+  }
+  mat4_blocks bl;
+  mat4_split_blocks( mm, bl );
+  float det = simd4f_get_x( bl.det );
+  /* there is no inverse if determinant is zero (not likely unless scale is
+  broken) */
+  if ( 0.0f == det ) {
+    fprintf( stderr, "WARNING. matrix has no determinant. can not invert\n" );
+    return mm;
+  }
+  simd4f det_a = SIMD4F_SPLAT_LANE( bl.det_sub, 0 );
+  simd4f det_b = SIMD4F_SPLAT_LANE( bl.det_sub, 1 );
+  simd4f det_c = SIMD4F_SPLAT_LANE( bl.det_sub, 2 );
+  simd4f det_d = SIMD4F_SPLAT_LANE( bl.det_sub, 3 );
+  // adjugates of the result blocks
+  simd4f x = simd4f_sub( simd4f_mul( det_d, bl.a ), mat2_mul( bl.b, bl.d_c ) );
+  simd4f w = simd4f_sub( simd4f_mul( det_a, bl.d ), mat2_mul( bl.c, bl.a_b ) );
+  simd4f y = simd4f_sub( simd4f_mul( det_b, bl.c ), mat2_mul_adj( bl.d, bl.a_b ) );
+  simd4f z = simd4f_sub( simd4f_mul( det_c, bl.b ), mat2_mul_adj( bl.a, bl.d_c ) );
+  // ( 1/|M|, -1/|M|, -1/|M|, 1/|M| ) applies the adjugate sign pattern too
+  simd4f inv_det = simd4f_div( simd4f_set( 1.0f, -1.0f, -1.0f, 1.0f ), bl.det );
+  x              = simd4f_mul( x, inv_det );
+  y              = simd4f_mul( y, inv_det );
+  z              = simd4f_mul( z, inv_det );
+  w              = simd4f_mul( w, inv_det );
+  // undo the adjugate swizzle while re-assembling the columns
+  mat4 r;
+  simd4f_store( &r.m[0], SIMD4F_SHUFFLE( x, y, 3, 1, 3, 1 ) );
+  simd4f_store( &r.m[4], SIMD4F_SHUFFLE( x, y, 2, 0, 2, 0 ) );
+  simd4f_store( &r.m[8], SIMD4F_SHUFFLE( z, w, 3, 1, 3, 1 ) );
+  simd4f_store( &r.m[12], SIMD4F_SHUFFLE( z, w, 2, 0, 2, 0 ) );
+  return r;
+}
+
+// returns a 16-element array flipped on the main diagonal
+inline mat4 transpose( const mat4& mm ) {
+  simd4f c0 = simd4f_load( &mm.m[0] );
+  simd4f c1 = simd4f_load( &mm.m[4] );
+  simd4f c2 = simd4f_load( &mm.m[8] );
+  simd4f c3 = simd4f_load( &mm.m[12] );
+  SIMD4F_TRANSPOSE( c0, c1, c2, c3 );
+  mat4 r;
+  simd4f_store( &r.m[0], c0 );
+  simd4f_store( &r.m[4], c1 );
+  simd4f_store( &r.m[8], c2 );
+  simd4f_store( &r.m[12], c3 );
+  return r;
+}
+/*--------------------------AFFINE MATRIX FUNCTIONS---------------------------*/
+/* the pre_* functions apply the transform after m ( m = T * m ) which only
+touches the affected rows, the post_* ones apply it before ( m = m * T ) which
+only touches the affected columns. neither builds the full 4x4 or does a
+64-multiply product. translate(), rotate_*_deg() and scale() are the copying
+pre-multiply versions kept for existing code. */
+
+// sin and cos of an angle in degrees in one call where libm has it
+inline void sin_cos_deg( float deg, float* s, float* c ) {
+  float rad = deg * ONE_DEG_IN_RAD;
+#if defined( __GLIBC__ ) && defined( _GNU_SOURCE )
+  sincosf( rad, s, c );
+#else
+  *s = sinf( rad );
+  *c = cosf( rad );
+#endif
+}
+
+// rows a and b of m become ( c * a - s * b ) and ( s * a + c * b )
+inline void mat4_rotate_rows( mat4& m, int a, int b, float s, float c ) {
+  for ( int col = 0; col < 16; col += 4 ) {
+    float ra     = m.m[col + a];
+    float rb     = m.m[col + b];
+    m.m[col + a] = c * ra - s * rb;
+    m.m[col + b] = s * ra + c * rb;
+  }
+}
+
+// columns a and b of m become ( c * a + s * b ) and ( c * b - s * a )
+inline void mat4_rotate_cols( mat4& m, int a, int b, float s, float c ) {
+  simd4f ca = simd4f_load( &m.m[a * 4] );
+  simd4f cb = simd4f_load( &m.m[b * 4] );
+  simd4f vs = simd4f_splat( s );
+  simd4f vc = simd4f_splat( c );
+  simd4f_store( &m.m[a * 4], simd4f_madd( vs, cb, simd4f_mul( vc, ca ) ) );
+  simd4f_store( &m.m[b * 4], simd4f_sub( simd4f_mul( vc, cb ), simd4f_mul( vs, ca ) ) );
+}
+
+MATHS_FORCE_INLINE void pre_translate( mat4& m, const vec3& v ) {
+  // rows 0-2 += v * row 3. for affine m that is only the translation column
+  for ( int col = 0; col < 16; col += 4 ) {
+    float w = m.m[col + 3];
+    if ( 0.0f == w ) { continue; }
+    m.m[col + 0] += v.v[0] * w;
+    m.m[col + 1] += v.v[1] * w;
+    m.m[col + 2] += v.v[2] * w;
+  }
+}
+
+MATHS_FORCE_INLINE void post_translate( mat4& m, const vec3& v ) {
+  // column 3 += m * ( x, y, z, 0 )
+  simd4f t = simd4f_madd( simd4f_load( &m.m[0] ), simd4f_splat( v.v[0] ), simd4f_load( &m.m[12] ) );
+  t        = simd4f_madd( simd4f_load( &m.m[4] ), simd4f_splat( v.v[1] ), t );
+  t        = simd4f_madd( simd4f_load( &m.m[8] ), simd4f_splat( v.v[2] ), t );
+  simd4f_store( &m.m[12], t );
+}
+
+MATHS_FORCE_INLINE void pre_rotate_x_deg( mat4& m, float deg ) {
+  float s, c;
+  sin_cos_deg( deg, &s, &c );
+  mat4_rotate_rows( m, 1, 2, s, c );
+}
+
+MATHS_FORCE_INLINE void pre_rotate_y_deg( mat4& m, float deg ) {
+  float s, c;
+  sin_cos_deg( deg, &s, &c );
+  mat4_rotate_rows( m, 2, 0, s, c );
+}
+
+MATHS_FORCE_INLINE void pre_rotate_z_deg( mat4& m, float deg ) {
+  float s, c;
+  sin_cos_deg( deg, &s, &c );
+  mat4_rotate_rows( m, 0, 1, s, c );
+}
+
+MATHS_FORCE_INLINE void post_rotate_x_deg( mat4& m, float deg ) {
+  float s, c;
+  sin_cos_deg( deg, &s, &c );
+  mat4_rotate_cols( m, 1, 2, s, c );
+}
+
+MATHS_FORCE_INLINE void post_rotate_y_deg( mat4& m, float deg ) {
+  float s, c;
+  sin_cos_deg( deg, &s, &c );
+  mat4_rotate_cols( m, 2, 0, s, c );
+}
+
+MATHS_FORCE_INLINE void post_rotate_z_deg( mat4& m, float deg ) {
+  float s, c;
+  sin_cos_deg( deg, &s, &c );
+  mat4_rotate_cols( m, 0, 1, s, c );
+}
+
+MATHS_FORCE_INLINE void pre_scale( mat4& m, const vec3& v ) {
+  simd4f s = simd4f_set( v.v[0], v.v[1], v.v[2], 1.0f );
+  for ( int col = 0; col < 16; col += 4 ) { simd4f_store( &m.m[col], simd4f_mul( simd4f_load( &m.m[col] ), s ) ); }
+}
+
+MATHS_FORCE_INLINE void post_scale( mat4& m, const vec3& v ) {
+  for ( int col = 0; col < 3; col++ ) { simd4f_store( &m.m[col * 4], simd4f_mul( simd4f_load( &m.m[col * 4] ), simd4f_splat( v.v[col] ) ) ); }
+}
+
+// translate a 4d matrix with xyz array
+inline mat4 translate( const mat4& m, const vec3& v ) {
+  mat4 r = m;
+  pre_translate( r, v );
+  return r;
+}
+
+// rotate around x axis by an angle in degrees
+inline mat4 rotate_x_deg( const mat4& m, float deg ) {
+  mat4 r = m;
+  pre_rotate_x_deg( r, deg );
+  return r;
+}
+
+// rotate around y axis by an angle in degrees
+inline mat4 rotate_y_deg( const mat4& m, float deg ) {
+  mat4 r = m;
+  pre_rotate_y_deg( r, deg );
+  return r;
+}
+
+// rotate around z axis by an angle in degrees
+inline mat4 rotate_z_deg( const mat4& m, float deg ) {
+  mat4 r = m;
+  pre_rotate_z_deg( r, deg );
+  return r;
+}
+
+// scale a matrix by [x, y, z]
+inline mat4 scale( const mat4& m, const vec3& v ) {
+  mat4 r = m;
+  pre_scale( r, v );
+  return r;
+}
+
+/* model matrix T * R * S straight from translation, unit quaternion and scale.
+same rotation terms as quat_to_mat4, with each column scaled */
+constexpr mat4 compose_trs( const vec3& t, const versor& q, const vec3& s ) {
+  float w = q.q[0], x = q.q[1], y = q.q[2], z = q.q[3];
+  float x2 = x + x, y2 = y + y, z2 = z + z;
+  float xx = x * x2, yy = y * y2, zz = z * z2;
+  float xy = x * y2, xz = x * z2, yz = y * z2;
+  float wx = w * x2, wy = w * y2, wz = w * z2;
+  float sx = s.v[0], sy = s.v[1], sz = s.v[2];
+  return mat4( ( 1.0f - yy - zz ) * sx, ( xy + wz ) * sx, ( xz - wy ) * sx, 0.0f, ( xy - wz ) * sy, ( 1.0f - xx - zz ) * sy, ( yz + wx ) * sy, 0.0f, ( xz + wy ) * sz, ( yz - wx ) * sz,
+    ( 1.0f - xx - yy ) * sz, 0.0f, t.v[0], t.v[1], t.v[2], 1.0f );
+}
+
+/* affine matrices have 0 0 0 1 along the bottom row so they are just a 3x3
+linear part A and a translation t:
+| A t |   inverse is  | inv(A) -inv(A)t |
+| 0 1 |               | 0      1        |
+inv(A) has the rows c1 x c2, c2 x c0, c0 x c1 over det(A), where c0..c2 are
+the columns of A */
+constexpr bool is_affine( const mat4& m ) { return 0.0f == m.m[3] && 0.0f == m.m[7] && 0.0f == m.m[11] && 1.0f == m.m[15]; }
+
+// a x b in lanes 0-2, 0 in lane 3. ( a * b.yzx - a.yzx * b ).yzx
+MATHS_FORCE_INLINE simd4f simd4f_cross3( simd4f a, simd4f b ) {
+  simd4f c = simd4f_sub( simd4f_mul( a, SIMD4F_SHUFFLE( b, b, 1, 2, 0, 3 ) ), simd4f_mul( SIMD4F_SHUFFLE( a, a, 1, 2, 0, 3 ), b ) );
+  return SIMD4F_SHUFFLE( c, c, 1, 2, 0, 3 );
+}
+
+/* a singular A (det exactly 0) gives the identity, with *invertible set false
+when it is given. nothing is printed, so it is safe in per-object loops */
+inline mat4 inverse_affine( const mat4& m, bool* invertible ) {
+  // the bottom row is 0 so lane 3 of each column is too
+  simd4f c0 = simd4f_load( &m.m[0] );
+  simd4f c1 = simd4f_load( &m.m[4] );
+  simd4f c2 = simd4f_load( &m.m[8] );
+  simd4f r0 = simd4f_cross3( c1, c2 );
+  simd4f r1 = simd4f_cross3( c2, c0 );
+  simd4f r2 = simd4f_cross3( c0, c1 );
+  // dot( c0, r0 ), horizontal sum left in every lane
+  simd4f det = simd4f_mul( c0, r0 );
+  det        = simd4f_add( det, SIMD4F_SHUFFLE( det, det, 1, 0, 3, 2 ) );
+  det        = simd4f_add( det, SIMD4F_SHUFFLE( det, det, 2, 3, 0, 1 ) );
+  bool ok    = 0.0f != simd4f_get_x( det );
+  if ( invertible ) { *invertible = ok; }
+  if ( !ok ) { return identity_mat4(); }
+  simd4f inv_det = simd4f_div( simd4f_splat( 1.0f ), det );
+  r0             = simd4f_mul( r0, inv_det );
+  r1             = simd4f_mul( r1, inv_det );
+  r2             = simd4f_mul( r2, inv_det );
+  // rows to columns. r3 comes out 0 and is reused for the translation
+  simd4f r3 = simd4f_splat( 0.0f );
+  SIMD4F_TRANSPOSE( r0, r1, r2, r3 );
+  simd4f t = simd4f_load( &m.m[12] );
+  r3       = simd4f_madd( r0, SIMD4F_SPLAT_LANE( t, 0 ), r3 );
+  r3       = simd4f_madd( r1, SIMD4F_SPLAT_LANE( t, 1 ), r3 );
+  r3       = simd4f_madd( r2, SIMD4F_SPLAT_LANE( t, 2 ), r3 );
+  mat4 r;
+  simd4f_store( &r.m[0], r0 );
+  simd4f_store( &r.m[4], r1 );
+  simd4f_store( &r.m[8], r2 );
+  // -inv(A)t, with the 1 from the bottom row
+  simd4f_store( &r.m[12], simd4f_sub( simd4f_set( 0.0f, 0.0f, 0.0f, 1.0f ), r3 ) );
+  return r;
+}
+
+// for an orthonormal A, inv(A) == transpose(A)
+constexpr mat4 inverse_rigid( const mat4& m ) {
+  float tx = m.m[12], ty = m.m[13], tz = m.m[14];
+  return mat4( m.m[0], m.m[4], m.m[8], 0.0f, m.m[1], m.m[5], m.m[9], 0.0f, m.m[2], m.m[6], m.m[10], 0.0f, -( m.m[0] * tx + m.m[1] * ty + m.m[2] * tz ),
+    -( m.m[4] * tx + m.m[5] * ty + m.m[6] * tz ), -( m.m[8] * tx + m.m[9] * ty + m.m[10] * tz ), 1.0f );
+}
+
+/* columns 0-2 of b have a 0 in the bottom row so only 3 of a's columns
+contribute. the bottom row of the result falls out as 0 0 0 1 because a's is */
+inline mat4 mul_affine( const mat4& a, const mat4& b ) {
+  simd4f c0 = simd4f_load( &a.m[0] );
+  simd4f c1 = simd4f_load( &a.m[4] );
+  simd4f c2 = simd4f_load( &a.m[8] );
+  mat4 r;
+  for ( int col = 0; col < 3; col++ ) {
+    const float* bc = &b.m[col * 4];
+    simd4f sum      = simd4f_mul( c0, simd4f_splat( bc[0] ) );
+    sum             = simd4f_madd( c1, simd4f_splat( bc[1] ), sum );
+    sum             = simd4f_madd( c2, simd4f_splat( bc[2] ), sum );
+    simd4f_store( &r.m[col * 4], sum );
+  }
+  simd4f t = simd4f_madd( c0, simd4f_splat( b.m[12] ), simd4f_load( &a.m[12] ) );
+  t        = simd4f_madd( c1, simd4f_splat( b.m[13] ), t );
+  t        = simd4f_madd( c2, simd4f_splat( b.m[14] ), t );
+  simd4f_store( &r.m[12], t );
+  return r;
+}
+
+/* transpose(inv(A)) has the columns c1 x c2, c2 x c0, c0 x c1 over det(A). for
+a singular A the unscaled cofactors are returned - still fine for normals that
+get re-normalised in the shader */
+constexpr mat3 normal_mat3( const mat4& m ) {
+  vec3 c0( m.m[0], m.m[1], m.m[2] );
+  vec3 c1( m.m[4], m.m[5], m.m[6] );
+  vec3 c2( m.m[8], m.m[9], m.m[10] );
+  vec3 n0   = cross( c1, c2 );
+  vec3 n1   = cross( c2, c0 );
+  vec3 n2   = cross( c0, c1 );
+  float det = dot( c0, n0 );
+  if ( 0.0f != det ) {
+    float inv_det = 1.0f / det;
+    n0 *= inv_det;
+    n1 *= inv_det;
+    n2 *= inv_det;
+  }
+  return mat3( n0.v[0], n0.v[1], n0.v[2], n1.v[0], n1.v[1], n1.v[2], n2.v[0], n2.v[1], n2.v[2] );
+}
+
+/*-----------------------VIRTUAL CAMERA MATRIX FUNCTIONS----------------------*/
+// returns a view matrix using the opengl lookAt style. COLUMN ORDER.
+inline mat4 look_at( const vec3& cam_pos, vec3 targ_pos, const vec3& up ) {
+  // distance vector
+  vec3 d = targ_pos - cam_pos;
+  // forward vector
+  vec3 f = normalise( d );
+  // right vector
+  vec3 r = normalise( cross( f, up ) );
+  // real up vector
+  vec3 u   = normalise( cross( r, f ) );
+  mat4 ori = identity_mat4();
+  ori.m[0]  = r.v[0];
+  ori.m[4]  = r.v[1];
+  ori.m[8]  = r.v[2];
+  ori.m[1]  = u.v[0];
+  ori.m[5]  = u.v[1];
+  ori.m[9]  = u.v[2];
+  ori.m[2]  = -f.v[0];
+  ori.m[6]  = -f.v[1];
+  ori.m[10] = -f.v[2];
+  // ori * inverse translation, folded into the last column
+  post_translate( ori, vec3( -cam_pos.v[0], -cam_pos.v[1], -cam_pos.v[2] ) );
+  return ori;
+}
+
+// returns a perspective function mimicking the opengl projection style.
+constexpr mat4 perspective( float fovy, float aspect, float near, float far ) {
+  float fov_rad       = fovy * ONE_DEG_IN_RAD;
+  float inverse_range = 1.0f / maths_tan( fov_rad / 2.0f );
+  float sx            = inverse_range / aspect;
+  float sy            = inverse_range;
+  float sz            = -( far + near ) / ( far - near );
+  float pz            = -( 2.0f * far * near ) / ( far - near );
+  // bottom-right corner is zero
+  return mat4( sx, 0.0f, 0.0f, 0.0f, 0.0f, sy, 0.0f, 0.0f, 0.0f, 0.0f, sz, -1.0f, 0.0f, 0.0f, pz, 0.0f );
+}
+
+/*----------------------------HAMILTON IN DA HOUSE!---------------------------*/
+inline void print( const versor& q ) { printf( "[%.2f ,%.2f, %.2f, %.2f]\n", q.q[0], q.q[1], q.q[2], q.q[3] ); }
+
 // overloading wouldn't let me use const
-versor normalise( versor& q );
-void print( const versor& q );
-versor slerp( versor& q, versor& r, float t );
+inline versor normalise( versor& q ) {
+  // norm(q) = q / magnitude (q)
+  // magnitude (q) = sqrt (w*w + x*x...)
+  // only compute sqrt if interior sum != 1.0
+  float sum = q.q[0] * q.q[0] + q.q[1] * q.q[1] + q.q[2] * q.q[2] + q.q[3] * q.q[3];
+  // NB: floats have min 6 digits of precision
+  const float thresh = 0.0001f;
+  if ( fabsf( 1.0f - sum ) < thresh ) { return q; }
+  float mag = sqrtf( sum );
+  return q / mag;
+}
+
+MATHS_FORCE_INLINE versor versor::operator*( const versor& rhs ) const {
+  versor result;
+  result.q[0] = rhs.q[0] * q[0] - rhs.q[1] * q[1] - rhs.q[2] * q[2] - rhs.q[3] * q[3];
+  result.q[1] = rhs.q[0] * q[1] + rhs.q[1] * q[0] - rhs.q[2] * q[3] + rhs.q[3] * q[2];
+  result.q[2] = rhs.q[0] * q[2] + rhs.q[1] * q[3] + rhs.q[2] * q[0] - rhs.q[3] * q[1];
+  result.q[3] = rhs.q[0] * q[3] - rhs.q[1] * q[2] + rhs.q[2] * q[1] + rhs.q[3] * q[0];
+  // re-normalise in case of mangling
+  return normalise( result );
+}
+
+MATHS_FORCE_INLINE versor versor::operator+( const versor& rhs ) const {
+  versor result;
+  result.q[0] = rhs.q[0] + q[0];
+  result.q[1] = rhs.q[1] + q[1];
+  result.q[2] = rhs.q[2] + q[2];
+  result.q[3] = rhs.q[3] + q[3];
+  // re-normalise in case of mangling
+  return normalise( result );
+}
+
+inline versor quat_from_axis_rad( float radians, float x, float y, float z ) {
+  float s = sinf( radians * 0.5f );
+  return versor( cosf( radians * 0.5f ), s * x, s * y, s * z );
+}
+
+inline versor quat_from_axis_deg( float degrees, float x, float y, float z ) { return quat_from_axis_rad( ONE_DEG_IN_RAD * degrees, x, y, z ); }
+
+constexpr mat4 quat_to_mat4( const versor& q ) {
+  float w = q.q[0];
+  float x = q.q[1];
+  float y = q.q[2];
+  float z = q.q[3];
+  return mat4( 1.0f - 2.0f * y * y - 2.0f * z * z, 2.0f * x * y + 2.0f * w * z, 2.0f * x * z - 2.0f * w * y, 0.0f, 2.0f * x * y - 2.0f * w * z, 1.0f - 2.0f * x * x - 2.0f * z * z,
+    2.0f * y * z + 2.0f * w * x, 0.0f, 2.0f * x * z + 2.0f * w * y, 2.0f * y * z - 2.0f * w * x, 1.0f - 2.0f * x * x - 2.0f * y * y, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f );
+}
+
+constexpr float dot( const versor& q, const versor& r ) { return q.q[0] * r.q[0] + q.q[1] * r.q[1] + q.q[2] * r.q[2] + q.q[3] * r.q[3]; }
+
+inline versor slerp( versor& q, versor& r, float t ) {
+  // angle between q0-q1
+  float cos_half_theta = dot( q, r );
+  // as found here
+  // http://stackoverflow.com/questions/2886606/flipping-issue-when-interpolating-rotations-using-quaternions
+  // if dot product is negative then one quaternion should be negated, to make
+  // it take the short way around, rather than the long way
+  // yeah! and furthermore Susan, I had to recalculate the d.p. after this
+  if ( cos_half_theta < 0.0f ) {
+    for ( int i = 0; i < 4; i++ ) { q.q[i] *= -1.0f; }
+    cos_half_theta = dot( q, r );
+  }
+  // if qa=qb or qa=-qb then theta = 0 and we can return qa
+  if ( fabsf( cos_half_theta ) >= 1.0f ) { return q; }
+  // Calculate temporary values
+  float sin_half_theta = sqrtf( 1.0f - cos_half_theta * cos_half_theta );
+  // if theta = 180 degrees then result is not fully defined
+  // we could rotate around any axis normal to qa or qb
+  versor result;
+  if ( fabsf( sin_half_theta ) < 0.001f ) {
+    for ( int i = 0; i < 4; i++ ) { result.q[i] = ( 1.0f - t ) * q.q[i] + t * r.q[i]; }
+    return result;
+  }
+  float half_theta = acosf( cos_half_theta );
+  float a          = sinf( ( 1.0f - t ) * half_theta ) / sin_half_theta;
+  float b          = sinf( t * half_theta ) / sin_half_theta;
+  for ( int i = 0; i < 4; i++ ) { result.q[i] = q.q[i] * a + r.q[i] * b; }
+  return result;
+}
 #endif
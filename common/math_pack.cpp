@@ -0,0 +1,49 @@
+/******************************************************************************\
+| Quantised vertex attribute encoders. See math_pack.h                         |
+\******************************************************************************/
+#include "math_pack.h"
+#if defined( __F16C__ )
+#include <immintrin.h>
+#endif
+
+void encode_half( const float* in, uint16_t* out, int count ) {
+  int i = 0;
+#if defined( __F16C__ )
+  // vcvtps2ph rounds to nearest even too, so both paths give the same bits
+  for ( ; i + 4 <= count; i += 4 ) {
+    __m128i h = _mm_cvtps_ph( _mm_loadu_ps( in + i ), _MM_FROUND_TO_NEAREST_INT );
+    _mm_storel_epi64( (__m128i*)( out + i ), h );
+  }
+#endif
+  for ( ; i < count; i++ ) { out[i] = float_to_half( in[i] ); }
+}
+
+void decode_half( const uint16_t* in, float* out, int count ) {
+  int i = 0;
+#if defined( __F16C__ )
+  for ( ; i + 4 <= count; i += 4 ) { _mm_storeu_ps( out + i, _mm_cvtph_ps( _mm_loadl_epi64( (const __m128i*)( in + i ) ) ) ); }
+#endif
+  for ( ; i < count; i++ ) { out[i] = half_to_float( in[i] ); }
+}
+
+void encode_normals_2_10_10_10( const vec3* in, uint32_t* out, int count ) {
+  for ( int i = 0; i < count; i++ ) { out[i] = pack_snorm_2_10_10_10( in[i] ); }
+}
+
+void encode_normals_oct16( const vec3* in, int16_t* out, int count ) {
+  for ( int i = 0; i < count; i++ ) {
+    vec2 e         = oct_encode( in[i] );
+    out[i * 2]     = float_to_snorm16( e.v[0] );
+    out[i * 2 + 1] = float_to_snorm16( e.v[1] );
+  }
+}
+
+void encode_colours_unorm8( const float* in, int components, uint8_t* out, int count ) {
+  for ( int i = 0; i < count; i++ ) {
+    const float* c = in + i * components;
+    out[i * 4]     = float_to_unorm8( c[0] );
+    out[i * 4 + 1] = float_to_unorm8( c[1] );
+    out[i * 4 + 2] = float_to_unorm8( c[2] );
+    out[i * 4 + 3] = components > 3 ? float_to_unorm8( c[3] ) : 255;
+  }
+}
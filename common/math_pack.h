@@ -0,0 +1,132 @@
+/******************************************************************************\
+| Quantised vertex attribute encodings                                         |
+| CPU-side encoders for smaller vertex formats, to go with the vertex_layout   |
+| helpers in mesh.h:                                                           |
+|   positions  GL_HALF_FLOAT x3         6 bytes (8 with padding) vs 12         |
+|   normals    GL_INT_2_10_10_10_REV    4 bytes, 0.1 deg worst error           |
+|              or octahedral GL_SHORT x2  4 bytes, 0.004 deg worst error       |
+|   colours    GL_UNSIGNED_BYTE x4      4 bytes vs 12 or 16                    |
+| All but the octahedral normal are decoded by the vertex fetch hardware, so   |
+| shaders keep their vec3/vec4 inputs. Octahedral normals arrive as a vec2 in  |
+| [-1, 1] and need oct_decode in the shader:                                   |
+|   vec3 oct_decode( vec2 e ) {                                                |
+|     vec3 n = vec3( e, 1.0 - abs( e.x ) - abs( e.y ) );                       |
+|     float t = max( -n.z, 0.0 );                                              |
+|     n.xy += vec2( n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t );                |
+|     return normalize( n );                                                   |
+|   }                                                                          |
+| snorm values are encoded with the GL 4.2 rule,                               |
+| c = round( f * ( 2^(b-1) - 1 ) ), so 0 and +-1 are exact. Older GL decodes   |
+| ( 2c + 1 ) / ( 2^b - 1 ) and is off by half a step.                          |
+\******************************************************************************/
+#ifndef _MATH_PACK_H_
+#define _MATH_PACK_H_
+
+#include "math_funcs.h"
+#include <stdint.h>
+#include <string.h>
+
+// IEEE binary16, round to nearest even. out of range goes to infinity
+inline uint16_t float_to_half( float f ) {
+  uint32_t x;
+  memcpy( &x, &f, 4 );
+  uint32_t sign = ( x >> 16 ) & 0x8000u;
+  uint32_t a    = x & 0x7fffffffu;
+  if ( a >= 0x7f800000u ) { return (uint16_t)( sign | ( a > 0x7f800000u ? 0x7e00u : 0x7c00u ) ); } // nan, inf
+  if ( a >= 0x477ff000u ) { return (uint16_t)( sign | 0x7c00u ); }                               // rounds past 65504
+  if ( a < 0x38800000u ) {
+    // subnormal half. 2^-25 and below round to 0
+    if ( a <= 0x33000000u ) { return (uint16_t)sign; }
+    uint32_t m     = ( a & 0x7fffffu ) | 0x800000u;
+    int shift      = 126 - (int)( a >> 23 );
+    uint32_t h     = m >> shift;
+    uint32_t rem   = m & ( ( 1u << shift ) - 1u );
+    uint32_t halfw = 1u << ( shift - 1 );
+    if ( rem > halfw || ( rem == halfw && ( h & 1u ) ) ) { h++; }
+    return (uint16_t)( sign | h );
+  }
+  // rebias the exponent from 127 to 15 and drop 13 mantissa bits
+  uint32_t h   = ( a - 0x38000000u ) >> 13;
+  uint32_t rem = a & 0x1fffu;
+  if ( rem > 0x1000u || ( rem == 0x1000u && ( h & 1u ) ) ) { h++; }
+  return (uint16_t)( sign | h );
+}
+
+inline float half_to_float( uint16_t h ) {
+  uint32_t sign = (uint32_t)( h & 0x8000u ) << 16;
+  uint32_t e    = ( h >> 10 ) & 0x1fu;
+  uint32_t m    = h & 0x3ffu;
+  uint32_t x;
+  if ( 0 == e ) {
+    if ( 0 == m ) {
+      x = sign;
+    } else {
+      // subnormal half, normal float
+      e = 113;
+      while ( !( m & 0x400u ) ) {
+        m <<= 1;
+        e--;
+      }
+      x = sign | ( e << 23 ) | ( ( m & 0x3ffu ) << 13 );
+    }
+  } else if ( 31 == e ) {
+    // nans come out quiet, as vcvtph2ps gives them
+    x = sign | 0x7f800000u | ( m << 13 ) | ( m ? 0x400000u : 0u );
+  } else {
+    x = sign | ( ( e + 112 ) << 23 ) | ( m << 13 );
+  }
+  float f;
+  memcpy( &f, &x, 4 );
+  return f;
+}
+
+constexpr float maths_clamp( float f, float lo, float hi ) { return f < lo ? lo : ( f > hi ? hi : f ); }
+constexpr int maths_round( float f ) { return (int)( f < 0.0f ? f - 0.5f : f + 0.5f ); }
+
+constexpr int16_t float_to_snorm16( float f ) { return (int16_t)maths_round( maths_clamp( f, -1.0f, 1.0f ) * 32767.0f ); }
+constexpr uint8_t float_to_unorm8( float f ) { return (uint8_t)maths_round( maths_clamp( f, 0.0f, 1.0f ) * 255.0f ); }
+
+// x, y, z as 10-bit and w as 2-bit snorms, x in the low bits. for GL_INT_2_10_10_10_REV
+constexpr uint32_t pack_snorm_2_10_10_10( const vec3& v, float w = 0.0f ) {
+  return ( (uint32_t)maths_round( maths_clamp( v.v[0], -1.0f, 1.0f ) * 511.0f ) & 0x3ffu ) |
+         ( ( (uint32_t)maths_round( maths_clamp( v.v[1], -1.0f, 1.0f ) * 511.0f ) & 0x3ffu ) << 10 ) |
+         ( ( (uint32_t)maths_round( maths_clamp( v.v[2], -1.0f, 1.0f ) * 511.0f ) & 0x3ffu ) << 20 ) |
+         ( ( (uint32_t)maths_round( maths_clamp( w, -1.0f, 1.0f ) ) & 0x3u ) << 30 );
+}
+
+/* a unit vector projected onto an octahedron and the lower half folded over
+the upper, giving 2 values in [-1, 1] that spread precision evenly over the
+sphere (Cigolle et al., "A Survey of Efficient Representations for Independent
+Unit Vectors", 2014) */
+inline vec2 oct_encode( const vec3& n ) {
+  float l1 = fabsf( n.v[0] ) + fabsf( n.v[1] ) + fabsf( n.v[2] );
+  if ( l1 <= 0.0f ) { return vec2( 0.0f, 0.0f ); }
+  float x = n.v[0] / l1, y = n.v[1] / l1;
+  if ( n.v[2] < 0.0f ) {
+    float fx = ( 1.0f - fabsf( y ) ) * ( x >= 0.0f ? 1.0f : -1.0f );
+    y        = ( 1.0f - fabsf( x ) ) * ( y >= 0.0f ? 1.0f : -1.0f );
+    x        = fx;
+  }
+  return vec2( x, y );
+}
+
+inline vec3 oct_decode( const vec2& e ) {
+  vec3 n( e.v[0], e.v[1], 1.0f - fabsf( e.v[0] ) - fabsf( e.v[1] ) );
+  float t = n.v[2] < 0.0f ? -n.v[2] : 0.0f;
+  n.v[0] += n.v[0] >= 0.0f ? -t : t;
+  n.v[1] += n.v[1] >= 0.0f ? -t : t;
+  return normalise( n );
+}
+
+// count floats to halves. 4 at a time with F16C when the compiler targets it
+void encode_half( const float* in, uint16_t* out, int count );
+void decode_half( const uint16_t* in, float* out, int count );
+// unit normals to GL_INT_2_10_10_10_REV words with w = 0
+void encode_normals_2_10_10_10( const vec3* in, uint32_t* out, int count );
+// unit normals to 2 GL_SHORT snorms each, octahedral
+void encode_normals_oct16( const vec3* in, int16_t* out, int count );
+/* colours of components (3 or 4) floats in [0, 1] to 4 GL_UNSIGNED_BYTEs each,
+alpha 255 when there are 3 */
+void encode_colours_unorm8( const float* in, int components, uint8_t* out, int count );
+
+#endif
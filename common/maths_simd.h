@@ -0,0 +1,255 @@
+/******************************************************************************\
+| Thin 4-wide float SIMD layer used by the maths code.                         |
+| Backend is picked at compile time:                                           |
+|   SSE  (any x86-64 build, AVX/FMA encodings used when the compiler has them) |
+|   NEON (AArch64 / ARMv7 with NEON)                                           |
+|   scalar fallback (anything else, or when MATHS_NO_SIMD is defined)          |
+| Everything works on 4 packed floats so a mat4 column or a vec4 maps onto one |
+| register. Loads and stores are unaligned - mat4/vec4 keep their plain float  |
+| arrays so they can still be handed straight to glUniformMatrix4fv etc.      |
+\******************************************************************************/
+#ifndef _MATHS_SIMD_H_
+#define _MATHS_SIMD_H_
+
+#if !defined( MATHS_NO_SIMD ) && ( defined( __SSE__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 1 ) )
+#define MATHS_SIMD_SSE 1
+#include <immintrin.h>
+#elif !defined( MATHS_NO_SIMD ) && ( defined( __ARM_NEON ) || defined( __ARM_NEON__ ) )
+#define MATHS_SIMD_NEON 1
+#include <arm_neon.h>
+#else
+#define MATHS_SIMD_SCALAR 1
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#endif
+
+#if defined( _MSC_VER )
+#define MATHS_FORCE_INLINE __forceinline
+#else
+#define MATHS_FORCE_INLINE inline __attribute__( ( always_inline ) )
+#endif
+
+/*-----------------------------------SSE--------------------------------------*/
+#if defined( MATHS_SIMD_SSE )
+typedef __m128 simd4f;
+
+MATHS_FORCE_INLINE simd4f simd4f_load( const float* p ) { return _mm_loadu_ps( p ); }
+MATHS_FORCE_INLINE void simd4f_store( float* p, simd4f a ) { _mm_storeu_ps( p, a ); }
+MATHS_FORCE_INLINE simd4f simd4f_splat( float s ) { return _mm_set1_ps( s ); }
+MATHS_FORCE_INLINE simd4f simd4f_set( float x, float y, float z, float w ) { return _mm_setr_ps( x, y, z, w ); }
+MATHS_FORCE_INLINE simd4f simd4f_add( simd4f a, simd4f b ) { return _mm_add_ps( a, b ); }
+MATHS_FORCE_INLINE simd4f simd4f_sub( simd4f a, simd4f b ) { return _mm_sub_ps( a, b ); }
+MATHS_FORCE_INLINE simd4f simd4f_mul( simd4f a, simd4f b ) { return _mm_mul_ps( a, b ); }
+MATHS_FORCE_INLINE simd4f simd4f_div( simd4f a, simd4f b ) { return _mm_div_ps( a, b ); }
+// a * b + c
+MATHS_FORCE_INLINE simd4f simd4f_madd( simd4f a, simd4f b, simd4f c ) {
+#if defined( __FMA__ )
+  return _mm_fmadd_ps( a, b, c );
+#else
+  return _mm_add_ps( _mm_mul_ps( a, b ), c );
+#endif
+}
+MATHS_FORCE_INLINE float simd4f_get_x( simd4f a ) { return _mm_cvtss_f32( a ); }
+MATHS_FORCE_INLINE simd4f simd4f_sqrt( simd4f a ) { return _mm_sqrt_ps( a ); }
+MATHS_FORCE_INLINE simd4f simd4f_min( simd4f a, simd4f b ) { return _mm_min_ps( a, b ); }
+MATHS_FORCE_INLINE simd4f simd4f_max( simd4f a, simd4f b ) { return _mm_max_ps( a, b ); }
+// comparisons give all-ones / all-zeros lanes, use with simd4f_and and simd4f_movemask
+MATHS_FORCE_INLINE simd4f simd4f_cmpgt( simd4f a, simd4f b ) { return _mm_cmpgt_ps( a, b ); }
+MATHS_FORCE_INLINE simd4f simd4f_cmplt( simd4f a, simd4f b ) { return _mm_cmplt_ps( a, b ); }
+MATHS_FORCE_INLINE simd4f simd4f_and( simd4f a, simd4f b ) { return _mm_and_ps( a, b ); }
+MATHS_FORCE_INLINE simd4f simd4f_or( simd4f a, simd4f b ) { return _mm_or_ps( a, b ); }
+// bit i set if lane i of the mask is set
+MATHS_FORCE_INLINE int simd4f_movemask( simd4f a ) { return _mm_movemask_ps( a ); }
+// ( a[x], a[y], b[z], b[w] ) - same semantics as _mm_shuffle_ps
+#define SIMD4F_SHUFFLE( a, b, x, y, z, w ) _mm_shuffle_ps( ( a ), ( b ), _MM_SHUFFLE( ( w ), ( z ), ( y ), ( x ) ) )
+// transposes the 4x4 block held in 4 registers in place
+#define SIMD4F_TRANSPOSE( r0, r1, r2, r3 ) _MM_TRANSPOSE4_PS( r0, r1, r2, r3 )
+
+/*-----------------------------------NEON-------------------------------------*/
+#elif defined( MATHS_SIMD_NEON )
+typedef float32x4_t simd4f;
+
+MATHS_FORCE_INLINE simd4f simd4f_load( const float* p ) { return vld1q_f32( p ); }
+MATHS_FORCE_INLINE void simd4f_store( float* p, simd4f a ) { vst1q_f32( p, a ); }
+MATHS_FORCE_INLINE simd4f simd4f_splat( float s ) { return vdupq_n_f32( s ); }
+MATHS_FORCE_INLINE simd4f simd4f_set( float x, float y, float z, float w ) {
+  float t[4] = { x, y, z, w };
+  return vld1q_f32( t );
+}
+MATHS_FORCE_INLINE simd4f simd4f_add( simd4f a, simd4f b ) { return vaddq_f32( a, b ); }
+MATHS_FORCE_INLINE simd4f simd4f_sub( simd4f a, simd4f b ) { return vsubq_f32( a, b ); }
+MATHS_FORCE_INLINE simd4f simd4f_mul( simd4f a, simd4f b ) { return vmulq_f32( a, b ); }
+MATHS_FORCE_INLINE simd4f simd4f_div( simd4f a, simd4f b ) {
+#if defined( __aarch64__ )
+  return vdivq_f32( a, b );
+#else
+  // reciprocal estimate plus two Newton-Raphson steps
+  float32x4_t r = vrecpeq_f32( b );
+  r             = vmulq_f32( vrecpsq_f32( b, r ), r );
+  r             = vmulq_f32( vrecpsq_f32( b, r ), r );
+  return vmulq_f32( a, r );
+#endif
+}
+MATHS_FORCE_INLINE simd4f simd4f_madd( simd4f a, simd4f b, simd4f c ) {
+#if defined( __aarch64__ )
+  return vfmaq_f32( c, a, b );
+#else
+  return vmlaq_f32( c, a, b );
+#endif
+}
+MATHS_FORCE_INLINE float simd4f_get_x( simd4f a ) { return vgetq_lane_f32( a, 0 ); }
+MATHS_FORCE_INLINE simd4f simd4f_sqrt( simd4f a ) {
+#if defined( __aarch64__ )
+  return vsqrtq_f32( a );
+#else
+  // a * 1/sqrt(a), refined twice. 0 stays 0
+  float32x4_t r = vrsqrteq_f32( a );
+  r             = vmulq_f32( vrsqrtsq_f32( vmulq_f32( a, r ), r ), r );
+  r             = vmulq_f32( vrsqrtsq_f32( vmulq_f32( a, r ), r ), r );
+  return vreinterpretq_f32_u32( vandq_u32( vreinterpretq_u32_f32( vmulq_f32( a, r ) ), vcgtq_f32( a, vdupq_n_f32( 0.0f ) ) ) );
+#endif
+}
+MATHS_FORCE_INLINE simd4f simd4f_min( simd4f a, simd4f b ) { return vminq_f32( a, b ); }
+MATHS_FORCE_INLINE simd4f simd4f_max( simd4f a, simd4f b ) { return vmaxq_f32( a, b ); }
+MATHS_FORCE_INLINE simd4f simd4f_cmpgt( simd4f a, simd4f b ) { return vreinterpretq_f32_u32( vcgtq_f32( a, b ) ); }
+MATHS_FORCE_INLINE simd4f simd4f_cmplt( simd4f a, simd4f b ) { return vreinterpretq_f32_u32( vcltq_f32( a, b ) ); }
+MATHS_FORCE_INLINE simd4f simd4f_and( simd4f a, simd4f b ) { return vreinterpretq_f32_u32( vandq_u32( vreinterpretq_u32_f32( a ), vreinterpretq_u32_f32( b ) ) ); }
+MATHS_FORCE_INLINE simd4f simd4f_or( simd4f a, simd4f b ) { return vreinterpretq_f32_u32( vorrq_u32( vreinterpretq_u32_f32( a ), vreinterpretq_u32_f32( b ) ) ); }
+MATHS_FORCE_INLINE int simd4f_movemask( simd4f a ) {
+  uint32x4_t bits = vshrq_n_u32( vreinterpretq_u32_f32( a ), 31 );
+  return (int)( vgetq_lane_u32( bits, 0 ) | ( vgetq_lane_u32( bits, 1 ) << 1 ) | ( vgetq_lane_u32( bits, 2 ) << 2 ) | ( vgetq_lane_u32( bits, 3 ) << 3 ) );
+}
+MATHS_FORCE_INLINE simd4f simd4f_shuffle_( simd4f a, simd4f b, int x, int y, int z, int w ) {
+  float ta[4], tb[4];
+  vst1q_f32( ta, a );
+  vst1q_f32( tb, b );
+  float t[4] = { ta[x], ta[y], tb[z], tb[w] };
+  return vld1q_f32( t );
+}
+#define SIMD4F_SHUFFLE( a, b, x, y, z, w ) simd4f_shuffle_( ( a ), ( b ), ( x ), ( y ), ( z ), ( w ) )
+#define SIMD4F_TRANSPOSE( r0, r1, r2, r3 )                                                                                                                                         \
+  do {                                                                                                                                                                             \
+    float32x4x2_t t01_ = vtrnq_f32( r0, r1 );                                                                                                                                      \
+    float32x4x2_t t23_ = vtrnq_f32( r2, r3 );                                                                                                                                      \
+    r0                 = vcombine_f32( vget_low_f32( t01_.val[0] ), vget_low_f32( t23_.val[0] ) );                                                                                \
+    r1                 = vcombine_f32( vget_low_f32( t01_.val[1] ), vget_low_f32( t23_.val[1] ) );                                                                                \
+    r2                 = vcombine_f32( vget_high_f32( t01_.val[0] ), vget_high_f32( t23_.val[0] ) );                                                                              \
+    r3                 = vcombine_f32( vget_high_f32( t01_.val[1] ), vget_high_f32( t23_.val[1] ) );                                                                              \
+  } while ( 0 )
+
+/*----------------------------------SCALAR------------------------------------*/
+#else
+struct simd4f {
+  float f[4];
+};
+
+MATHS_FORCE_INLINE simd4f simd4f_load( const float* p ) {
+  simd4f r = { { p[0], p[1], p[2], p[3] } };
+  return r;
+}
+MATHS_FORCE_INLINE void simd4f_store( float* p, simd4f a ) {
+  for ( int i = 0; i < 4; i++ ) { p[i] = a.f[i]; }
+}
+MATHS_FORCE_INLINE simd4f simd4f_splat( float s ) {
+  simd4f r = { { s, s, s, s } };
+  return r;
+}
+MATHS_FORCE_INLINE simd4f simd4f_set( float x, float y, float z, float w ) {
+  simd4f r = { { x, y, z, w } };
+  return r;
+}
+#define MATHS_SIMD4F_SCALAR_OP( name, op )                                                                                                                                         \
+  MATHS_FORCE_INLINE simd4f name( simd4f a, simd4f b ) {                                                                                                                           \
+    simd4f r;                                                                                                                                                                      \
+    for ( int i = 0; i < 4; i++ ) { r.f[i] = a.f[i] op b.f[i]; }                                                                                                                   \
+    return r;                                                                                                                                                                      \
+  }
+MATHS_SIMD4F_SCALAR_OP( simd4f_add, + )
+MATHS_SIMD4F_SCALAR_OP( simd4f_sub, - )
+MATHS_SIMD4F_SCALAR_OP( simd4f_mul, * )
+MATHS_SIMD4F_SCALAR_OP( simd4f_div, / )
+#undef MATHS_SIMD4F_SCALAR_OP
+MATHS_FORCE_INLINE simd4f simd4f_madd( simd4f a, simd4f b, simd4f c ) {
+  simd4f r;
+  for ( int i = 0; i < 4; i++ ) { r.f[i] = a.f[i] * b.f[i] + c.f[i]; }
+  return r;
+}
+MATHS_FORCE_INLINE float simd4f_get_x( simd4f a ) { return a.f[0]; }
+MATHS_FORCE_INLINE simd4f simd4f_sqrt( simd4f a ) {
+  simd4f r = { { sqrtf( a.f[0] ), sqrtf( a.f[1] ), sqrtf( a.f[2] ), sqrtf( a.f[3] ) } };
+  return r;
+}
+MATHS_FORCE_INLINE simd4f simd4f_min( simd4f a, simd4f b ) {
+  simd4f r;
+  for ( int i = 0; i < 4; i++ ) { r.f[i] = a.f[i] < b.f[i] ? a.f[i] : b.f[i]; }
+  return r;
+}
+MATHS_FORCE_INLINE simd4f simd4f_max( simd4f a, simd4f b ) {
+  simd4f r;
+  for ( int i = 0; i < 4; i++ ) { r.f[i] = a.f[i] > b.f[i] ? a.f[i] : b.f[i]; }
+  return r;
+}
+// masks are stored as float bit patterns so they can be and-ed with values
+MATHS_FORCE_INLINE float simd4f_mask_( bool set ) {
+  uint32_t bits = set ? 0xffffffffu : 0u;
+  float f;
+  memcpy( &f, &bits, sizeof( f ) );
+  return f;
+}
+MATHS_FORCE_INLINE simd4f simd4f_cmpgt( simd4f a, simd4f b ) {
+  simd4f r;
+  for ( int i = 0; i < 4; i++ ) { r.f[i] = simd4f_mask_( a.f[i] > b.f[i] ); }
+  return r;
+}
+MATHS_FORCE_INLINE simd4f simd4f_cmplt( simd4f a, simd4f b ) {
+  simd4f r;
+  for ( int i = 0; i < 4; i++ ) { r.f[i] = simd4f_mask_( a.f[i] < b.f[i] ); }
+  return r;
+}
+#define MATHS_SIMD4F_SCALAR_BITOP( name, op )                                                                                                                                      \
+  MATHS_FORCE_INLINE simd4f name( simd4f a, simd4f b ) {                                                                                                                           \
+    simd4f r;                                                                                                                                                                      \
+    for ( int i = 0; i < 4; i++ ) {                                                                                                                                                \
+      uint32_t ba, bb;                                                                                                                                                             \
+      memcpy( &ba, &a.f[i], 4 );                                                                                                                                                   \
+      memcpy( &bb, &b.f[i], 4 );                                                                                                                                                   \
+      ba = ba op bb;                                                                                                                                                               \
+      memcpy( &r.f[i], &ba, 4 );                                                                                                                                                   \
+    }                                                                                                                                                                              \
+    return r;                                                                                                                                                                      \
+  }
+MATHS_SIMD4F_SCALAR_BITOP( simd4f_and, & )
+MATHS_SIMD4F_SCALAR_BITOP( simd4f_or, | )
+#undef MATHS_SIMD4F_SCALAR_BITOP
+MATHS_FORCE_INLINE int simd4f_movemask( simd4f a ) {
+  int r = 0;
+  for ( int i = 0; i < 4; i++ ) {
+    uint32_t bits;
+    memcpy( &bits, &a.f[i], 4 );
+    r |= (int)( bits >> 31 ) << i;
+  }
+  return r;
+}
+MATHS_FORCE_INLINE simd4f simd4f_shuffle_( simd4f a, simd4f b, int x, int y, int z, int w ) {
+  simd4f r = { { a.f[x], a.f[y], b.f[z], b.f[w] } };
+  return r;
+}
+#define SIMD4F_SHUFFLE( a, b, x, y, z, w ) simd4f_shuffle_( ( a ), ( b ), ( x ), ( y ), ( z ), ( w ) )
+#define SIMD4F_TRANSPOSE( r0, r1, r2, r3 )                                                                                                                                         \
+  do {                                                                                                                                                                             \
+    simd4f c0_ = { { r0.f[0], r1.f[0], r2.f[0], r3.f[0] } };                                                                                                                       \
+    simd4f c1_ = { { r0.f[1], r1.f[1], r2.f[1], r3.f[1] } };                                                                                                                       \
+    simd4f c2_ = { { r0.f[2], r1.f[2], r2.f[2], r3.f[2] } };                                                                                                                       \
+    simd4f c3_ = { { r0.f[3], r1.f[3], r2.f[3], r3.f[3] } };                                                                                                                       \
+    r0         = c0_;                                                                                                                                                              \
+    r1         = c1_;                                                                                                                                                              \
+    r2         = c2_;                                                                                                                                                              \
+    r3         = c3_;                                                                                                                                                              \
+  } while ( 0 )
+#endif
+
+// broadcast one lane of a register, lane must be a constant 0..3
+#define SIMD4F_SPLAT_LANE( a, i ) SIMD4F_SHUFFLE( a, a, i, i, i, i )
+
+#endif
@@ -0,0 +1,267 @@
+#include "mesh.h"
+#include "logging.h"
+#include <string.h>
+#include <vector>
+
+// the vertex cache size vertex_cache_acmr is logged with, a typical FIFO
+#define MESH_ACMR_CACHE 16
+
+vertex_layout& vertex_layout::add(GLuint location, GLint components,
+				  GLenum type, GLboolean normalized)
+{
+  if (count < MESH_MAX_ATTRIBS) {
+    attribs[count++] = {location, components, type, normalized};
+  } else {
+    gl_log_err("ERROR: vertex_layout: more than %i attributes\n",
+	       MESH_MAX_ATTRIBS);
+  }
+  return *this;
+}
+
+static size_t type_bytes(GLenum type)
+{
+  switch (type) {
+  case GL_BYTE:
+  case GL_UNSIGNED_BYTE: return 1;
+  case GL_SHORT:
+  case GL_UNSIGNED_SHORT:
+  case GL_HALF_FLOAT: return 2;
+  case GL_INT:
+  case GL_UNSIGNED_INT:
+  case GL_FLOAT: return 4;
+  case GL_DOUBLE: return 8;
+  default: break;
+  }
+  return 0;
+}
+
+size_t vertex_layout::attrib_bytes(int i) const
+{
+  GLenum type = attribs[i].type;
+  if (GL_INT_2_10_10_10_REV == type ||
+      GL_UNSIGNED_INT_2_10_10_10_REV == type) {
+    return 4;
+  }
+  return type_bytes(type) * attribs[i].components;
+}
+
+size_t vertex_layout::attrib_stride(int i) const
+{
+  return (attrib_bytes(i) + 3) & ~(size_t)3;
+}
+
+size_t vertex_layout::vertex_bytes() const
+{
+  size_t bytes = 0;
+  for (int i = 0; i < count; i++) {
+    bytes += attrib_stride(i);
+  }
+  return bytes;
+}
+
+void pack_vertices(const vertex_layout& layout, const void* const* streams,
+		   int vertex_count, const uint32_t* remap,
+		   mesh_packing packing, void* out)
+{
+  unsigned char* data = (unsigned char*)out;
+  size_t vertex_bytes = layout.vertex_bytes();
+  size_t offset = 0;
+  for (int i = 0; i < layout.count; i++) {
+    size_t bytes = layout.attrib_bytes(i);
+    // where vertex 0 goes and how far apart vertices are
+    size_t step = MESH_INTERLEAVED == packing ? vertex_bytes
+      : layout.attrib_stride(i);
+    const unsigned char* src = (const unsigned char*)streams[i];
+    for (int v = 0; v < vertex_count; v++) {
+      uint32_t to = remap ? remap[v] : (uint32_t)v;
+      memcpy(data + offset + to * step, src + v * bytes, bytes);
+    }
+    offset += MESH_INTERLEAVED == packing ? layout.attrib_stride(i)
+      : layout.attrib_stride(i) * vertex_count;
+  }
+}
+
+void bind_instance_attribs(const vertex_layout& layout, GLuint buffer,
+			   GLintptr offset)
+{
+  GLsizei stride = (GLsizei)layout.vertex_bytes();
+  size_t attrib_offset = 0;
+  glBindBuffer(GL_ARRAY_BUFFER, buffer);
+  for (int i = 0; i < layout.count; i++) {
+    const vertex_attrib& a = layout.attribs[i];
+    glVertexAttribPointer(a.location, a.components, a.type, a.normalized,
+			  stride, (const void*)(offset + attrib_offset));
+    glVertexAttribDivisor(a.location, 1);
+    glEnableVertexAttribArray(a.location);
+    attrib_offset += layout.attrib_stride(i);
+  }
+}
+
+mesh::mesh()
+  : m_packing(MESH_INTERLEAVED), m_vao(0), m_vbo(0), m_ibo(0),
+    m_index_type(0), m_vertex_count(0), m_index_count(0)
+{
+}
+
+mesh::~mesh()
+{
+  destroy();
+}
+
+bool mesh::create(const vertex_layout& layout, const void* const* streams,
+		  int vertex_count, const uint32_t* indices, int index_count,
+		  mesh_packing packing, bool optimize)
+{
+  destroy();
+  if (layout.count <= 0 || vertex_count <= 0 || index_count % 3 != 0) {
+    gl_log_err("ERROR: mesh: %i attributes, %i vertices, %i indices\n",
+	       layout.count, vertex_count, index_count);
+    return false;
+  }
+  for (int i = 0; i < layout.count; i++) {
+    if (!layout.attrib_bytes(i) || !streams[i]) {
+      gl_log_err("ERROR: mesh: attribute %i has no data or an unknown type\n",
+		 i);
+      return false;
+    }
+  }
+  std::vector<uint32_t> ids;
+  if (indices && index_count > 0) {
+    ids.assign(indices, indices + index_count);
+    for (int i = 0; i < index_count; i++) {
+      if (ids[i] >= (uint32_t)vertex_count) {
+	gl_log_err("ERROR: mesh: index %u of %i vertices\n", ids[i],
+		   vertex_count);
+	return false;
+      }
+    }
+  }
+
+  // vertex v of the input is vertex remap[v] in the buffer
+  std::vector<uint32_t> remap(vertex_count);
+  for (int v = 0; v < vertex_count; v++) {
+    remap[v] = (uint32_t)v;
+  }
+  float acmr_before = 0.0f;
+  if (!ids.empty()) {
+    acmr_before = vertex_cache_acmr(ids.data(), index_count, MESH_ACMR_CACHE);
+    if (optimize) {
+      optimize_vertex_cache(ids.data(), index_count, vertex_count);
+      optimize_vertex_fetch(ids.data(), index_count, vertex_count,
+			    remap.data());
+    }
+  }
+
+  size_t vertex_bytes = layout.vertex_bytes();
+  std::vector<unsigned char> data(vertex_bytes * vertex_count);
+  pack_vertices(layout, streams, vertex_count, remap.data(), packing,
+		data.data());
+  std::vector<size_t> offsets(layout.count);
+  size_t offset = 0;
+  for (int i = 0; i < layout.count; i++) {
+    offsets[i] = offset;
+    offset += MESH_INTERLEAVED == packing ? layout.attrib_stride(i)
+      : layout.attrib_stride(i) * vertex_count;
+  }
+
+  glGenVertexArrays(1, &m_vao);
+  glBindVertexArray(m_vao);
+  glGenBuffers(1, &m_vbo);
+  glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+  glBufferData(GL_ARRAY_BUFFER, data.size(), data.data(), GL_STATIC_DRAW);
+  for (int i = 0; i < layout.count; i++) {
+    const vertex_attrib& a = layout.attribs[i];
+    GLsizei stride = (GLsizei)(MESH_INTERLEAVED == packing ? vertex_bytes
+			       : layout.attrib_stride(i));
+    glVertexAttribPointer(a.location, a.components, a.type, a.normalized,
+			  stride, (const void*)offsets[i]);
+    glEnableVertexAttribArray(a.location);
+  }
+  if (!ids.empty()) {
+    // the index buffer binding is part of the vertex array's state
+    glGenBuffers(1, &m_ibo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+    if (vertex_count <= 65536) {
+      std::vector<uint16_t> shorts(ids.begin(), ids.end());
+      glBufferData(GL_ELEMENT_ARRAY_BUFFER, shorts.size() * sizeof(uint16_t),
+		   shorts.data(), GL_STATIC_DRAW);
+      m_index_type = GL_UNSIGNED_SHORT;
+    } else {
+      glBufferData(GL_ELEMENT_ARRAY_BUFFER, ids.size() * sizeof(uint32_t),
+		   ids.data(), GL_STATIC_DRAW);
+      m_index_type = GL_UNSIGNED_INT;
+    }
+  }
+  glBindVertexArray(0);
+
+  m_layout = layout;
+  m_packing = packing;
+  m_vertex_count = vertex_count;
+  m_index_count = ids.empty() ? vertex_count - vertex_count % 3
+    : index_count;
+  if (!ids.empty()) {
+    GL_LOG_INFO("mesh", "%i vertices, %i triangles, %s indices, "
+		"ACMR %.3f -> %.3f\n", vertex_count, index_count / 3,
+		GL_UNSIGNED_SHORT == m_index_type ? "16-bit" : "32-bit",
+		acmr_before, vertex_cache_acmr(ids.data(), index_count,
+					       MESH_ACMR_CACHE));
+  }
+  return true;
+}
+
+void mesh::destroy()
+{
+  if (m_vao) {
+    glDeleteVertexArrays(1, &m_vao);
+    m_vao = 0;
+  }
+  if (m_vbo) {
+    glDeleteBuffers(1, &m_vbo);
+    m_vbo = 0;
+  }
+  if (m_ibo) {
+    glDeleteBuffers(1, &m_ibo);
+    m_ibo = 0;
+  }
+  m_index_type = 0;
+  m_vertex_count = 0;
+  m_index_count = 0;
+}
+
+void mesh::draw() const
+{
+  if (!m_vao || !m_index_count) {
+    return;
+  }
+  glBindVertexArray(m_vao);
+  if (m_index_type) {
+    glDrawElements(GL_TRIANGLES, m_index_count, m_index_type, NULL);
+  } else {
+    glDrawArrays(GL_TRIANGLES, 0, m_index_count);
+  }
+}
+
+void mesh::set_instance_buffer(const vertex_layout& layout, GLuint buffer,
+			       GLintptr offset)
+{
+  if (!m_vao) {
+    return;
+  }
+  glBindVertexArray(m_vao);
+  bind_instance_attribs(layout, buffer, offset);
+  glBindVertexArray(0);
+}
+
+void mesh::draw_instanced(int instance_count) const
+{
+  if (!m_vao || !m_index_count || instance_count <= 0) {
+    return;
+  }
+  glBindVertexArray(m_vao);
+  if (m_index_type) {
+    glDrawElementsInstanced(GL_TRIANGLES, m_index_count, m_index_type, NULL,
+			    instance_count);
+  } else {
+    glDrawArraysInstanced(GL_TRIANGLES, 0, m_index_count, instance_count);
+  }
+}
@@ -0,0 +1,137 @@
+#ifndef _MESH_H
+#define _MESH_H
+
+#include <GL/glew.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "vertex_cache.h"
+
+/* what one vertex is made of, as the shader sees it.
+  vertex_layout layout;
+  layout.add( 0, 3, GL_FLOAT ).add( 1, 3, GL_FLOAT );
+each attribute goes to a shader location and is components values of type,
+with normalized as for glVertexAttribPointer. packed types
+(GL_INT_2_10_10_10_REV, GL_UNSIGNED_INT_2_10_10_10_REV) take 4 components in
+one 32-bit word. every attribute starts on a 4-byte boundary. */
+#define MESH_MAX_ATTRIBS 8
+
+struct vertex_attrib {
+  GLuint location;
+  GLint components; // 1-4
+  GLenum type;      // GL_FLOAT, GL_HALF_FLOAT, GL_UNSIGNED_BYTE, ...
+  GLboolean normalized;
+};
+
+struct vertex_layout {
+  vertex_attrib attribs[MESH_MAX_ATTRIBS];
+  int count;
+
+  vertex_layout() : count(0) {}
+  vertex_layout& add(GLuint location, GLint components, GLenum type,
+		     GLboolean normalized = GL_FALSE);
+  // the quantised formats math_pack.h encodes
+  vertex_layout& add_half(GLuint location, GLint components)
+  {
+    return add(location, components, GL_HALF_FLOAT);
+  }
+  vertex_layout& add_normal_2_10_10_10(GLuint location)
+  {
+    return add(location, 4, GL_INT_2_10_10_10_REV, GL_TRUE);
+  }
+  // a vec2 in the shader, see oct_decode in math_pack.h
+  vertex_layout& add_normal_oct16(GLuint location)
+  {
+    return add(location, 2, GL_SHORT, GL_TRUE);
+  }
+  vertex_layout& add_colour_unorm8(GLuint location)
+  {
+    return add(location, 4, GL_UNSIGNED_BYTE, GL_TRUE);
+  }
+  // a mat4 shader input takes 4 locations, one vec4 column each
+  vertex_layout& add_mat4(GLuint location)
+  {
+    for (GLuint c = 0; c < 4; c++) {
+      add(location + c, 4, GL_FLOAT);
+    }
+    return *this;
+  }
+  // bytes of one value of attribute i, as given to create
+  size_t attrib_bytes(int i) const;
+  // attrib_bytes rounded up to the 4-byte boundary the next one starts on
+  size_t attrib_stride(int i) const;
+  // one interleaved vertex
+  size_t vertex_bytes() const;
+};
+
+/* interleaved puts each vertex's attributes next to each other, so a vertex
+is one fetch. separate keeps one tightly packed block per attribute in the
+same buffer, for passes that only read some of them (depth-only reads
+positions) */
+enum mesh_packing { MESH_INTERLEAVED, MESH_SEPARATE };
+
+/* a vertex array object with one vertex buffer and an index buffer, drawn
+with glDrawElements. indices come in as 32-bit and are stored as 16-bit when
+every vertex fits. unless told not to, create reorders the triangles for
+the post-transform vertex cache (optimize_vertex_cache) and then the vertices
+into the order the triangles first use them, so fetches walk forward through
+memory. */
+class mesh
+{
+public:
+  mesh();
+  ~mesh();
+  mesh(const mesh&) = delete;
+  mesh& operator=(const mesh&) = delete;
+
+  /* streams[i] is vertex_count tightly packed values of layout.attribs[i].
+  indices (index_count of them, a multiple of 3) may be NULL for an
+  unindexed triangle list. false, with the reason logged, on bad input */
+  bool create(const vertex_layout& layout, const void* const* streams,
+	      int vertex_count, const uint32_t* indices, int index_count,
+	      mesh_packing packing = MESH_INTERLEAVED, bool optimize = true);
+  void destroy();
+  // binds the vertex array and draws every triangle
+  void draw() const;
+
+  /* per-instance attributes, interleaved in buffer from offset with
+  layout.vertex_bytes() between instances, advancing once an instance
+  (glVertexAttribDivisor 1). the locations must not be used by the mesh's own
+  layout. a per-frame stream_buffer allocation means calling this each frame
+  with the new offset; it only changes the vertex array's pointers */
+  void set_instance_buffer(const vertex_layout& layout, GLuint buffer,
+			   GLintptr offset);
+  // every triangle, instance_count times in one draw call
+  void draw_instanced(int instance_count) const;
+
+  GLuint vao() const { return m_vao; }
+  GLuint vertex_buffer() const { return m_vbo; }
+  GLuint index_buffer() const { return m_ibo; }
+  // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, 0 without indices
+  GLenum index_type() const { return m_index_type; }
+  int vertex_count() const { return m_vertex_count; }
+  int index_count() const { return m_index_count; }
+  const vertex_layout& layout() const { return m_layout; }
+
+private:
+  vertex_layout m_layout;
+  mesh_packing m_packing;
+  GLuint m_vao;
+  GLuint m_vbo;
+  GLuint m_ibo;
+  GLenum m_index_type;
+  int m_vertex_count;
+  int m_index_count;
+};
+
+/* what mesh::create does with its streams: vertex v of the input goes to
+position remap[v] (v itself when remap is NULL), interleaved or one block per
+attribute. out holds layout.vertex_bytes() * vertex_count bytes */
+void pack_vertices(const vertex_layout& layout, const void* const* streams,
+		   int vertex_count, const uint32_t* remap,
+		   mesh_packing packing, void* out);
+/* points layout's attributes at buffer from offset, interleaved, advancing
+once an instance. acts on the vertex array that is bound */
+void bind_instance_attribs(const vertex_layout& layout, GLuint buffer,
+			   GLintptr offset);
+
+#endif
@@ -0,0 +1,439 @@
+#include "multi_draw.h"
+#include "logging.h"
+#include "math_batch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+// below this many objects per thread, spawning threads costs more than it saves
+#define MULTI_DRAW_MIN_PER_THREAD 4096
+// gpu_cull's work group size
+#define GPU_CULL_GROUP 64
+
+mesh_pool::mesh_pool()
+  : m_vao(0), m_vbo(0), m_ibo(0), m_max_vertices(0), m_max_indices(0),
+    m_vertices(0), m_indices(0), m_instance_buffer(0), m_instance_offset(0)
+{
+}
+
+mesh_pool::~mesh_pool()
+{
+  destroy();
+}
+
+bool mesh_pool::create(const vertex_layout& layout, int max_vertices,
+		       int max_indices)
+{
+  destroy();
+  if (layout.count <= 0 || max_vertices <= 0 || max_indices <= 0) {
+    gl_log_err("ERROR: mesh pool: %i attributes, %i vertices, %i indices\n",
+	       layout.count, max_vertices, max_indices);
+    return false;
+  }
+  size_t vertex_bytes = layout.vertex_bytes();
+  glGenVertexArrays(1, &m_vao);
+  glBindVertexArray(m_vao);
+  glGenBuffers(1, &m_vbo);
+  glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+  glBufferData(GL_ARRAY_BUFFER, vertex_bytes * max_vertices, NULL,
+	       GL_STATIC_DRAW);
+  size_t offset = 0;
+  for (int i = 0; i < layout.count; i++) {
+    const vertex_attrib& a = layout.attribs[i];
+    glVertexAttribPointer(a.location, a.components, a.type, a.normalized,
+			  (GLsizei)vertex_bytes, (const void*)offset);
+    glEnableVertexAttribArray(a.location);
+    offset += layout.attrib_stride(i);
+  }
+  // every mesh's indices count from its own first vertex, base_vertex moves
+  // them to where it is. 32-bit so the pool can pass 65536 vertices
+  glGenBuffers(1, &m_ibo);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * max_indices, NULL,
+	       GL_STATIC_DRAW);
+  glBindVertexArray(0);
+  m_layout = layout;
+  m_max_vertices = max_vertices;
+  m_max_indices = max_indices;
+  gl_log("mesh pool: room for %i vertices of %i bytes, %i indices, %s\n",
+	 max_vertices, (int)vertex_bytes, max_indices,
+	 has_multi_draw_indirect() ? "multi-draw indirect"
+	 : "glDrawElementsBaseVertex loop");
+  return true;
+}
+
+void mesh_pool::destroy()
+{
+  if (m_vao) {
+    glDeleteVertexArrays(1, &m_vao);
+    m_vao = 0;
+  }
+  if (m_vbo) {
+    glDeleteBuffers(1, &m_vbo);
+    m_vbo = 0;
+  }
+  if (m_ibo) {
+    glDeleteBuffers(1, &m_ibo);
+    m_ibo = 0;
+  }
+  m_meshes.clear();
+  m_max_vertices = m_max_indices = 0;
+  m_vertices = m_indices = 0;
+  m_instance_layout = vertex_layout();
+  m_instance_buffer = 0;
+  m_instance_offset = 0;
+}
+
+int mesh_pool::add(const void* const* streams, int vertex_count,
+		   const uint32_t* indices, int index_count, bool optimize)
+{
+  if (!m_vao) {
+    return -1;
+  }
+  std::vector<uint32_t> ids;
+  if (indices) {
+    ids.assign(indices, indices + index_count);
+  } else {
+    // an unindexed triangle list
+    for (int v = 0; v < vertex_count - vertex_count % 3; v++) {
+      ids.push_back((uint32_t)v);
+    }
+  }
+  if (vertex_count <= 0 || ids.empty() || ids.size() % 3 != 0) {
+    gl_log_err("ERROR: mesh pool: %i vertices, %i indices\n", vertex_count,
+	       (int)ids.size());
+    return -1;
+  }
+  if (m_vertices + vertex_count > m_max_vertices ||
+      m_indices + (int)ids.size() > m_max_indices) {
+    gl_log_err("ERROR: mesh pool: full, %i of %i vertices and %i of %i "
+	       "indices used\n", m_vertices, m_max_vertices, m_indices,
+	       m_max_indices);
+    return -1;
+  }
+  for (size_t i = 0; i < ids.size(); i++) {
+    if (ids[i] >= (uint32_t)vertex_count) {
+      gl_log_err("ERROR: mesh pool: index %u of %i vertices\n", ids[i],
+		 vertex_count);
+      return -1;
+    }
+  }
+  for (int i = 0; i < m_layout.count; i++) {
+    if (!streams[i]) {
+      gl_log_err("ERROR: mesh pool: attribute %i has no data\n", i);
+      return -1;
+    }
+  }
+
+  std::vector<uint32_t> remap;
+  if (optimize) {
+    remap.resize(vertex_count);
+    optimize_vertex_cache(ids.data(), (int)ids.size(), vertex_count);
+    optimize_vertex_fetch(ids.data(), (int)ids.size(), vertex_count,
+			  remap.data());
+  }
+  size_t vertex_bytes = m_layout.vertex_bytes();
+  std::vector<unsigned char> data(vertex_bytes * vertex_count);
+  pack_vertices(m_layout, streams, vertex_count,
+		remap.empty() ? NULL : remap.data(), MESH_INTERLEAVED,
+		data.data());
+  glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+  glBufferSubData(GL_ARRAY_BUFFER, vertex_bytes * m_vertices, data.size(),
+		  data.data());
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  // the element binding belongs to whichever vertex array is bound
+  glBindVertexArray(m_vao);
+  glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * m_indices,
+		  sizeof(uint32_t) * ids.size(), ids.data());
+  glBindVertexArray(0);
+
+  pool_mesh m;
+  m.first_index = (GLuint)m_indices;
+  m.index_count = (GLuint)ids.size();
+  m.base_vertex = m_vertices;
+  m.vertex_count = vertex_count;
+  m_meshes.push_back(m);
+  m_vertices += vertex_count;
+  m_indices += (int)ids.size();
+  return (int)m_meshes.size() - 1;
+}
+
+void mesh_pool::set_instance_buffer(const vertex_layout& layout,
+				    GLuint buffer, GLintptr offset)
+{
+  if (!m_vao) {
+    return;
+  }
+  glBindVertexArray(m_vao);
+  bind_instance_attribs(layout, buffer, offset);
+  glBindVertexArray(0);
+  m_instance_layout = layout;
+  m_instance_buffer = buffer;
+  m_instance_offset = offset;
+}
+
+void mesh_pool::draw(GLuint indirect_buffer, GLintptr offset,
+		     const draw_elements_command* commands, int count) const
+{
+  if (!m_vao || count <= 0) {
+    return;
+  }
+  glBindVertexArray(m_vao);
+  if (has_multi_draw_indirect()) {
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+				(const void*)offset, count, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    return;
+  }
+  if (!commands) {
+    static bool warned = false;
+    if (!warned) {
+      gl_log_err("ERROR: mesh pool: no multi-draw indirect and no commands "
+		 "in memory to loop over\n");
+      warned = true;
+    }
+    return;
+  }
+  // base_instance needs GL 4.2, so the instance attributes are moved instead
+  size_t instance_bytes = m_instance_layout.vertex_bytes();
+  for (int i = 0; i < count; i++) {
+    const draw_elements_command& c = commands[i];
+    if (!c.instance_count) {
+      continue;
+    }
+    if (m_instance_layout.count) {
+      bind_instance_attribs(m_instance_layout, m_instance_buffer,
+			    m_instance_offset + c.base_instance *
+			    instance_bytes);
+    }
+    const void* first = (const void*)(sizeof(uint32_t) * c.first_index);
+    if (1 == c.instance_count) {
+      glDrawElementsBaseVertex(GL_TRIANGLES, c.count, GL_UNSIGNED_INT, first,
+			       c.base_vertex);
+    } else {
+      glDrawElementsInstancedBaseVertex(GL_TRIANGLES, c.count,
+					GL_UNSIGNED_INT, first,
+					c.instance_count, c.base_vertex);
+    }
+  }
+  if (m_instance_layout.count) {
+    bind_instance_attribs(m_instance_layout, m_instance_buffer,
+			  m_instance_offset);
+  }
+}
+
+bool mesh_pool::has_multi_draw_indirect()
+{
+  static int has = -1;
+  if (has < 0) {
+    const char* off = getenv("GL_NO_MULTI_DRAW_INDIRECT");
+    bool turned_off = off && off[0] && strcmp(off, "0") != 0;
+    /* the commands' base_instance is only read with GL 4.2 or
+    ARB_base_instance. without it every draw would take object 0's data */
+    has = !turned_off &&
+      (GLEW_VERSION_4_3 ||
+       (GLEW_ARB_multi_draw_indirect &&
+	(GLEW_VERSION_4_2 || GLEW_ARB_base_instance)));
+  }
+  return has != 0;
+}
+
+/* commands for the visible objects in [begin, end), packed from
+commands + begin. returns how many */
+static int build_range(const mesh_pool& pool, const frustum& f,
+		       const int* meshes, const vec3_soa& centres,
+		       const float* radii, draw_elements_command* commands,
+		       int begin, int end)
+{
+  // cull_spheres on just this chunk's part of the streams
+  vec3_soa chunk;
+  chunk.x = centres.x + begin;
+  chunk.y = centres.y + begin;
+  chunk.z = centres.z + begin;
+  chunk.count = end - begin;
+  chunk.capacity = chunk.count;
+  std::vector<int> visible(end - begin);
+  int n = cull_spheres(f, chunk, radii + begin, visible.data());
+  draw_elements_command* out = commands + begin;
+  for (int i = 0; i < n; i++) {
+    int object = begin + visible[i];
+    const pool_mesh& m = pool.get(meshes[object]);
+    out[i].count = m.index_count;
+    out[i].instance_count = 1;
+    out[i].first_index = m.first_index;
+    out[i].base_vertex = m.base_vertex;
+    out[i].base_instance = (GLuint)object;
+  }
+  return n;
+}
+
+int build_draw_commands(const mesh_pool& pool, const frustum& f,
+			const int* meshes, const vec3_soa& centres,
+			const float* radii, draw_elements_command* commands,
+			int n_threads)
+{
+  int count = centres.count;
+  if (n_threads <= 0) {
+    n_threads = (int)std::thread::hardware_concurrency();
+  }
+  int max_threads = count / MULTI_DRAW_MIN_PER_THREAD;
+  if (n_threads > max_threads) {
+    n_threads = max_threads;
+  }
+  if (n_threads <= 1) {
+    return build_range(pool, f, meshes, centres, radii, commands, 0, count);
+  }
+  // chunks of whole groups of 8 keep the culling kernel's loads in step
+  int chunk = ((count + n_threads - 1) / n_threads + 7) & ~7;
+  int n_chunks = (count + chunk - 1) / chunk;
+  std::vector<int> written(n_chunks);
+  // on math_batch's worker pool, which stays up between frames
+  batch_for_chunks(count, chunk, n_threads, [&](int begin, int end) {
+    written[begin / chunk] = build_range(pool, f, meshes, centres, radii,
+					 commands, begin, end);
+  });
+  // each chunk's commands start where its objects do; close the gaps
+  int n = written[0];
+  for (int c = 1; c < n_chunks; c++) {
+    memmove(commands + n, commands + c * chunk,
+	    written[c] * sizeof(draw_elements_command));
+    n += written[c];
+  }
+  return n;
+}
+
+/* one invocation per object. the plane test is the one cull_spheres does, so
+both paths keep the same objects */
+static const char* g_cull_source =
+  "#version 430\n"
+  "layout(local_size_x = 64) in;\n"
+  "struct object {\n"
+  "  vec4 sphere; // centre, radius\n"
+  "  uvec4 draw;  // index count, first index, base vertex, unused\n"
+  "};\n"
+  "struct command {\n"
+  "  uint count;\n"
+  "  uint instance_count;\n"
+  "  uint first_index;\n"
+  "  int base_vertex;\n"
+  "  uint base_instance;\n"
+  "};\n"
+  "layout(std430, binding = 0) readonly buffer objects { object obj[]; };\n"
+  "layout(std430, binding = 1) writeonly buffer commands { command cmd[]; };\n"
+  "uniform vec4 planes[6];\n"
+  "uniform int object_count;\n"
+  "void main() {\n"
+  "  uint i = gl_GlobalInvocationID.x;\n"
+  "  if (i >= uint(object_count)) {\n"
+  "    return;\n"
+  "  }\n"
+  "  vec4 s = obj[i].sphere;\n"
+  "  bool visible = true;\n"
+  "  for (int p = 0; p < 6; p++) {\n"
+  "    visible = visible && dot(planes[p].xyz, s.xyz) + planes[p].w + s.w >= 0.0;\n"
+  "  }\n"
+  "  uvec4 d = obj[i].draw;\n"
+  "  cmd[i].count = d.x;\n"
+  "  cmd[i].instance_count = visible ? 1u : 0u;\n"
+  "  cmd[i].first_index = d.y;\n"
+  "  cmd[i].base_vertex = int(d.z);\n"
+  "  cmd[i].base_instance = i;\n"
+  "}\n";
+
+gpu_cull::gpu_cull()
+  : m_count_location(-1), m_objects(0), m_commands(0), m_count(0)
+{
+  for (int p = 0; p < FRUSTUM_PLANE_COUNT; p++) {
+    m_plane_locations[p] = -1;
+  }
+}
+
+gpu_cull::~gpu_cull()
+{
+  destroy();
+}
+
+bool gpu_cull::is_supported()
+{
+  return GLEW_VERSION_4_3 || (GLEW_ARB_compute_shader &&
+			      GLEW_ARB_shader_storage_buffer_object);
+}
+
+bool gpu_cull::create(const mesh_pool& pool, const int* meshes,
+		      const vec3_soa& centres, const float* radii)
+{
+  destroy();
+  if (!is_supported()) {
+    gl_log_err("ERROR: gpu cull: no compute shaders\n");
+    return false;
+  }
+  if (!m_program.id()) {
+    m_program.add_stage_source(GL_COMPUTE_SHADER, g_cull_source, "gpu_cull");
+    if (!m_program.build()) {
+      return false;
+    }
+    char name[16];
+    for (int p = 0; p < FRUSTUM_PLANE_COUNT; p++) {
+      snprintf(name, sizeof(name), "planes[%i]", p);
+      m_plane_locations[p] = m_program.uniform(name);
+    }
+    m_count_location = m_program.uniform("object_count");
+  }
+  m_count = centres.count;
+  // std430: a vec4 then a uvec4, 32 bytes an object
+  std::vector<float> objects(8 * (size_t)m_count);
+  for (int i = 0; i < m_count; i++) {
+    const pool_mesh& m = pool.get(meshes[i]);
+    float* o = &objects[8 * (size_t)i];
+    o[0] = centres.x[i];
+    o[1] = centres.y[i];
+    o[2] = centres.z[i];
+    o[3] = radii[i];
+    uint32_t draw[4] = {m.index_count, m.first_index, (uint32_t)m.base_vertex,
+			0};
+    memcpy(o + 4, draw, sizeof(draw));
+  }
+  glGenBuffers(1, &m_objects);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_objects);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, objects.size() * sizeof(float),
+	       objects.data(), GL_STATIC_DRAW);
+  // written by the GPU, read by the GPU
+  glGenBuffers(1, &m_commands);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_commands);
+  glBufferData(GL_SHADER_STORAGE_BUFFER,
+	       sizeof(draw_elements_command) * m_count, NULL, GL_DYNAMIC_COPY);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  gl_log("gpu cull: %i objects\n", m_count);
+  return true;
+}
+
+void gpu_cull::destroy()
+{
+  if (m_objects) {
+    glDeleteBuffers(1, &m_objects);
+    m_objects = 0;
+  }
+  if (m_commands) {
+    glDeleteBuffers(1, &m_commands);
+    m_commands = 0;
+  }
+  m_count = 0;
+}
+
+void gpu_cull::run(const frustum& f)
+{
+  if (!m_commands || !m_count) {
+    return;
+  }
+  m_program.use();
+  for (int p = 0; p < FRUSTUM_PLANE_COUNT; p++) {
+    m_program.set_uniform(m_plane_locations[p], f.planes[p]);
+  }
+  m_program.set_uniform(m_count_location, m_count);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_objects);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_commands);
+  glDispatchCompute((m_count + GPU_CULL_GROUP - 1) / GPU_CULL_GROUP, 1, 1);
+  glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+}
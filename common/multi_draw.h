@@ -0,0 +1,147 @@
+#ifndef _MULTI_DRAW_H
+#define _MULTI_DRAW_H
+
+#include <GL/glew.h>
+#include <stdint.h>
+#include <vector>
+#include "frustum.h"
+#include "mesh.h"
+#include "shader_program.h"
+
+/* many meshes drawn with one call.
+  mesh_pool pool;
+  pool.create(layout, 1 << 20, 1 << 21);
+  int rock = pool.add(streams, n_vertices, indices, n_indices);
+  ...each frame
+  int n = build_draw_commands(pool, view_frustum, object_meshes, centres,
+			      radii, commands, 0);
+  GLintptr at = stream.push(commands, n * sizeof(draw_elements_command));
+  pool.draw(stream.buffer(), at, commands, n);
+every mesh of a pool shares one vertex and one index buffer, so one vertex
+array covers all of them and a draw is just a range of indices and a base
+vertex - a draw_elements_command. with GL 4.3, or ARB_multi_draw_indirect
+and base instances (GL 4.2 or ARB_base_instance), a whole array of them goes
+to glMultiDrawElementsIndirect; other contexts loop over the same array with
+glDrawElementsBaseVertex.
+per-object data (a model matrix, say) goes in an instance buffer indexed by
+object: each command's base_instance is its object's index, so a culled list
+of draws still reads the right one. */
+
+// the layout glMultiDrawElementsIndirect reads, 20 bytes apart
+struct draw_elements_command {
+  GLuint count;
+  GLuint instance_count;
+  GLuint first_index;
+  GLint base_vertex;
+  GLuint base_instance;
+};
+static_assert(sizeof(draw_elements_command) == 20, "indirect command layout");
+
+// where one mesh is in its pool
+struct pool_mesh {
+  GLuint first_index;
+  GLuint index_count;
+  GLint base_vertex;
+  int vertex_count;
+};
+
+class mesh_pool
+{
+public:
+  mesh_pool();
+  ~mesh_pool();
+  mesh_pool(const mesh_pool&) = delete;
+  mesh_pool& operator=(const mesh_pool&) = delete;
+
+  // room for max_vertices of layout (interleaved) and max_indices in all
+  bool create(const vertex_layout& layout, int max_vertices, int max_indices);
+  void destroy();
+  /* streams and indices as for mesh::create, indices local to this mesh. the
+  mesh's index, or -1 with the reason logged when it doesn't fit */
+  int add(const void* const* streams, int vertex_count,
+	  const uint32_t* indices, int index_count, bool optimize = true);
+
+  int mesh_count() const { return (int)m_meshes.size(); }
+  const pool_mesh& get(int i) const { return m_meshes[i]; }
+  GLuint vao() const { return m_vao; }
+  GLuint vertex_buffer() const { return m_vbo; }
+  GLuint index_buffer() const { return m_ibo; }
+
+  // per-object attributes, see mesh::set_instance_buffer
+  void set_instance_buffer(const vertex_layout& layout, GLuint buffer,
+			   GLintptr offset);
+  /* count commands. with multi-draw indirect, one call reading them from
+  indirect_buffer at offset and commands may be NULL. without, commands is
+  the same array in memory, drawn one at a time with the instance attributes
+  moved to each base_instance */
+  void draw(GLuint indirect_buffer, GLintptr offset,
+	    const draw_elements_command* commands, int count) const;
+
+  // GL 4.3, or ARB_multi_draw_indirect with GL 4.2 or ARB_base_instance. set
+  // GL_NO_MULTI_DRAW_INDIRECT to anything but 0 to try the fallback on a
+  // driver that has it
+  static bool has_multi_draw_indirect();
+
+private:
+  vertex_layout m_layout;
+  std::vector<pool_mesh> m_meshes;
+  GLuint m_vao;
+  GLuint m_vbo;
+  GLuint m_ibo;
+  int m_max_vertices;
+  int m_max_indices;
+  int m_vertices; // used so far
+  int m_indices;
+  vertex_layout m_instance_layout;
+  GLuint m_instance_buffer;
+  GLintptr m_instance_offset;
+};
+
+/* object i draws pool mesh meshes[i] with a bounding sphere of centres[i] and
+radii[i]. writes a command for each object the frustum can see, in object
+order, and returns how many. commands needs room for centres.count.
+n_threads as in math_batch.h: the objects are split into chunks culled and
+turned into commands on math_batch's worker pool, then packed together */
+int build_draw_commands(const mesh_pool& pool, const frustum& f,
+			const int* meshes, const vec3_soa& centres,
+			const float* radii, draw_elements_command* commands,
+			int n_threads = 1);
+
+/* the same cull on the GPU. a compute shader tests every object's sphere and
+writes one command per object straight into command_buffer(), with
+instance_count 0 for the ones it drops, so nothing comes back to the CPU and
+the buffer goes to mesh_pool::draw as it is. needs GL 4.3 or the compute
+shader and storage buffer extensions.
+  gpu_cull cull;
+  cull.create(pool, meshes, centres, radii); // once, objects don't move
+  ...each frame
+  cull.run(view_frustum);
+  pool.draw(cull.command_buffer(), 0, NULL, cull.object_count()); */
+class gpu_cull
+{
+public:
+  gpu_cull();
+  ~gpu_cull();
+  gpu_cull(const gpu_cull&) = delete;
+  gpu_cull& operator=(const gpu_cull&) = delete;
+
+  bool create(const mesh_pool& pool, const int* meshes,
+	      const vec3_soa& centres, const float* radii);
+  void destroy();
+  // dispatches the cull and makes its writes visible to indirect draws
+  void run(const frustum& f);
+
+  GLuint command_buffer() const { return m_commands; }
+  int object_count() const { return m_count; }
+  static bool is_supported();
+
+private:
+  shader_program m_program;
+  GLint m_plane_locations[FRUSTUM_PLANE_COUNT];
+  GLint m_count_location;
+  GLuint m_objects;
+  GLuint m_commands;
+  int m_count;
+};
+
+#endif
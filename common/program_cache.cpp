@@ -0,0 +1,335 @@
+#include "program_cache.h"
+#include "file_loader.h"
+#include "logging.h"
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+static std::string g_dir;
+static bool g_dir_set = false;
+static int g_hits = 0;
+static int g_misses = 0;
+
+// magic, version, key, binary format, binary length
+struct program_cache_header
+{
+  char magic[4];
+  uint32_t version;
+  uint64_t key;
+  uint32_t format;
+  uint32_t length;
+};
+
+static const char* cache_dir()
+{
+  if (!g_dir_set) {
+    const char* env = getenv("GL_PROGRAM_CACHE_DIR");
+    g_dir = env ? env : PROGRAM_CACHE_DIR;
+    g_dir_set = true;
+  }
+  return g_dir.c_str();
+}
+
+static bool binaries_supported()
+{
+  static int supported = -1;
+  if (supported < 0) {
+    GLint formats = 0;
+    if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary) {
+      glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    }
+    supported = formats > 0 ? 1 : 0;
+    if (!supported) {
+      gl_log("program cache: the driver can't save program binaries\n");
+    }
+  }
+  return supported != 0;
+}
+
+static uint64_t fnv1a(uint64_t h, const void* data, size_t n)
+{
+  const unsigned char* p = (const unsigned char*)data;
+  for (size_t i = 0; i < n; i++) {
+    h = (h ^ p[i]) * 0x100000001b3ull;
+  }
+  return h;
+}
+
+static uint64_t fnv1a_str(uint64_t h, const char* s)
+{
+  s = s ? s : "";
+  // the terminator too, so "ab" + "c" and "a" + "bc" differ
+  return fnv1a(h, s, strlen(s) + 1);
+}
+
+uint64_t program_cache_key(const shader_stage_source* stages, int count,
+			   const char* defines)
+{
+  uint64_t h = 0xcbf29ce484222325ull;
+  uint32_t version = PROGRAM_CACHE_VERSION;
+  h = fnv1a(h, &version, sizeof(version));
+  const GLenum strings[] = {GL_VENDOR, GL_RENDERER, GL_VERSION,
+			    GL_SHADING_LANGUAGE_VERSION};
+  for (int i = 0; i < 4; i++) {
+    h = fnv1a_str(h, (const char*)glGetString(strings[i]));
+  }
+  h = fnv1a_str(h, defines);
+  for (int i = 0; i < count; i++) {
+    h = fnv1a(h, &stages[i].type, sizeof(stages[i].type));
+    h = fnv1a_str(h, stages[i].source);
+  }
+  return h;
+}
+
+/* the source with defines after its #version line, which has to stay first */
+std::string shader_source_with_defines(const char* source,
+				       const char* defines)
+{
+  std::string s = source ? source : "";
+  if (!defines || !defines[0]) {
+    return s;
+  }
+  size_t at = 0;
+  size_t version = s.find("#version");
+  if (version != std::string::npos) {
+    size_t eol = s.find('\n', version);
+    at = eol == std::string::npos ? s.size() : eol + 1;
+  }
+  std::string d = defines;
+  if (d[d.size() - 1] != '\n') {
+    d += '\n';
+  }
+  s.insert(at, d);
+  return s;
+}
+
+static const char* stage_name(GLenum type)
+{
+  switch (type) {
+  case GL_VERTEX_SHADER: return "vertex";
+  case GL_FRAGMENT_SHADER: return "fragment";
+  case GL_GEOMETRY_SHADER: return "geometry";
+  case GL_COMPUTE_SHADER: return "compute";
+  default: break;
+  }
+  return "other";
+}
+
+static GLuint compile_stage(const shader_stage_source& stage,
+			    const char* defines)
+{
+  std::string source = shader_source_with_defines(stage.source, defines);
+  const GLchar* p = source.c_str();
+  GLuint shader = glCreateShader(stage.type);
+  glShaderSource(shader, 1, &p, NULL);
+  glCompileShader(shader);
+  int params = -1;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &params);
+  if (GL_TRUE != params) {
+    int length = 0;
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+    std::vector<char> log(length > 0 ? length : 1, 0);
+    glGetShaderInfoLog(shader, (GLsizei)log.size(), NULL, log.data());
+    gl_log_err("ERROR: %s shader GL index %u did not compile\n%s\n",
+	       stage_name(stage.type), shader, log.data());
+    glDeleteShader(shader);
+    return 0;
+  }
+  return shader;
+}
+
+static GLuint link_from_source(const shader_stage_source* stages, int count,
+			       const char* defines, bool retrievable)
+{
+  std::vector<GLuint> shaders;
+  for (int i = 0; i < count; i++) {
+    GLuint shader = compile_stage(stages[i], defines);
+    if (!shader) {
+      for (size_t j = 0; j < shaders.size(); j++) {
+	glDeleteShader(shaders[j]);
+      }
+      return 0;
+    }
+    shaders.push_back(shader);
+  }
+
+  GLuint programme = glCreateProgram();
+  for (size_t i = 0; i < shaders.size(); i++) {
+    glAttachShader(programme, shaders[i]);
+  }
+  if (retrievable) {
+    glProgramParameteri(programme, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+			GL_TRUE);
+  }
+  glLinkProgram(programme);
+  // the program keeps what it needs, the shader objects can go
+  for (size_t i = 0; i < shaders.size(); i++) {
+    glDetachShader(programme, shaders[i]);
+    glDeleteShader(shaders[i]);
+  }
+
+  int params = -1;
+  glGetProgramiv(programme, GL_LINK_STATUS, &params);
+  if (GL_TRUE != params) {
+    int length = 0;
+    glGetProgramiv(programme, GL_INFO_LOG_LENGTH, &length);
+    std::vector<char> log(length > 0 ? length : 1, 0);
+    glGetProgramInfoLog(programme, (GLsizei)log.size(), NULL, log.data());
+    gl_log_err("ERROR: could not link shader programme GL index %u\n%s\n",
+	       programme, log.data());
+    glDeleteProgram(programme);
+    return 0;
+  }
+  return programme;
+}
+
+static void cache_path(char* path, size_t size, uint64_t key)
+{
+  snprintf(path, size, "%s/%016llx.bin", cache_dir(), (unsigned long long)key);
+}
+
+GLuint program_cache_load(uint64_t key)
+{
+  char path[600];
+  cache_path(path, sizeof(path), key);
+  // entries are only ever replaced by rename, so the mapping is safe to read
+  // and the binary goes to the driver without a copy
+  mapped_file file;
+  if (!file.open(path)) {
+    g_misses++;
+    return 0;
+  }
+  program_cache_header header;
+  bool ok = file.size() >= sizeof(header);
+  if (ok) {
+    memcpy(&header, file.data(), sizeof(header));
+    ok = memcmp(header.magic, PROGRAM_CACHE_MAGIC, 4) == 0 &&
+      header.version == PROGRAM_CACHE_VERSION && header.key == key &&
+      header.length > 0 && header.length == file.size() - sizeof(header);
+  }
+  if (!ok) {
+    gl_log("program cache: %s is stale or damaged\n", path);
+    g_misses++;
+    return 0;
+  }
+
+  GLuint programme = glCreateProgram();
+  glProgramBinary(programme, header.format, file.data() + sizeof(header),
+		  (GLsizei)header.length);
+  int params = -1;
+  glGetProgramiv(programme, GL_LINK_STATUS, &params);
+  if (GL_TRUE != params) {
+    gl_log("program cache: driver refused %s\n", path);
+    glDeleteProgram(programme);
+    g_misses++;
+    return 0;
+  }
+  g_hits++;
+  return programme;
+}
+
+void program_cache_store(uint64_t key, GLuint programme)
+{
+  char path[600];
+  cache_path(path, sizeof(path), key);
+  int length = 0;
+  glGetProgramiv(programme, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return;
+  }
+  std::vector<unsigned char> binary(length);
+  GLenum format = 0;
+  glGetProgramBinary(programme, length, &length, &format, binary.data());
+
+  if (mkdir(cache_dir(), 0755) != 0 && errno != EEXIST) {
+    gl_log_err("ERROR: program cache: could not create %s\n", cache_dir());
+    return;
+  }
+  program_cache_header header;
+  memcpy(header.magic, PROGRAM_CACHE_MAGIC, 4);
+  header.version = PROGRAM_CACHE_VERSION;
+  header.key = key;
+  header.format = format;
+  header.length = (uint32_t)length;
+  // written aside and renamed, so another process never reads half a file
+  std::string tmp = std::string(path) + ".tmp";
+  FILE* file = fopen(tmp.c_str(), "wb");
+  if (!file) {
+    gl_log_err("ERROR: program cache: could not write %s\n", tmp.c_str());
+    return;
+  }
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+    fwrite(binary.data(), 1, length, file) == (size_t)length;
+  ok = fclose(file) == 0 && ok;
+  if (!ok || rename(tmp.c_str(), path) != 0) {
+    gl_log_err("ERROR: program cache: could not write %s\n", path);
+    remove(tmp.c_str());
+  }
+}
+
+bool program_cache_enabled()
+{
+  return cache_dir()[0] && binaries_supported();
+}
+
+GLuint create_programme_cached(const shader_stage_source* stages, int count,
+			       const char* defines)
+{
+  auto started = std::chrono::steady_clock::now();
+  bool use_cache = program_cache_enabled();
+  uint64_t key = 0;
+  if (use_cache) {
+    key = program_cache_key(stages, count, defines);
+    GLuint programme = program_cache_load(key);
+    if (programme) {
+      GL_LOG_INFO("shader", "program %016llx from the cache in %.3f ms\n",
+		  (unsigned long long)key,
+		  std::chrono::duration<double, std::milli>(
+		    std::chrono::steady_clock::now() - started).count());
+      return programme;
+    }
+  }
+
+  GLuint programme = link_from_source(stages, count, defines, use_cache);
+  if (!programme) {
+    return 0;
+  }
+  if (use_cache) {
+    program_cache_store(key, programme);
+  }
+  GL_LOG_INFO("shader", "program %016llx compiled in %.3f ms\n",
+	      (unsigned long long)key,
+	      std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now() - started).count());
+  return programme;
+}
+
+GLuint create_programme_cached(const char* vs_source, const char* fs_source,
+			       const char* defines)
+{
+  const shader_stage_source stages[] = {{GL_VERTEX_SHADER, vs_source},
+					{GL_FRAGMENT_SHADER, fs_source}};
+  return create_programme_cached(stages, 2, defines);
+}
+
+void program_cache_set_dir(const char* dir)
+{
+  g_dir = dir ? dir : "";
+  g_dir_set = true;
+}
+
+void program_cache_stats(int* hits, int* misses)
+{
+  if (hits) {
+    *hits = g_hits;
+  }
+  if (misses) {
+    *misses = g_misses;
+  }
+}
@@ -0,0 +1,57 @@
+#ifndef _PROGRAM_CACHE_H
+#define _PROGRAM_CACHE_H
+
+#include <GL/glew.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+/* linked programs saved with glGetProgramBinary and reloaded with
+glProgramBinary on the next run, skipping compile and link.
+the cache key is a 64-bit FNV-1a hash of the GL vendor, renderer, version and
+GLSL version strings, the defines and every stage's type and source, so a
+driver update or an edited shader simply misses. a binary the driver turns
+down anyway (glProgramBinary can refuse one at any time) is rebuilt from
+source and written over.
+files live in the cache directory as <key>.bin. the default is
+PROGRAM_CACHE_DIR, or the GL_PROGRAM_CACHE_DIR environment variable; an empty
+directory name turns the cache off. drivers without program binary support
+(before GL 4.1 or ARB_get_program_binary, or with no binary formats) always
+compile. */
+#define PROGRAM_CACHE_DIR "shader_cache"
+#define PROGRAM_CACHE_MAGIC "GLPB"
+#define PROGRAM_CACHE_VERSION 1
+
+struct shader_stage_source {
+  GLenum type; // GL_VERTEX_SHADER etc.
+  const char* source;
+};
+
+/* a linked program from count stages, or 0 with the compile or link errors
+logged. defines (may be NULL) is text like "#define SHADOWS 1\n" put after
+each stage's #version line, for building permutations of one source */
+GLuint create_programme_cached(const shader_stage_source* stages, int count,
+			       const char* defines = NULL);
+// vertex + fragment shorthand
+GLuint create_programme_cached(const char* vs_source, const char* fs_source,
+			       const char* defines = NULL);
+
+/* the steps create_programme_cached goes through, for callers that compile
+on their own schedule (see shader_program.h) */
+// a directory is set and the driver can save binaries
+bool program_cache_enabled();
+uint64_t program_cache_key(const shader_stage_source* stages, int count,
+			   const char* defines);
+// a linked program, or 0 when it's not there or the driver refuses it
+GLuint program_cache_load(uint64_t key);
+// programme should be linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+void program_cache_store(uint64_t key, GLuint programme);
+// source with defines inserted after its #version line
+std::string shader_source_with_defines(const char* source,
+				       const char* defines);
+
+void program_cache_set_dir(const char* dir);
+// loads that found a usable binary, and ones that didn't, since start-up
+void program_cache_stats(int* hits, int* misses);
+
+#endif
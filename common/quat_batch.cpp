@@ -0,0 +1,199 @@
+/******************************************************************************\
+| Batch quaternion interpolation. See quat_batch.h                             |
+\******************************************************************************/
+#include "quat_batch.h"
+#include "maths_simd.h"
+#include <algorithm>
+
+/* Eberly's coefficients u_i = 1 / ( i ( 2i + 1 ) ), v_i = i / ( 2i + 1 ) for
+i = 1..8. the last term is scaled by mu to soak up the truncated rest of the
+series, which takes the error from 1e-3 down to 2e-5 */
+#define SLERP_MU 1.85298109240830f
+static const float slerp_u[8] = { 1.0f / ( 1 * 3 ), 1.0f / ( 2 * 5 ), 1.0f / ( 3 * 7 ), 1.0f / ( 4 * 9 ), 1.0f / ( 5 * 11 ), 1.0f / ( 6 * 13 ), 1.0f / ( 7 * 15 ),
+  SLERP_MU / ( 8 * 17 ) };
+static const float slerp_v[8] = { 1.0f / 3.0f, 2.0f / 5.0f, 3.0f / 7.0f, 4.0f / 9.0f, 5.0f / 11.0f, 6.0f / 13.0f, 7.0f / 15.0f, SLERP_MU * 8.0f / 17.0f };
+
+/* sin( s * theta ) / sin( theta ) as a polynomial in s and cos( theta ) - 1.
+xm1 is 0 for identical keys and -1 for keys 180 degrees apart */
+static inline float slerp_weight( float s, float xm1 ) {
+  float s2  = s * s;
+  float acc = 1.0f;
+  for ( int i = 7; i >= 0; i-- ) { acc = 1.0f + ( slerp_u[i] * s2 - slerp_v[i] ) * xm1 * acc; }
+  return s * acc;
+}
+
+static MATHS_FORCE_INLINE simd4f slerp_weight4( simd4f s, simd4f xm1 ) {
+  simd4f one = simd4f_splat( 1.0f );
+  simd4f s2  = simd4f_mul( s, s );
+  simd4f acc = one;
+  for ( int i = 7; i >= 0; i-- ) {
+    simd4f b = simd4f_mul( simd4f_sub( simd4f_mul( simd4f_splat( slerp_u[i] ), s2 ), simd4f_splat( slerp_v[i] ) ), xm1 );
+    acc      = simd4f_madd( b, acc, one );
+  }
+  return simd4f_mul( s, acc );
+}
+
+versor slerp_fast( const versor& q, const versor& r, float t ) {
+  float cos_half_theta = dot( q, r );
+  // negate r instead of q for the short way round, so q can stay const
+  float sign = 1.0f;
+  if ( cos_half_theta < 0.0f ) {
+    sign           = -1.0f;
+    cos_half_theta = -cos_half_theta;
+  }
+  float xm1 = cos_half_theta - 1.0f;
+  float a   = slerp_weight( 1.0f - t, xm1 );
+  float b   = slerp_weight( t, xm1 ) * sign;
+  return versor( q.q[0] * a + r.q[0] * b, q.q[1] * a + r.q[1] * b, q.q[2] * a + r.q[2] * b, q.q[3] * a + r.q[3] * b );
+}
+
+versor nlerp( const versor& q, const versor& r, float t ) {
+  float b = dot( q, r ) < 0.0f ? -t : t;
+  float a = 1.0f - t;
+  versor result( q.q[0] * a + r.q[0] * b, q.q[1] * a + r.q[1] * b, q.q[2] * a + r.q[2] * b, q.q[3] * a + r.q[3] * b );
+  // after the sign flip the keys are < 180 degrees apart so this is never ~0
+  float mag = sqrtf( dot( result, result ) );
+  return result / mag;
+}
+
+/* 4 versors <-> w, x, y, z registers holding one component of each. the
+transpose is its own inverse so the same macro packs the results back up */
+static MATHS_FORCE_INLINE void load_versor4( const versor* q, simd4f& w, simd4f& x, simd4f& y, simd4f& z ) {
+  w = simd4f_load( q[0].q );
+  x = simd4f_load( q[1].q );
+  y = simd4f_load( q[2].q );
+  z = simd4f_load( q[3].q );
+  SIMD4F_TRANSPOSE( w, x, y, z );
+}
+
+static MATHS_FORCE_INLINE void store_versor4( versor* q, simd4f w, simd4f x, simd4f y, simd4f z ) {
+  SIMD4F_TRANSPOSE( w, x, y, z );
+  simd4f_store( q[0].q, w );
+  simd4f_store( q[1].q, x );
+  simd4f_store( q[2].q, y );
+  simd4f_store( q[3].q, z );
+}
+
+// +1 where d >= 0, -1 where d < 0
+static MATHS_FORCE_INLINE simd4f sign4( simd4f d ) {
+  simd4f neg = simd4f_cmplt( d, simd4f_splat( 0.0f ) );
+  return simd4f_add( simd4f_splat( 1.0f ), simd4f_and( neg, simd4f_splat( -2.0f ) ) );
+}
+
+void slerp_batch( const versor* q, const versor* r, const float* t, versor* out, int count ) {
+  int i = 0;
+  for ( ; i + 4 <= count; i += 4 ) {
+    simd4f qw, qx, qy, qz, rw, rx, ry, rz;
+    load_versor4( &q[i], qw, qx, qy, qz );
+    load_versor4( &r[i], rw, rx, ry, rz );
+    simd4f d    = simd4f_madd( qz, rz, simd4f_madd( qy, ry, simd4f_madd( qx, rx, simd4f_mul( qw, rw ) ) ) );
+    simd4f sign = sign4( d );
+    simd4f xm1  = simd4f_sub( simd4f_mul( d, sign ), simd4f_splat( 1.0f ) );
+    simd4f tt   = simd4f_load( &t[i] );
+    simd4f a    = slerp_weight4( simd4f_sub( simd4f_splat( 1.0f ), tt ), xm1 );
+    simd4f b    = simd4f_mul( slerp_weight4( tt, xm1 ), sign );
+    store_versor4( &out[i], simd4f_madd( rw, b, simd4f_mul( qw, a ) ), simd4f_madd( rx, b, simd4f_mul( qx, a ) ), simd4f_madd( ry, b, simd4f_mul( qy, a ) ),
+      simd4f_madd( rz, b, simd4f_mul( qz, a ) ) );
+  }
+  for ( ; i < count; i++ ) { out[i] = slerp_fast( q[i], r[i], t[i] ); }
+}
+
+void nlerp_batch( const versor* q, const versor* r, const float* t, versor* out, int count ) {
+  int i = 0;
+  for ( ; i + 4 <= count; i += 4 ) {
+    simd4f qw, qx, qy, qz, rw, rx, ry, rz;
+    load_versor4( &q[i], qw, qx, qy, qz );
+    load_versor4( &r[i], rw, rx, ry, rz );
+    simd4f d   = simd4f_madd( qz, rz, simd4f_madd( qy, ry, simd4f_madd( qx, rx, simd4f_mul( qw, rw ) ) ) );
+    simd4f tt  = simd4f_load( &t[i] );
+    simd4f a   = simd4f_sub( simd4f_splat( 1.0f ), tt );
+    simd4f b   = simd4f_mul( tt, sign4( d ) );
+    simd4f w   = simd4f_madd( rw, b, simd4f_mul( qw, a ) );
+    simd4f x   = simd4f_madd( rx, b, simd4f_mul( qx, a ) );
+    simd4f y   = simd4f_madd( ry, b, simd4f_mul( qy, a ) );
+    simd4f z   = simd4f_madd( rz, b, simd4f_mul( qz, a ) );
+    simd4f mag = simd4f_sqrt( simd4f_madd( z, z, simd4f_madd( y, y, simd4f_madd( x, x, simd4f_mul( w, w ) ) ) ) );
+    store_versor4( &out[i], simd4f_div( w, mag ), simd4f_div( x, mag ), simd4f_div( y, mag ), simd4f_div( z, mag ) );
+  }
+  for ( ; i < count; i++ ) { out[i] = nlerp( q[i], r[i], t[i] ); }
+}
+
+void quat_to_mat4_batch( const versor* q, mat4* out, int count ) {
+  int i = 0;
+  for ( ; i + 4 <= count; i += 4 ) {
+    simd4f w, x, y, z;
+    load_versor4( &q[i], w, x, y, z );
+    simd4f one  = simd4f_splat( 1.0f );
+    simd4f two  = simd4f_splat( 2.0f );
+    simd4f x2   = simd4f_mul( x, two );
+    simd4f y2   = simd4f_mul( y, two );
+    simd4f z2   = simd4f_mul( z, two );
+    simd4f xx   = simd4f_mul( x, x2 );
+    simd4f yy   = simd4f_mul( y, y2 );
+    simd4f zz   = simd4f_mul( z, z2 );
+    simd4f xy   = simd4f_mul( x, y2 );
+    simd4f xz   = simd4f_mul( x, z2 );
+    simd4f yz   = simd4f_mul( y, z2 );
+    simd4f wx   = simd4f_mul( w, x2 );
+    simd4f wy   = simd4f_mul( w, y2 );
+    simd4f wz   = simd4f_mul( w, z2 );
+    simd4f zero = simd4f_splat( 0.0f );
+    // one register per matrix element, lane k belongs to out[i + k]
+    simd4f c[3][4] = { { simd4f_sub( simd4f_sub( one, yy ), zz ), simd4f_add( xy, wz ), simd4f_sub( xz, wy ), zero },
+      { simd4f_sub( xy, wz ), simd4f_sub( simd4f_sub( one, xx ), zz ), simd4f_add( yz, wx ), zero },
+      { simd4f_add( xz, wy ), simd4f_sub( yz, wx ), simd4f_sub( simd4f_sub( one, xx ), yy ), zero } };
+    simd4f last = simd4f_set( 0.0f, 0.0f, 0.0f, 1.0f );
+    for ( int col = 0; col < 3; col++ ) {
+      SIMD4F_TRANSPOSE( c[col][0], c[col][1], c[col][2], c[col][3] );
+      for ( int k = 0; k < 4; k++ ) { simd4f_store( &out[i + k].m[col * 4], c[col][k] ); }
+    }
+    for ( int k = 0; k < 4; k++ ) { simd4f_store( &out[i + k].m[12], last ); }
+  }
+  for ( ; i < count; i++ ) { out[i] = quat_to_mat4( q[i] ); }
+}
+
+/* key index k with times[k] <= time < times[k + 1]. tries the cached index and
+the one after it first, normal playback never gets further than that */
+static int find_key( const quat_track& track, float time, int k ) {
+  const float* times = track.times;
+  if ( k >= 0 && k + 1 < track.count && times[k] <= time ) {
+    if ( time < times[k + 1] ) { return k; }
+    if ( k + 2 < track.count && time < times[k + 2] ) { return k + 1; }
+  }
+  // jumped or looped back, binary search
+  return (int)( std::upper_bound( times, times + track.count, time ) - times ) - 1;
+}
+
+void quat_sampler_sample( quat_sampler& s, const quat_track* tracks, int n_tracks, float time, versor* out, bool use_nlerp ) {
+  if ( n_tracks <= 0 ) { return; }
+  if ( (int)s.cursors.size() < n_tracks ) { s.cursors.resize( n_tracks, 0 ); }
+  s.from.resize( n_tracks );
+  s.to.resize( n_tracks );
+  s.t.resize( n_tracks );
+  for ( int i = 0; i < n_tracks; i++ ) {
+    const quat_track& track = tracks[i];
+    s.t[i]                  = 0.0f;
+    if ( track.count <= 0 ) {
+      s.from[i] = s.to[i] = versor( 1.0f, 0.0f, 0.0f, 0.0f );
+      continue;
+    }
+    if ( track.count == 1 || time <= track.times[0] ) {
+      s.from[i] = s.to[i] = track.keys[0];
+      continue;
+    }
+    if ( time >= track.times[track.count - 1] ) {
+      s.from[i] = s.to[i] = track.keys[track.count - 1];
+      continue;
+    }
+    int k        = find_key( track, time, s.cursors[i] );
+    s.cursors[i] = k;
+    s.from[i]    = track.keys[k];
+    s.to[i]      = track.keys[k + 1];
+    s.t[i]       = ( time - track.times[k] ) / ( track.times[k + 1] - track.times[k] );
+  }
+  if ( use_nlerp ) {
+    nlerp_batch( s.from.data(), s.to.data(), s.t.data(), out, n_tracks );
+  } else {
+    slerp_batch( s.from.data(), s.to.data(), s.t.data(), out, n_tracks );
+  }
+}
@@ -0,0 +1,573 @@
+#include "shader_program.h"
+#include "logging.h"
+#include "file_loader.h"
+#include "program_cache.h"
+#include "shader_watch.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+// what glUseProgram was last called with through shader_program
+static GLuint g_bound_program = 0;
+static long g_uploads = 0;
+static long g_skipped = 0;
+
+struct block_binding {
+  std::string name;
+  GLuint binding;
+  size_t bytes;
+};
+static std::vector<block_binding> g_block_bindings;
+
+static double now_ms()
+{
+  return std::chrono::duration<double, std::milli>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* asks the driver for as many compiler threads as it likes, once. true when
+compiles and links run in the background */
+static bool parallel_compile()
+{
+  static int parallel = -1;
+  if (parallel < 0) {
+    parallel = 0;
+    if (GLEW_KHR_parallel_shader_compile) {
+      glMaxShaderCompilerThreadsKHR(0xffffffff);
+      parallel = 1;
+    } else if (GLEW_ARB_parallel_shader_compile) {
+      glMaxShaderCompilerThreadsARB(0xffffffff);
+      parallel = 1;
+    }
+    gl_log("shader: parallel compile %s\n", parallel ? "on" : "not supported");
+  }
+  return parallel != 0;
+}
+
+/* bytes of one value of a uniform type, 0 for types set_uniform can't
+set */
+static size_t uniform_type_bytes(GLenum type)
+{
+  switch (type) {
+  case GL_FLOAT:
+  case GL_INT:
+  case GL_BOOL:
+  case GL_SAMPLER_2D:
+  case GL_SAMPLER_3D:
+  case GL_SAMPLER_CUBE:
+  case GL_SAMPLER_2D_SHADOW: return 4;
+  case GL_FLOAT_VEC2: return 8;
+  case GL_FLOAT_VEC3: return 12;
+  case GL_FLOAT_VEC4: return 16;
+  case GL_FLOAT_MAT3: return 36;
+  case GL_FLOAT_MAT4: return 64;
+  default: break;
+  }
+  return 0;
+}
+
+static const char* stage_type_name(GLenum type)
+{
+  switch (type) {
+  case GL_VERTEX_SHADER: return "vertex";
+  case GL_FRAGMENT_SHADER: return "fragment";
+  case GL_GEOMETRY_SHADER: return "geometry";
+  case GL_COMPUTE_SHADER: return "compute";
+  default: break;
+  }
+  return "other";
+}
+
+shader_program::shader_program()
+  : m_id(0), m_pending(0), m_pending_cached(false), m_key(0), m_started(0.0),
+    m_warned_mismatch(false)
+{
+}
+
+shader_program::~shader_program()
+{
+  destroy();
+}
+
+void shader_program::destroy()
+{
+  unwatch_shader_program(this);
+  delete_shaders();
+  if (m_pending) {
+    glDeleteProgram(m_pending);
+    m_pending = 0;
+  }
+  if (m_id) {
+    if (g_bound_program == m_id) {
+      g_bound_program = 0;
+    }
+    glDeleteProgram(m_id);
+    m_id = 0;
+  }
+}
+
+bool shader_program::add_stage_file(GLenum type, const char* path)
+{
+  // a copy, not the mapping: the file may be edited while the source is kept
+  std::string source;
+  if (!load_text_file(path, &source)) {
+    gl_log_err("ERROR: reading shader file %s: %s\n", path, strerror(errno));
+    return false;
+  }
+  m_stages.push_back({type, path, true, source, 0});
+  return true;
+}
+
+void shader_program::add_stage_source(GLenum type, const char* source,
+				      const char* name)
+{
+  m_stages.push_back({type, name, false, source ? source : "", 0});
+}
+
+void shader_program::set_defines(const char* defines)
+{
+  m_defines = defines ? defines : "";
+}
+
+const char* shader_program::stage_file(int i) const
+{
+  if (i < 0 || i >= (int)m_stages.size() || !m_stages[i].from_file) {
+    return NULL;
+  }
+  return m_stages[i].name.c_str();
+}
+
+void shader_program::set_stage_source(int i, const std::string& source)
+{
+  if (i >= 0 && i < (int)m_stages.size()) {
+    m_stages[i].source = source;
+  }
+}
+
+bool shader_program::build()
+{
+  begin_build();
+  return finish_build();
+}
+
+void shader_program::begin_build()
+{
+  delete_shaders();
+  if (m_pending) {
+    glDeleteProgram(m_pending);
+    m_pending = 0;
+  }
+  m_started = now_ms();
+  parallel_compile();
+
+  std::vector<shader_stage_source> sources;
+  for (size_t i = 0; i < m_stages.size(); i++) {
+    sources.push_back({m_stages[i].type, m_stages[i].source.c_str()});
+  }
+  bool use_cache = program_cache_enabled();
+  m_key = 0;
+  m_pending_cached = false;
+  if (use_cache) {
+    m_key = program_cache_key(sources.data(), (int)sources.size(),
+			      m_defines.c_str());
+    m_pending = program_cache_load(m_key);
+    if (m_pending) {
+      m_pending_cached = true;
+      return;
+    }
+  }
+
+  // no status queries until finish_build, they would wait for the compiler
+  m_pending = glCreateProgram();
+  for (size_t i = 0; i < m_stages.size(); i++) {
+    std::string source = shader_source_with_defines(m_stages[i].source.c_str(),
+						    m_defines.c_str());
+    const GLchar* p = source.c_str();
+    m_stages[i].shader = glCreateShader(m_stages[i].type);
+    glShaderSource(m_stages[i].shader, 1, &p, NULL);
+    glCompileShader(m_stages[i].shader);
+    glAttachShader(m_pending, m_stages[i].shader);
+  }
+  if (use_cache) {
+    glProgramParameteri(m_pending, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+  glLinkProgram(m_pending);
+}
+
+bool shader_program::is_ready() const
+{
+  if (!m_pending || m_pending_cached || !parallel_compile()) {
+    return true;
+  }
+  int done = GL_FALSE;
+  glGetProgramiv(m_pending, GL_COMPLETION_STATUS_KHR, &done);
+  return GL_TRUE == done;
+}
+
+bool shader_program::finish_build()
+{
+  if (!m_pending) {
+    return false;
+  }
+  int params = -1;
+  glGetProgramiv(m_pending, GL_LINK_STATUS, &params);
+  if (GL_TRUE != params) {
+    // a stage that didn't compile explains the failed link, report those
+    bool stage_failed = false;
+    for (size_t i = 0; i < m_stages.size(); i++) {
+      if (!m_stages[i].shader) {
+	continue;
+      }
+      glGetShaderiv(m_stages[i].shader, GL_COMPILE_STATUS, &params);
+      if (GL_TRUE != params) {
+	int length = 0;
+	glGetShaderiv(m_stages[i].shader, GL_INFO_LOG_LENGTH, &length);
+	std::vector<char> log(length > 0 ? length : 1, 0);
+	glGetShaderInfoLog(m_stages[i].shader, (GLsizei)log.size(), NULL,
+			   log.data());
+	gl_log_err("ERROR: %s shader %s did not compile\n%s\n",
+		   stage_type_name(m_stages[i].type), m_stages[i].name.c_str(),
+		   log.data());
+	stage_failed = true;
+      }
+    }
+    if (!stage_failed) {
+      int length = 0;
+      glGetProgramiv(m_pending, GL_INFO_LOG_LENGTH, &length);
+      std::vector<char> log(length > 0 ? length : 1, 0);
+      glGetProgramInfoLog(m_pending, (GLsizei)log.size(), NULL, log.data());
+      gl_log_err("ERROR: could not link %s\n%s\n", stage_names().c_str(),
+		 log.data());
+    }
+    delete_shaders();
+    glDeleteProgram(m_pending);
+    m_pending = 0;
+    return false;
+  }
+
+  delete_shaders();
+  if (!m_pending_cached && m_key) {
+    program_cache_store(m_key, m_pending);
+  }
+  std::vector<kept_uniform> kept = kept_uniforms();
+  if (m_id) {
+    if (g_bound_program == m_id) {
+      g_bound_program = 0;
+    }
+    glDeleteProgram(m_id);
+  }
+  m_id = m_pending;
+  m_pending = 0;
+  bind_blocks();
+  read_locations();
+  restore_uniforms(kept);
+  GL_LOG_INFO("shader", "%s %s in %.3f ms\n", stage_names().c_str(),
+	      m_pending_cached ? "from the cache" : "compiled",
+	      now_ms() - m_started);
+  return true;
+}
+
+std::string shader_program::stage_names() const
+{
+  std::string names;
+  for (size_t i = 0; i < m_stages.size(); i++) {
+    names += (i ? " + " : "") + m_stages[i].name;
+  }
+  return names;
+}
+
+void shader_program::delete_shaders()
+{
+  for (size_t i = 0; i < m_stages.size(); i++) {
+    if (m_stages[i].shader) {
+      if (m_pending) {
+	glDetachShader(m_pending, m_stages[i].shader);
+      }
+      glDeleteShader(m_stages[i].shader);
+      m_stages[i].shader = 0;
+    }
+  }
+}
+
+void shader_program::bind_blocks()
+{
+  for (size_t i = 0; i < g_block_bindings.size(); i++) {
+    const block_binding& b = g_block_bindings[i];
+    GLuint index = glGetUniformBlockIndex(m_id, b.name.c_str());
+    if (GL_INVALID_INDEX == index) {
+      continue;
+    }
+    glUniformBlockBinding(m_id, index, b.binding);
+    GLint size = 0;
+    glGetActiveUniformBlockiv(m_id, index, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+    if (b.bytes && (size_t)size != b.bytes) {
+      gl_log_err("ERROR: %s: uniform block %s is %i bytes, expected %i\n",
+		 stage_names().c_str(), b.name.c_str(), size, (int)b.bytes);
+    }
+  }
+}
+
+/* every active uniform and attribute, the same walk print_all does. arrays
+are listed as "name[0]", so the bare name goes in as well. each uniform
+set_uniform can handle gets a slot in the shadow copy */
+void shader_program::read_locations()
+{
+  m_uniforms.clear();
+  m_attributes.clear();
+  m_shadow_at.clear();
+  m_shadow_type.clear();
+  m_shadow.clear();
+  m_shadow_set.clear();
+  char name[256];
+  int count = 0;
+  glGetProgramiv(m_id, GL_ACTIVE_UNIFORMS, &count);
+  for (int i = 0; i < count; i++) {
+    GLsizei length = 0;
+    GLint size = 0;
+    GLenum type;
+    glGetActiveUniform(m_id, (GLuint)i, sizeof(name), &length, &size, &type,
+		       name);
+    GLint location = glGetUniformLocation(m_id, name);
+    m_uniforms[name] = location;
+    size_t bytes = uniform_type_bytes(type);
+    if (location >= 0 && bytes) {
+      if ((size_t)location >= m_shadow_at.size()) {
+	m_shadow_at.resize(location + 1, -1);
+	m_shadow_type.resize(location + 1, 0);
+      }
+      m_shadow_at[location] = (int)m_shadow.size();
+      m_shadow_type[location] = type;
+      m_shadow.resize(m_shadow.size() + bytes);
+    }
+    char* bracket = strstr(name, "[0]");
+    if (bracket) {
+      *bracket = 0;
+      m_uniforms[name] = location;
+    }
+  }
+  m_shadow_set.assign(m_shadow_at.size(), false);
+  glGetProgramiv(m_id, GL_ACTIVE_ATTRIBUTES, &count);
+  for (int i = 0; i < count; i++) {
+    GLsizei length = 0;
+    GLint size = 0;
+    GLenum type;
+    glGetActiveAttrib(m_id, (GLuint)i, sizeof(name), &length, &size, &type,
+		      name);
+    m_attributes[name] = glGetAttribLocation(m_id, name);
+  }
+}
+
+std::vector<shader_program::kept_uniform> shader_program::kept_uniforms() const
+{
+  std::vector<kept_uniform> kept;
+  for (auto it = m_uniforms.begin(); it != m_uniforms.end(); ++it) {
+    GLint location = it->second;
+    // arrays are in the table twice, "name[0]" is the one to skip
+    if (location < 0 || (size_t)location >= m_shadow_at.size() ||
+	m_shadow_at[location] < 0 || !m_shadow_set[location] ||
+	it->first.find('[') != std::string::npos) {
+      continue;
+    }
+    const unsigned char* value = m_shadow.data() + m_shadow_at[location];
+    GLenum type = m_shadow_type[location];
+    kept.push_back({it->first, type, std::vector<unsigned char>(
+	  value, value + uniform_type_bytes(type))});
+  }
+  return kept;
+}
+
+/* sends kept values to the uniforms of the same name and type, through the
+shadow copy so set_uniform knows about them */
+void shader_program::restore_uniforms(const std::vector<kept_uniform>& kept)
+{
+  for (size_t i = 0; i < kept.size(); i++) {
+    auto it = m_uniforms.find(kept[i].name);
+    if (it == m_uniforms.end()) {
+      continue;
+    }
+    GLint location = it->second;
+    if (location < 0 || (size_t)location >= m_shadow_at.size() ||
+	m_shadow_at[location] < 0 || m_shadow_type[location] != kept[i].type) {
+      continue;
+    }
+    memcpy(m_shadow.data() + m_shadow_at[location], kept[i].value.data(),
+	   kept[i].value.size());
+    m_shadow_set[location] = true;
+    use();
+    const float* f = (const float*)kept[i].value.data();
+    const GLint* n = (const GLint*)kept[i].value.data();
+    switch (kept[i].type) {
+    case GL_FLOAT: glUniform1fv(location, 1, f); break;
+    case GL_FLOAT_VEC2: glUniform2fv(location, 1, f); break;
+    case GL_FLOAT_VEC3: glUniform3fv(location, 1, f); break;
+    case GL_FLOAT_VEC4: glUniform4fv(location, 1, f); break;
+    case GL_FLOAT_MAT3: glUniformMatrix3fv(location, 1, GL_FALSE, f); break;
+    case GL_FLOAT_MAT4: glUniformMatrix4fv(location, 1, GL_FALSE, f); break;
+    default: glUniform1iv(location, 1, n); break; // ints, bools, samplers
+    }
+  }
+}
+
+GLint shader_program::uniform(const char* name)
+{
+  auto it = m_uniforms.find(name);
+  if (it != m_uniforms.end()) {
+    return it->second;
+  }
+  // e.g. "lights[3]", or a name that isn't there. ask once and remember
+  GLint location = m_id ? glGetUniformLocation(m_id, name) : -1;
+  m_uniforms[name] = location;
+  return location;
+}
+
+GLint shader_program::attribute(const char* name)
+{
+  auto it = m_attributes.find(name);
+  if (it != m_attributes.end()) {
+    return it->second;
+  }
+  GLint location = m_id ? glGetAttribLocation(m_id, name) : -1;
+  m_attributes[name] = location;
+  return location;
+}
+
+void shader_program::use() const
+{
+  if (g_bound_program != m_id) {
+    glUseProgram(m_id);
+    g_bound_program = m_id;
+  }
+}
+
+bool shader_program::uniform_changed(GLint location, const void* value,
+				     size_t bytes)
+{
+  if (location < 0) {
+    return false; // not active, GL would ignore it anyway
+  }
+  if ((size_t)location >= m_shadow_at.size() || m_shadow_at[location] < 0) {
+    g_uploads++;
+    return true;
+  }
+  /* a setter that doesn't match the uniform's type (a vec4 for a vec3, say)
+  would read or write past its slot. GL rejects the call anyway, so pass it
+  on unshadowed and let the GL error show where */
+  if (bytes != uniform_type_bytes(m_shadow_type[location])) {
+    if (!m_warned_mismatch) {
+      gl_log_err("ERROR: program %u: %i byte value set on uniform at %i, "
+		 "which is %i bytes\n", m_id, (int)bytes, location,
+		 (int)uniform_type_bytes(m_shadow_type[location]));
+      m_warned_mismatch = true;
+    }
+    g_uploads++;
+    return true;
+  }
+  unsigned char* shadow = m_shadow.data() + m_shadow_at[location];
+  if (m_shadow_set[location] && memcmp(shadow, value, bytes) == 0) {
+    g_skipped++;
+    return false;
+  }
+  memcpy(shadow, value, bytes);
+  m_shadow_set[location] = true;
+  g_uploads++;
+  return true;
+}
+
+void shader_program::set_uniform(GLint location, float v)
+{
+  if (uniform_changed(location, &v, sizeof(v))) {
+    use();
+    glUniform1f(location, v);
+  }
+}
+
+void shader_program::set_uniform(GLint location, int v)
+{
+  if (uniform_changed(location, &v, sizeof(v))) {
+    use();
+    glUniform1i(location, v);
+  }
+}
+
+void shader_program::set_uniform(GLint location, const vec2& v)
+{
+  if (uniform_changed(location, v.v, sizeof(v.v))) {
+    use();
+    glUniform2fv(location, 1, v.v);
+  }
+}
+
+void shader_program::set_uniform(GLint location, const vec3& v)
+{
+  if (uniform_changed(location, v.v, sizeof(v.v))) {
+    use();
+    glUniform3fv(location, 1, v.v);
+  }
+}
+
+void shader_program::set_uniform(GLint location, const vec4& v)
+{
+  if (uniform_changed(location, v.v, sizeof(v.v))) {
+    use();
+    glUniform4fv(location, 1, v.v);
+  }
+}
+
+void shader_program::set_uniform(GLint location, const mat3& m)
+{
+  if (uniform_changed(location, m.m, sizeof(m.m))) {
+    use();
+    glUniformMatrix3fv(location, 1, GL_FALSE, m.m);
+  }
+}
+
+void shader_program::set_uniform(GLint location, const mat4& m)
+{
+  if (uniform_changed(location, m.m, sizeof(m.m))) {
+    use();
+    glUniformMatrix4fv(location, 1, GL_FALSE, m.m);
+  }
+}
+
+void forget_bound_program()
+{
+  g_bound_program = 0;
+}
+
+void uniform_upload_stats(long* uploads, long* skipped)
+{
+  if (uploads) {
+    *uploads = g_uploads;
+  }
+  if (skipped) {
+    *skipped = g_skipped;
+  }
+}
+
+void set_uniform_block_binding(const char* name, GLuint binding, size_t bytes)
+{
+  for (size_t i = 0; i < g_block_bindings.size(); i++) {
+    if (g_block_bindings[i].name == name) {
+      g_block_bindings[i].binding = binding;
+      g_block_bindings[i].bytes = bytes;
+      return;
+    }
+  }
+  g_block_bindings.push_back({name, binding, bytes});
+}
+
+bool build_programs(shader_program* const* programs, int count)
+{
+  double started = now_ms();
+  for (int i = 0; i < count; i++) {
+    programs[i]->begin_build();
+  }
+  bool all = true;
+  for (int i = 0; i < count; i++) {
+    all = programs[i]->finish_build() && all;
+  }
+  GL_LOG_INFO("shader", "%i programs built in %.3f ms\n", count,
+	      now_ms() - started);
+  return all;
+}
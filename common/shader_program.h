@@ -0,0 +1,139 @@
+#ifndef _SHADER_PROGRAM_H
+#define _SHADER_PROGRAM_H
+
+#include <GL/glew.h>
+#include <stdint.h>
+#include "math_funcs.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* one GLSL program: its stages, how it was built and its locations.
+  shader_program p;
+  p.add_stage_file( GL_VERTEX_SHADER, "test5_vs.glsl" );
+  p.add_stage_file( GL_FRAGMENT_SHADER, "test5_fs.glsl" );
+  if ( !p.build() ) { ... }
+  glUniformMatrix4fv( p.uniform( "view" ), ... );
+building goes through the program cache (program_cache.h) first. on a miss
+every stage is compiled and the program linked without asking GL for any
+status in between, so with GL_KHR_parallel_shader_compile (or the ARB one)
+the driver does the work on its own threads. begin_build only starts that;
+is_ready polls it without blocking and finish_build collects the result.
+build_programs does begin_build on a whole set before finishing any of them.
+errors are logged per stage, with the file each stage came from.
+a failed rebuild keeps the program that was there before, so id() stays
+usable. uniform and attribute locations are read once after each build and
+looked up from a table after that. a rebuild gives the new program every
+uniform value set_uniform sent the old one, where the name and type match.
+
+set_uniform keeps a copy of the last value sent to each active uniform and
+makes no GL call at all when the new one is the same. it binds the program
+itself if it has to upload. use() skips glUseProgram when the program is
+already bound; code that binds programs with glUseProgram directly should
+call forget_bound_program() afterwards. only the first element of an array
+uniform is tracked, the rest are always sent.
+
+uniform blocks registered with set_uniform_block_binding are pointed at their
+binding point after every build, since #version 400 shaders can't say
+layout(binding = n) themselves. */
+class shader_program
+{
+public:
+  shader_program();
+  ~shader_program();
+  shader_program(const shader_program&) = delete;
+  shader_program& operator=(const shader_program&) = delete;
+
+  // false, with the error logged, when the file can't be read
+  bool add_stage_file(GLenum type, const char* path);
+  void add_stage_source(GLenum type, const char* source,
+			const char* name = "<source>");
+  // put after each stage's #version line, e.g. "#define SHADOWS 1\n"
+  void set_defines(const char* defines);
+  int stage_count() const { return (int)m_stages.size(); }
+  // the path add_stage_file was given, NULL for add_stage_source stages
+  const char* stage_file(int i) const;
+  // new text for a stage, used from the next build on
+  void set_stage_source(int i, const std::string& source);
+
+  bool build();
+  void begin_build();
+  bool is_ready() const;
+  bool finish_build();
+
+  GLuint id() const { return m_id; }
+  /* deletes the program and its shaders and stops watching it; call it
+  before stop_gl() when the object outlives the context. the stages are
+  kept, so build() makes it again */
+  void destroy();
+  void use() const;
+  // -1 for names that aren't active in the program
+  GLint uniform(const char* name);
+  GLint attribute(const char* name);
+
+  // location from uniform(). ints cover bools and samplers too
+  void set_uniform(GLint location, float v);
+  void set_uniform(GLint location, int v);
+  void set_uniform(GLint location, const vec2& v);
+  void set_uniform(GLint location, const vec3& v);
+  void set_uniform(GLint location, const vec4& v);
+  void set_uniform(GLint location, const mat3& m);
+  void set_uniform(GLint location, const mat4& m);
+
+private:
+  struct stage {
+    GLenum type;
+    std::string name; // file path or the name given to add_stage_source
+    bool from_file;
+    std::string source;
+    GLuint shader;
+  };
+
+  std::string stage_names() const;
+  void delete_shaders();
+  void bind_blocks();
+  void read_locations();
+  // name, type and last value of every uniform set_uniform has sent
+  struct kept_uniform {
+    std::string name;
+    GLenum type;
+    std::vector<unsigned char> value;
+  };
+  std::vector<kept_uniform> kept_uniforms() const;
+  void restore_uniforms(const std::vector<kept_uniform>& kept);
+  // false when value matches what location last got, else remembers it
+  bool uniform_changed(GLint location, const void* value, size_t bytes);
+
+  std::vector<stage> m_stages;
+  std::string m_defines;
+  GLuint m_id;
+  GLuint m_pending; // being built, replaces m_id once it links
+  bool m_pending_cached;
+  uint64_t m_key;
+  double m_started;
+  std::unordered_map<std::string, GLint> m_uniforms;
+  std::unordered_map<std::string, GLint> m_attributes;
+  // last uploaded values. m_shadow_at[location] is the offset of a uniform's
+  // copy in m_shadow, or -1 for untracked locations
+  std::vector<int> m_shadow_at;
+  std::vector<GLenum> m_shadow_type;
+  std::vector<unsigned char> m_shadow;
+  std::vector<bool> m_shadow_set;
+  bool m_warned_mismatch; // logged a setter of the wrong size once already
+};
+
+// glUseProgram was called behind shader_program's back
+void forget_bound_program();
+// set_uniform calls that reached GL, and ones skipped as unchanged
+void uniform_upload_stats(long* uploads, long* skipped);
+
+/* every program built from now on that has a uniform block called name gets
+it bound to binding. bytes, when not 0, is the size of the C++ struct that
+fills it; a block GL lays out at a different size is logged as an error */
+void set_uniform_block_binding(const char* name, GLuint binding,
+			       size_t bytes = 0);
+
+// starts every build before waiting on any. true if all of them built
+bool build_programs(shader_program* const* programs, int count);
+
+#endif
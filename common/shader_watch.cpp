@@ -0,0 +1,310 @@
+#include "shader_watch.h"
+#include "file_loader.h"
+#include "logging.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+struct watched_file
+{
+  shader_program* program;
+  int stage;
+  std::string path; // canonical, so it matches directory + event name
+};
+
+struct watched_dir
+{
+  int wd;
+  std::string path;
+};
+
+struct changed_stage
+{
+  shader_program* program;
+  int stage;
+  std::string source;
+};
+
+static std::mutex g_watch_mutex; // the three lists below
+static std::vector<watched_file> g_files;
+static std::vector<watched_dir> g_dirs;
+static std::vector<changed_stage> g_changed;
+// render thread only: programs with a reload build in flight
+static std::vector<shader_program*> g_building;
+static int g_fd = -1;
+static std::thread* g_watcher = NULL;
+static std::atomic<bool> g_stop(false);
+static int g_reloads = 0;
+static int g_failures = 0;
+
+#if defined(__linux__)
+
+/* reads every watched file in paths and queues its text for each stage that
+came from it. a file that can't be read is skipped; it is probably half way
+through being replaced and another event will follow */
+static void queue_changed(const std::vector<std::string>& paths)
+{
+  for (size_t i = 0; i < paths.size(); i++) {
+    bool watched = false;
+    {
+      std::lock_guard<std::mutex> lock(g_watch_mutex);
+      for (size_t j = 0; j < g_files.size() && !watched; j++) {
+	watched = g_files[j].path == paths[i];
+      }
+    }
+    std::string source;
+    if (!watched || !load_text_file(paths[i].c_str(), &source)) {
+      continue;
+    }
+    std::lock_guard<std::mutex> lock(g_watch_mutex);
+    for (size_t j = 0; j < g_files.size(); j++) {
+      if (g_files[j].path != paths[i]) {
+	continue;
+      }
+      bool queued = false;
+      for (size_t k = 0; k < g_changed.size(); k++) {
+	if (g_changed[k].program == g_files[j].program &&
+	    g_changed[k].stage == g_files[j].stage) {
+	  g_changed[k].source = source;
+	  queued = true;
+	}
+      }
+      if (!queued) {
+	g_changed.push_back({g_files[j].program, g_files[j].stage, source});
+      }
+    }
+    GL_LOG_INFO("shader", "%s changed\n", paths[i].c_str());
+  }
+}
+
+static void watcher_main()
+{
+  // inotify_event has an int first, the buffer has to be aligned for it
+  alignas(inotify_event) char buffer[4096];
+  std::vector<std::string> dirty;
+  std::chrono::steady_clock::time_point last_change;
+  while (!g_stop.load()) {
+    pollfd p = {g_fd, POLLIN, 0};
+    int ready = poll(&p, 1, dirty.empty() ? 200 : SHADER_WATCH_SETTLE_MS);
+    if (ready > 0) {
+      ssize_t n = read(g_fd, buffer, sizeof(buffer));
+      for (char* at = buffer; n > 0 && at < buffer + n;) {
+	const inotify_event* e = (const inotify_event*)at;
+	at += sizeof(inotify_event) + e->len;
+	if (!e->len) {
+	  continue;
+	}
+	std::string path;
+	bool watched = false;
+	{
+	  std::lock_guard<std::mutex> lock(g_watch_mutex);
+	  for (size_t i = 0; i < g_dirs.size(); i++) {
+	    if (g_dirs[i].wd == e->wd) {
+	      path = g_dirs[i].path + "/" + e->name;
+	    }
+	  }
+	  for (size_t i = 0; i < g_files.size() && !watched; i++) {
+	    watched = g_files[i].path == path;
+	  }
+	}
+	/* the watch is on the directory, so other files in it show up too. a
+	frame capture written there every frame must not hold the settle
+	below off for ever */
+	if (!watched) {
+	  continue;
+	}
+	last_change = std::chrono::steady_clock::now();
+	bool seen = false;
+	for (size_t i = 0; i < dirty.size() && !seen; i++) {
+	  seen = dirty[i] == path;
+	}
+	if (!seen) {
+	  dirty.push_back(path);
+	}
+      }
+    }
+    // editors save in several steps, wait for them to finish
+    if (!dirty.empty() && std::chrono::steady_clock::now() - last_change >=
+	std::chrono::milliseconds(SHADER_WATCH_SETTLE_MS)) {
+      queue_changed(dirty);
+      dirty.clear();
+    }
+  }
+}
+
+bool watch_shader_program(shader_program* program)
+{
+  if (g_fd < 0) {
+    g_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (g_fd < 0) {
+      gl_log_err("ERROR: shader watch: inotify_init1 failed\n");
+      return false;
+    }
+    g_stop = false;
+    g_watcher = new std::thread(watcher_main);
+  }
+  std::lock_guard<std::mutex> lock(g_watch_mutex);
+  for (int i = 0; i < program->stage_count(); i++) {
+    const char* file = program->stage_file(i);
+    char real[PATH_MAX];
+    if (!file) {
+      continue;
+    }
+    if (!realpath(file, real)) {
+      gl_log_err("ERROR: shader watch: can't resolve %s\n", file);
+      continue;
+    }
+    std::string path = real;
+    size_t slash = path.rfind('/');
+    std::string dir = slash ? path.substr(0, slash) : "/";
+    bool have_dir = false;
+    for (size_t j = 0; j < g_dirs.size() && !have_dir; j++) {
+      have_dir = g_dirs[j].path == dir;
+    }
+    if (!have_dir) {
+      // the directory, not the file: a rename over the file replaces its inode
+      int wd = inotify_add_watch(g_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+      if (wd < 0) {
+	gl_log_err("ERROR: shader watch: can't watch %s\n", dir.c_str());
+	continue;
+      }
+      g_dirs.push_back({wd, dir});
+    }
+    g_files.push_back({program, i, path});
+    gl_log("shader watch: %s\n", path.c_str());
+  }
+  return true;
+}
+
+#else
+
+bool watch_shader_program(shader_program* program)
+{
+  (void)program;
+  gl_log("shader watch: needs inotify, no hot-reload on this platform\n");
+  return false;
+}
+
+#endif
+
+void unwatch_shader_program(shader_program* program)
+{
+  {
+    std::lock_guard<std::mutex> lock(g_watch_mutex);
+    for (size_t i = 0; i < g_files.size();) {
+      if (g_files[i].program == program) {
+	g_files.erase(g_files.begin() + i);
+      } else {
+	i++;
+      }
+    }
+    for (size_t i = 0; i < g_changed.size();) {
+      if (g_changed[i].program == program) {
+	g_changed.erase(g_changed.begin() + i);
+      } else {
+	i++;
+      }
+    }
+  }
+  for (size_t i = 0; i < g_building.size();) {
+    if (g_building[i] == program) {
+      g_building.erase(g_building.begin() + i);
+    } else {
+      i++;
+    }
+  }
+}
+
+int apply_shader_reloads()
+{
+  // builds started on earlier frames, once the driver has them done
+  int swapped = 0;
+  for (size_t i = 0; i < g_building.size();) {
+    shader_program* program = g_building[i];
+    if (!program->is_ready()) {
+      i++;
+      continue;
+    }
+    g_building.erase(g_building.begin() + i);
+    if (program->finish_build()) {
+      g_reloads++;
+      swapped++;
+    } else {
+      g_failures++;
+      gl_log_err("shader watch: keeping the previous program\n");
+    }
+  }
+
+  std::vector<changed_stage> changed;
+  {
+    std::lock_guard<std::mutex> lock(g_watch_mutex);
+    if (g_changed.empty()) {
+      return swapped;
+    }
+    changed.swap(g_changed);
+  }
+  std::vector<shader_program*> rebuild;
+  for (size_t i = 0; i < changed.size(); i++) {
+    changed[i].program->set_stage_source(changed[i].stage, changed[i].source);
+    bool listed = false;
+    for (size_t j = 0; j < rebuild.size() && !listed; j++) {
+      listed = rebuild[j] == changed[i].program;
+    }
+    if (!listed) {
+      rebuild.push_back(changed[i].program);
+    }
+  }
+  for (size_t i = 0; i < rebuild.size(); i++) {
+    // begin_build drops a build still in flight and starts over
+    bool listed = false;
+    for (size_t j = 0; j < g_building.size() && !listed; j++) {
+      listed = g_building[j] == rebuild[i];
+    }
+    rebuild[i]->begin_build();
+    if (!listed) {
+      g_building.push_back(rebuild[i]);
+    }
+  }
+  return swapped;
+}
+
+void stop_shader_watch()
+{
+  if (g_watcher) {
+    g_stop = true;
+    g_watcher->join();
+    delete g_watcher;
+    g_watcher = NULL;
+  }
+#if defined(__linux__)
+  if (g_fd >= 0) {
+    close(g_fd);
+    g_fd = -1;
+  }
+#endif
+  std::lock_guard<std::mutex> lock(g_watch_mutex);
+  g_files.clear();
+  g_dirs.clear();
+  g_changed.clear();
+  g_building.clear();
+}
+
+void shader_reload_stats(int* reloads, int* failures)
+{
+  if (reloads) {
+    *reloads = g_reloads;
+  }
+  if (failures) {
+    *failures = g_failures;
+  }
+}
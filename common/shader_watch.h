@@ -0,0 +1,28 @@
+#ifndef _SHADER_WATCH_H
+#define _SHADER_WATCH_H
+
+#include "shader_program.h"
+
+/* shader hot-reload. watch_shader_program has a background thread keep an eye
+on the files a program's stages came from (inotify on their directories, so
+editors that save by renaming a new file over the old one are seen too). once
+a changed file has been quiet for SHADER_WATCH_SETTLE_MS the thread reads it
+and queues the new text; nothing touches GL off the render thread.
+apply_shader_reloads, which gl_end_frame calls, hands queued text to its
+program and starts a rebuild, then on a later frame boundary, when is_ready
+says the driver is done, finishes it. a failed rebuild logs the errors and
+leaves the previous program in place, so a typo costs nothing but the log
+message. programs unwatch themselves when destroyed. linux only, elsewhere
+watch_shader_program logs that and returns false. */
+#define SHADER_WATCH_SETTLE_MS 50
+
+bool watch_shader_program(shader_program* program);
+void unwatch_shader_program(shader_program* program);
+// render thread, between frames. returns how many programs were swapped
+int apply_shader_reloads();
+// stops the thread and forgets every program. stop_gl calls this
+void stop_shader_watch();
+// rebuilds that replaced a program, and ones that failed
+void shader_reload_stats(int* reloads, int* failures);
+
+#endif
@@ -0,0 +1,176 @@
+#include "stream_buffer.h"
+#include "logging.h"
+#include <string.h>
+
+// regions start on this so any alignment up to it holds from the start
+#define STREAM_REGION_ALIGN 256
+
+stream_buffer::stream_buffer()
+  : m_buffer(0), m_persistent(NULL), m_frame_bytes(0), m_region(0),
+    m_head(0), m_mapped(false), m_warned(false)
+{
+  memset(m_fences, 0, sizeof(m_fences));
+}
+
+stream_buffer::~stream_buffer()
+{
+  destroy();
+}
+
+bool stream_buffer::create(GLsizeiptr frame_bytes, bool allow_persistent)
+{
+  destroy();
+  if (frame_bytes <= 0) {
+    gl_log_err("stream buffer: bad frame size %li\n", (long)frame_bytes);
+    return false;
+  }
+  m_frame_bytes = (frame_bytes + STREAM_REGION_ALIGN - 1) /
+    STREAM_REGION_ALIGN * STREAM_REGION_ALIGN;
+  GLsizeiptr total = m_frame_bytes * STREAM_BUFFER_FRAMES;
+  glGenBuffers(1, &m_buffer);
+  // the copy target, so no vertex array or uniform binding gets disturbed
+  glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+  if (allow_persistent && (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage)) {
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+      GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_COPY_WRITE_BUFFER, total, NULL, flags);
+    m_persistent = (char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, total,
+					   flags);
+    if (!m_persistent) {
+      // storage is immutable, so start again with a plain buffer
+      gl_log_err("stream buffer: persistent map failed, falling back\n");
+      glDeleteBuffers(1, &m_buffer);
+      glGenBuffers(1, &m_buffer);
+      glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+    }
+  }
+  if (!m_persistent) {
+    glBufferData(GL_COPY_WRITE_BUFFER, total, NULL, GL_STREAM_DRAW);
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  m_region = 0;
+  m_head = 0;
+  m_warned = false;
+  gl_log("stream buffer %u: %i x %li bytes, %s\n", m_buffer,
+	 STREAM_BUFFER_FRAMES, (long)m_frame_bytes,
+	 m_persistent ? "persistent mapped" : "mapped per range");
+  return true;
+}
+
+void stream_buffer::destroy()
+{
+  for (int i = 0; i < STREAM_BUFFER_FRAMES; i++) {
+    if (m_fences[i]) {
+      glDeleteSync(m_fences[i]);
+      m_fences[i] = 0;
+    }
+  }
+  if (m_buffer) {
+    if (m_persistent || m_mapped) {
+      glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+      glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+      glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &m_buffer);
+    m_buffer = 0;
+  }
+  m_persistent = NULL;
+  m_mapped = false;
+  m_frame_bytes = 0;
+  m_region = 0;
+  m_head = 0;
+}
+
+void stream_buffer::next_frame()
+{
+  if (!m_buffer) {
+    return;
+  }
+  if (m_mapped) {
+    unmap();
+  }
+  // covers every command that could read the region just written. the first
+  // frame wrote nothing, so there is nothing to fence yet
+  if (frame_used() > 0 && !m_fences[m_region]) {
+    m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  }
+  m_region = (m_region + 1) % STREAM_BUFFER_FRAMES;
+  // last written STREAM_BUFFER_FRAMES frames ago, so this rarely waits
+  if (m_fences[m_region]) {
+    GLenum r = glClientWaitSync(m_fences[m_region], GL_SYNC_FLUSH_COMMANDS_BIT,
+				0);
+    while (GL_TIMEOUT_EXPIRED == r) {
+      r = glClientWaitSync(m_fences[m_region], GL_SYNC_FLUSH_COMMANDS_BIT,
+			   1000000000);
+    }
+    glDeleteSync(m_fences[m_region]);
+    m_fences[m_region] = 0;
+  }
+  m_head = m_region * m_frame_bytes;
+  m_warned = false;
+}
+
+void* stream_buffer::map(GLsizeiptr bytes, GLsizeiptr alignment,
+			 GLintptr* offset)
+{
+  if (!m_buffer || bytes <= 0 || m_mapped) {
+    return NULL;
+  }
+  if (alignment < 1) {
+    alignment = 1;
+  }
+  GLintptr start = (m_head + alignment - 1) & ~(GLintptr)(alignment - 1);
+  GLintptr end = (m_region + 1) * m_frame_bytes;
+  if (start + bytes > end) {
+    if (!m_warned) {
+      gl_log_err("stream buffer %u: %li bytes don't fit, %li of %li used "
+		 "this frame\n", m_buffer, (long)bytes, (long)frame_used(),
+		 (long)m_frame_bytes);
+      m_warned = true;
+    }
+    return NULL;
+  }
+  m_head = start + bytes;
+  *offset = start;
+  if (m_persistent) {
+    return m_persistent + start;
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+  void* p = glMapBufferRange(GL_COPY_WRITE_BUFFER, start, bytes,
+			     GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+			       GL_MAP_UNSYNCHRONIZED_BIT);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  m_mapped = p != NULL;
+  return p;
+}
+
+void stream_buffer::unmap()
+{
+  if (!m_mapped) {
+    return;
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+  glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  m_mapped = false;
+}
+
+GLintptr stream_buffer::push(const void* data, GLsizeiptr bytes,
+			     GLsizeiptr alignment)
+{
+  GLintptr offset = -1;
+  void* p = map(bytes, alignment, &offset);
+  if (!p) {
+    return -1;
+  }
+  memcpy(p, data, bytes);
+  unmap();
+  return offset;
+}
+
+GLsizeiptr stream_buffer::uniform_alignment()
+{
+  GLint align = 256;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+  return align < 1 ? 256 : align;
+}
@@ -0,0 +1,68 @@
+#ifndef _STREAM_BUFFER_H
+#define _STREAM_BUFFER_H
+
+#include <GL/glew.h>
+
+/* one buffer for data written every frame - vertices, uniform blocks,
+indirect commands - without re-specifying it with glBufferData each time.
+  stream_buffer stream;
+  stream.create(1 << 20);
+  ...each frame
+  stream.next_frame();
+  GLintptr at = stream.push(&block, sizeof(block), stream_buffer::uniform_alignment());
+  glBindBufferRange(GL_UNIFORM_BUFFER, 1, stream.buffer(), at, sizeof(block));
+the buffer is STREAM_BUFFER_FRAMES regions of frame_bytes each. a frame
+bump-allocates from its own region, and next_frame fences the region just
+filled and moves to the next one, waiting only if the GPU is still reading it
+from STREAM_BUFFER_FRAMES frames ago.
+with GL 4.4 or ARB_buffer_storage the whole buffer is mapped once, persistent
+and coherent, so map is pointer arithmetic. otherwise each map is a
+glMapBufferRange of just that range, unsynchronized and invalidating, which
+the fences make safe. either way nothing waits on the driver. */
+#define STREAM_BUFFER_FRAMES 3
+
+class stream_buffer
+{
+public:
+  stream_buffer();
+  ~stream_buffer();
+  stream_buffer(const stream_buffer&) = delete;
+  stream_buffer& operator=(const stream_buffer&) = delete;
+
+  /* frame_bytes is the most one frame can allocate. allow_persistent false
+  takes the glMapBufferRange path even when buffer storage is there */
+  bool create(GLsizeiptr frame_bytes, bool allow_persistent = true);
+  void destroy();
+  // once a frame, before its first allocation
+  void next_frame();
+
+  /* reserves bytes at a multiple of alignment (a power of 2) in this frame's
+  region and returns where to write them, with their offset into buffer() in
+  *offset. NULL, logged once, when the region is full. the data has to be
+  written and unmap called before a draw reads it; only one map at a time */
+  void* map(GLsizeiptr bytes, GLsizeiptr alignment, GLintptr* offset);
+  void unmap();
+  // map, copy and unmap. the offset, or -1 when the region is full
+  GLintptr push(const void* data, GLsizeiptr bytes, GLsizeiptr alignment = 16);
+
+  GLuint buffer() const { return m_buffer; }
+  bool is_persistent() const { return m_persistent != 0; }
+  GLsizeiptr frame_bytes() const { return m_frame_bytes; }
+  // bytes allocated so far this frame, padding included
+  GLsizeiptr frame_used() const { return m_head - m_region * m_frame_bytes; }
+
+  // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, for blocks bound with glBindBufferRange
+  static GLsizeiptr uniform_alignment();
+
+private:
+  GLuint m_buffer;
+  char* m_persistent; // the whole buffer, mapped for good, or NULL
+  GLsizeiptr m_frame_bytes;
+  GLsync m_fences[STREAM_BUFFER_FRAMES];
+  int m_region;
+  GLintptr m_head;  // next free byte in the buffer
+  bool m_mapped;    // a glMapBufferRange is outstanding
+  bool m_warned;    // logged running out this frame
+};
+
+#endif
@@ -0,0 +1,199 @@
+/******************************************************************************\
+| Structure-of-arrays vec3 storage and bulk kernels. See vec3_soa.h            |
+\******************************************************************************/
+#include "vec3_soa.h"
+#include "maths_simd.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SOA_ALIGNMENT 32
+#define SOA_PAD 8
+
+static float* soa_aligned_alloc( size_t bytes ) {
+#if defined( _WIN32 )
+  return (float*)_aligned_malloc( bytes, SOA_ALIGNMENT );
+#else
+  void* p = NULL;
+  if ( 0 != posix_memalign( &p, SOA_ALIGNMENT, bytes ) ) { return NULL; }
+  return (float*)p;
+#endif
+}
+
+static void soa_aligned_free( float* p ) {
+#if defined( _WIN32 )
+  _aligned_free( p );
+#else
+  free( p );
+#endif
+}
+
+vec3_soa::vec3_soa() : x( NULL ), y( NULL ), z( NULL ), count( 0 ), capacity( 0 ) {}
+
+bool vec3_soa_reserve( vec3_soa& s, int capacity ) {
+  if ( capacity <= s.capacity ) { return true; }
+  int cap   = ( capacity + SOA_PAD - 1 ) / SOA_PAD * SOA_PAD;
+  float* p  = soa_aligned_alloc( (size_t)cap * 3 * sizeof( float ) );
+  if ( !p ) { return false; }
+  memset( p, 0, (size_t)cap * 3 * sizeof( float ) );
+  if ( s.count > 0 ) {
+    memcpy( p, s.x, s.count * sizeof( float ) );
+    memcpy( p + cap, s.y, s.count * sizeof( float ) );
+    memcpy( p + 2 * cap, s.z, s.count * sizeof( float ) );
+  }
+  soa_aligned_free( s.x );
+  s.x        = p;
+  s.y        = p + cap;
+  s.z        = p + 2 * cap;
+  s.capacity = cap;
+  return true;
+}
+
+bool vec3_soa_resize( vec3_soa& s, int count ) {
+  if ( count > s.capacity && !vec3_soa_reserve( s, count ) ) { return false; }
+  if ( count < s.count ) {
+    // keep the padding zeroed so the 4-wide kernels can run over it
+    size_t n = ( s.count - count ) * sizeof( float );
+    memset( s.x + count, 0, n );
+    memset( s.y + count, 0, n );
+    memset( s.z + count, 0, n );
+  }
+  s.count = count;
+  return true;
+}
+
+void vec3_soa_free( vec3_soa& s ) {
+  soa_aligned_free( s.x );
+  s = vec3_soa();
+}
+
+bool vec3_soa_push( vec3_soa& s, const vec3& v ) {
+  if ( s.count == s.capacity && !vec3_soa_reserve( s, s.capacity > 0 ? s.capacity * 2 : 64 ) ) { return false; }
+  vec3_soa_set( s, s.count++, v );
+  return true;
+}
+
+vec3 vec3_soa_get( const vec3_soa& s, int i ) { return vec3( s.x[i], s.y[i], s.z[i] ); }
+
+void vec3_soa_set( vec3_soa& s, int i, const vec3& v ) {
+  s.x[i] = v.v[0];
+  s.y[i] = v.v[1];
+  s.z[i] = v.v[2];
+}
+
+const float* vec3_soa_data( const vec3_soa& s ) { return s.x; }
+
+size_t vec3_soa_data_size( const vec3_soa& s ) { return (size_t)s.capacity * 3 * sizeof( float ); }
+
+size_t vec3_soa_stream_offset( const vec3_soa& s, int stream ) { return (size_t)s.capacity * stream * sizeof( float ); }
+
+void vec3_soa_interleave( const vec3_soa& s, float* out ) {
+  for ( int i = 0; i < s.count; i++ ) {
+    out[i * 3 + 0] = s.x[i];
+    out[i * 3 + 1] = s.y[i];
+    out[i * 3 + 2] = s.z[i];
+  }
+}
+
+bool vec3_soa_from_interleaved( vec3_soa& s, const float* xyz, int count ) {
+  if ( !vec3_soa_resize( s, count ) ) { return false; }
+  for ( int i = 0; i < count; i++ ) {
+    s.x[i] = xyz[i * 3 + 0];
+    s.y[i] = xyz[i * 3 + 1];
+    s.z[i] = xyz[i * 3 + 2];
+  }
+  return true;
+}
+
+/*-------------------------------BULK KERNELS---------------------------------*/
+/* all of these do 4 elements per step and finish the last count % 4 with the
+same maths as the scalar vec3 functions in math_funcs.h */
+
+void dot( const vec3_soa& a, const vec3_soa& b, float* out ) {
+  int n = a.count, i = 0;
+  for ( ; i + 4 <= n; i += 4 ) {
+    simd4f r = simd4f_mul( simd4f_load( a.x + i ), simd4f_load( b.x + i ) );
+    r        = simd4f_madd( simd4f_load( a.y + i ), simd4f_load( b.y + i ), r );
+    r        = simd4f_madd( simd4f_load( a.z + i ), simd4f_load( b.z + i ), r );
+    simd4f_store( out + i, r );
+  }
+  for ( ; i < n; i++ ) { out[i] = a.x[i] * b.x[i] + a.y[i] * b.y[i] + a.z[i] * b.z[i]; }
+}
+
+bool cross( const vec3_soa& a, const vec3_soa& b, vec3_soa& out ) {
+  int n = a.count, i = 0;
+  if ( !vec3_soa_resize( out, n ) ) { return false; }
+  for ( ; i + 4 <= n; i += 4 ) {
+    simd4f ax = simd4f_load( a.x + i ), ay = simd4f_load( a.y + i ), az = simd4f_load( a.z + i );
+    simd4f bx = simd4f_load( b.x + i ), by = simd4f_load( b.y + i ), bz = simd4f_load( b.z + i );
+    simd4f_store( out.x + i, simd4f_sub( simd4f_mul( ay, bz ), simd4f_mul( az, by ) ) );
+    simd4f_store( out.y + i, simd4f_sub( simd4f_mul( az, bx ), simd4f_mul( ax, bz ) ) );
+    simd4f_store( out.z + i, simd4f_sub( simd4f_mul( ax, by ), simd4f_mul( ay, bx ) ) );
+  }
+  for ( ; i < n; i++ ) {
+    float x  = a.y[i] * b.z[i] - a.z[i] * b.y[i];
+    float y  = a.z[i] * b.x[i] - a.x[i] * b.z[i];
+    float z  = a.x[i] * b.y[i] - a.y[i] * b.x[i];
+    out.x[i] = x;
+    out.y[i] = y;
+    out.z[i] = z;
+  }
+  return true;
+}
+
+// zero-length vectors come out as zero, like normalise( const vec3& )
+bool normalise( const vec3_soa& v, vec3_soa& out ) {
+  int n = v.count, i = 0;
+  if ( !vec3_soa_resize( out, n ) ) { return false; }
+  simd4f zero = simd4f_splat( 0.0f );
+  simd4f one  = simd4f_splat( 1.0f );
+  for ( ; i + 4 <= n; i += 4 ) {
+    simd4f x = simd4f_load( v.x + i ), y = simd4f_load( v.y + i ), z = simd4f_load( v.z + i );
+    simd4f l = simd4f_sqrt( simd4f_madd( z, z, simd4f_madd( y, y, simd4f_mul( x, x ) ) ) );
+    // 1/l where l > 0, else 0
+    simd4f nonzero = simd4f_cmpgt( l, zero );
+    simd4f inv_l   = simd4f_and( simd4f_div( one, simd4f_max( l, simd4f_splat( 1e-30f ) ) ), nonzero );
+    simd4f_store( out.x + i, simd4f_mul( x, inv_l ) );
+    simd4f_store( out.y + i, simd4f_mul( y, inv_l ) );
+    simd4f_store( out.z + i, simd4f_mul( z, inv_l ) );
+  }
+  for ( ; i < n; i++ ) {
+    float x = v.x[i], y = v.y[i], z = v.z[i];
+    float l = sqrtf( x * x + y * y + z * z );
+    if ( 0.0f == l ) {
+      out.x[i] = out.y[i] = out.z[i] = 0.0f;
+      continue;
+    }
+    out.x[i] = x / l;
+    out.y[i] = y / l;
+    out.z[i] = z / l;
+  }
+  return true;
+}
+
+void length2( const vec3_soa& v, float* out ) { dot( v, v, out ); }
+
+void length( const vec3_soa& v, float* out ) {
+  int n = v.count, i = 0;
+  for ( ; i + 4 <= n; i += 4 ) {
+    simd4f x = simd4f_load( v.x + i ), y = simd4f_load( v.y + i ), z = simd4f_load( v.z + i );
+    simd4f_store( out + i, simd4f_sqrt( simd4f_madd( z, z, simd4f_madd( y, y, simd4f_mul( x, x ) ) ) ) );
+  }
+  for ( ; i < n; i++ ) { out[i] = sqrtf( v.x[i] * v.x[i] + v.y[i] * v.y[i] + v.z[i] * v.z[i] ); }
+}
+
+void get_squared_dist( const vec3_soa& from, const vec3_soa& to, float* out ) {
+  int n = from.count, i = 0;
+  for ( ; i + 4 <= n; i += 4 ) {
+    simd4f dx = simd4f_sub( simd4f_load( to.x + i ), simd4f_load( from.x + i ) );
+    simd4f dy = simd4f_sub( simd4f_load( to.y + i ), simd4f_load( from.y + i ) );
+    simd4f dz = simd4f_sub( simd4f_load( to.z + i ), simd4f_load( from.z + i ) );
+    simd4f_store( out + i, simd4f_madd( dz, dz, simd4f_madd( dy, dy, simd4f_mul( dx, dx ) ) ) );
+  }
+  for ( ; i < n; i++ ) {
+    float dx = to.x[i] - from.x[i];
+    float dy = to.y[i] - from.y[i];
+    float dz = to.z[i] - from.z[i];
+    out[i]   = dx * dx + dy * dy + dz * dz;
+  }
+}
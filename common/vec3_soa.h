@@ -0,0 +1,53 @@
+/******************************************************************************\
+| Structure-of-arrays storage for large numbers of vec3s                       |
+| x, y and z live in separate streams of one 32-byte aligned block:           |
+|   [ x0 x1 x2 ... ][ y0 y1 y2 ... ][ z0 z1 z2 ... ]                           |
+| so the bulk kernels below fill every SIMD lane instead of 3 of 4. They       |
+| mirror the single-vec3 free functions in math_funcs.h.                       |
+| The whole block can be handed to glBufferData as-is and read back with three |
+| single-float glVertexAttribPointer calls (see vec3_soa_stream_offset), or    |
+| packed into the interleaved x,y,z layout with vec3_soa_interleave.           |
+\******************************************************************************/
+#ifndef _VEC3_SOA_H_
+#define _VEC3_SOA_H_
+
+#include "math_funcs.h"
+#include <stddef.h>
+
+struct vec3_soa {
+  vec3_soa();
+  float* x;
+  float* y;
+  float* z;
+  int count;
+  // streams are padded to a multiple of 8 floats, padding is kept at zero
+  int capacity;
+};
+
+// (re)allocates for at least capacity vectors and keeps existing contents
+bool vec3_soa_reserve( vec3_soa& s, int capacity );
+// resizes, new elements are zero
+bool vec3_soa_resize( vec3_soa& s, int count );
+void vec3_soa_free( vec3_soa& s );
+bool vec3_soa_push( vec3_soa& s, const vec3& v );
+vec3 vec3_soa_get( const vec3_soa& s, int i );
+void vec3_soa_set( vec3_soa& s, int i, const vec3& v );
+// the single allocation backing all three streams and its size in bytes
+const float* vec3_soa_data( const vec3_soa& s );
+size_t vec3_soa_data_size( const vec3_soa& s );
+// byte offset of stream 0 (x), 1 (y) or 2 (z) inside vec3_soa_data
+size_t vec3_soa_stream_offset( const vec3_soa& s, int stream );
+// packed x,y,z,x,y,z... layout for a single vec3 attribute. out holds 3 * count floats
+void vec3_soa_interleave( const vec3_soa& s, float* out );
+bool vec3_soa_from_interleaved( vec3_soa& s, const float* xyz, int count );
+
+// bulk kernels. element-wise over the first out.count / a.count elements.
+// SoA results are resized to match, scalar results need room for count floats
+void dot( const vec3_soa& a, const vec3_soa& b, float* out );
+bool cross( const vec3_soa& a, const vec3_soa& b, vec3_soa& out );
+bool normalise( const vec3_soa& v, vec3_soa& out );
+void length( const vec3_soa& v, float* out );
+void length2( const vec3_soa& v, float* out );
+void get_squared_dist( const vec3_soa& from, const vec3_soa& to, float* out );
+
+#endif
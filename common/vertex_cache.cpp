@@ -0,0 +1,215 @@
+#include "vertex_cache.h"
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+// Forsyth's tuning, from "Linear-Speed Vertex Cache Optimisation"
+#define VCACHE_SIZE 32
+#define VCACHE_DECAY_POWER 1.5f
+#define VCACHE_LAST_TRI_SCORE 0.75f
+#define VCACHE_VALENCE_SCALE 2.0f
+#define VCACHE_VALENCE_POWER 0.5f
+
+// valence scores are tabled up to this many triangles, flat past there
+#define VCACHE_VALENCE_TABLE 32
+
+/* the scores only depend on a cache position and a small count, so they're
+worked out once. powf for every update was most of the run time */
+struct vertex_score_table
+{
+  float position[VCACHE_SIZE];
+  float valence[VCACHE_VALENCE_TABLE];
+
+  vertex_score_table()
+  {
+    for (int i = 0; i < VCACHE_SIZE; i++) {
+      if (i < 3) {
+	// used by the triangle just emitted. a fixed score, so the next one
+	// isn't just the same three vertices again
+	position[i] = VCACHE_LAST_TRI_SCORE;
+      } else {
+	float scale = 1.0f / (VCACHE_SIZE - 3);
+	position[i] = powf(1.0f - (i - 3) * scale, VCACHE_DECAY_POWER);
+      }
+    }
+    valence[0] = 0.0f;
+    for (int i = 1; i < VCACHE_VALENCE_TABLE; i++) {
+      valence[i] = VCACHE_VALENCE_SCALE * powf((float)i, -VCACHE_VALENCE_POWER);
+    }
+  }
+};
+
+static float vertex_score(const vertex_score_table& table, int cache_position,
+			  int triangles_left)
+{
+  if (0 == triangles_left) {
+    return -1.0f; // nothing left to draw with it
+  }
+  float score = cache_position >= 0 ? table.position[cache_position] : 0.0f;
+  // vertices with few triangles left are worth finishing off
+  if (triangles_left < VCACHE_VALENCE_TABLE) {
+    return score + table.valence[triangles_left];
+  }
+  return score + VCACHE_VALENCE_SCALE * powf((float)triangles_left,
+					     -VCACHE_VALENCE_POWER);
+}
+
+void optimize_vertex_cache(uint32_t* indices, int index_count,
+			   int vertex_count)
+{
+  int tri_count = index_count / 3;
+  if (tri_count < 2 || vertex_count <= 0) {
+    return;
+  }
+  // each vertex's triangles, as a slice of one array
+  std::vector<int> tris_left(vertex_count, 0);
+  for (int i = 0; i < tri_count * 3; i++) {
+    tris_left[indices[i]]++;
+  }
+  std::vector<int> first(vertex_count + 1, 0);
+  for (int v = 0; v < vertex_count; v++) {
+    first[v + 1] = first[v] + tris_left[v];
+  }
+  std::vector<int> adjacent(tri_count * 3);
+  std::vector<int> fill(first.begin(), first.end() - 1);
+  for (int t = 0; t < tri_count; t++) {
+    for (int k = 0; k < 3; k++) {
+      adjacent[fill[indices[t * 3 + k]]++] = t;
+    }
+  }
+
+  static const vertex_score_table table;
+  std::vector<int> cache_position(vertex_count, -1);
+  std::vector<float> score(vertex_count);
+  for (int v = 0; v < vertex_count; v++) {
+    score[v] = vertex_score(table, -1, tris_left[v]);
+  }
+  std::vector<float> tri_score(tri_count);
+  std::vector<bool> emitted(tri_count, false);
+  for (int t = 0; t < tri_count; t++) {
+    const uint32_t* tri = indices + t * 3;
+    tri_score[t] = score[tri[0]] + score[tri[1]] + score[tri[2]];
+  }
+
+  std::vector<uint32_t> out(tri_count * 3);
+  int cache[VCACHE_SIZE + 3];
+  int cache_used = 0;
+  int best = -1;
+  int scan_from = 0; // triangles before this are all emitted
+  for (int n = 0; n < tri_count; n++) {
+    if (best < 0) {
+      // nothing in the cache touches a triangle that's left: take the best of
+      // the rest. this happens once per disconnected piece of the mesh
+      float best_score = -1e30f;
+      while (emitted[scan_from]) {
+	scan_from++;
+      }
+      for (int t = scan_from; t < tri_count; t++) {
+	if (!emitted[t] && tri_score[t] > best_score) {
+	  best_score = tri_score[t];
+	  best = t;
+	}
+      }
+    }
+
+    const uint32_t tri[3] = {indices[best * 3], indices[best * 3 + 1],
+			     indices[best * 3 + 2]};
+    memcpy(&out[n * 3], tri, sizeof(tri));
+    emitted[best] = true;
+    for (int k = 0; k < 3; k++) {
+      int v = (int)tri[k];
+      // take best out of v's triangles, order doesn't matter
+      int* list = &adjacent[first[v]];
+      for (int j = 0; j < tris_left[v]; j++) {
+	if (list[j] == best) {
+	  list[j] = list[tris_left[v] - 1];
+	  break;
+	}
+      }
+      tris_left[v]--;
+    }
+
+    // the triangle's vertices go to the front, the rest move back
+    int new_cache[VCACHE_SIZE + 3];
+    int new_used = 0;
+    for (int k = 0; k < 3; k++) {
+      new_cache[new_used++] = (int)tri[k];
+    }
+    for (int i = 0; i < cache_used; i++) {
+      int v = cache[i];
+      if (v != (int)tri[0] && v != (int)tri[1] && v != (int)tri[2]) {
+	new_cache[new_used++] = v;
+      }
+    }
+    for (int i = 0; i < new_used; i++) {
+      int v = new_cache[i];
+      cache_position[v] = i < VCACHE_SIZE ? i : -1;
+      score[v] = vertex_score(table, cache_position[v], tris_left[v]);
+    }
+    // rescore what the cached and just-evicted vertices are part of, and
+    // pick the next triangle from those
+    best = -1;
+    float best_score = -1e30f;
+    for (int i = 0; i < new_used; i++) {
+      int v = new_cache[i];
+      const int* list = &adjacent[first[v]];
+      for (int j = 0; j < tris_left[v]; j++) {
+	int t = list[j];
+	const uint32_t* other = indices + t * 3;
+	tri_score[t] = score[other[0]] + score[other[1]] + score[other[2]];
+	if (tri_score[t] > best_score) {
+	  best_score = tri_score[t];
+	  best = t;
+	}
+      }
+    }
+    cache_used = new_used < VCACHE_SIZE ? new_used : VCACHE_SIZE;
+    memcpy(cache, new_cache, cache_used * sizeof(int));
+  }
+  memcpy(indices, out.data(), tri_count * 3 * sizeof(uint32_t));
+}
+
+void optimize_vertex_fetch(uint32_t* indices, int index_count,
+			   int vertex_count, uint32_t* remap)
+{
+  const uint32_t unused = 0xffffffffu;
+  for (int v = 0; v < vertex_count; v++) {
+    remap[v] = unused;
+  }
+  uint32_t next = 0;
+  for (int i = 0; i < index_count; i++) {
+    uint32_t& r = remap[indices[i]];
+    if (unused == r) {
+      r = next++;
+    }
+    indices[i] = r;
+  }
+  for (int v = 0; v < vertex_count; v++) {
+    if (unused == remap[v]) {
+      remap[v] = next++;
+    }
+  }
+}
+
+float vertex_cache_acmr(const uint32_t* indices, int index_count,
+			int cache_size)
+{
+  if (index_count < 3 || cache_size <= 0) {
+    return 0.0f;
+  }
+  std::vector<uint32_t> fifo(cache_size, 0xffffffffu);
+  int head = 0;
+  int misses = 0;
+  for (int i = 0; i < index_count; i++) {
+    bool hit = false;
+    for (int j = 0; j < cache_size && !hit; j++) {
+      hit = fifo[j] == indices[i];
+    }
+    if (!hit) {
+      fifo[head] = indices[i];
+      head = (head + 1) % cache_size;
+      misses++;
+    }
+  }
+  return (float)misses / (float)(index_count / 3);
+}
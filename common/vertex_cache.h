@@ -0,0 +1,26 @@
+#ifndef _VERTEX_CACHE_H
+#define _VERTEX_CACHE_H
+
+#include <stdint.h>
+
+/* index-order optimisers for triangle lists, used by mesh::create and
+mesh_pool::add. plain CPU code, no GL needed */
+
+/* reorders a triangle list for the post-transform vertex cache with Tom
+Forsyth's linear-speed algorithm: triangles are emitted greedily by a score
+that favours vertices near the front of a simulated 32-entry LRU cache and
+vertices with few triangles left, so each vertex is shaded as few times as
+possible. indices are rewritten in place */
+void optimize_vertex_cache(uint32_t* indices, int index_count,
+			   int vertex_count);
+/* renumbers vertices in the order indices first use them, unused ones last.
+remap[old] = new, for reordering the vertex data to match */
+void optimize_vertex_fetch(uint32_t* indices, int index_count,
+			   int vertex_count, uint32_t* remap);
+/* average cache miss ratio: vertices shaded per triangle with a FIFO cache
+of cache_size entries. 3 is every vertex every time, 0.5 is about the best a
+regular grid can do */
+float vertex_cache_acmr(const uint32_t* indices, int index_count,
+			int cache_size);
+
+#endif
@@ -0,0 +1,292 @@
+/******************************************************************************\
+| gl_log_decode - renders a binary log written by GL_LOG_BIN as text           |
+| usage: gl_log_decode [file] [--no-time] [--out file]                         |
+| file defaults to gl.log.bin. each message is printed with its time in        |
+| seconds since the first message of its session unless --no-time is given.    |
+| threads write whole buffers at a time, so messages are sorted by timestamp   |
+| within each session before printing.                                         |
+| the file must come from a machine with the same byte order.                  |
+\******************************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "file_loader.h"
+#include "logging.h"
+
+struct decoded_arg {
+  char tag;
+  int64_t i;
+  uint64_t u;
+  double d;
+  std::string s;
+};
+
+struct reader {
+  const unsigned char* p;
+  const unsigned char* end;
+  bool ok;
+};
+
+static bool read_bytes( reader& r, void* out, size_t n ) {
+  if ( !r.ok || (size_t)( r.end - r.p ) < n ) {
+    r.ok = false;
+    return false;
+  }
+  memcpy( out, r.p, n );
+  r.p += n;
+  return true;
+}
+
+static bool read_arg( reader& r, decoded_arg& a ) {
+  unsigned char tag = 0;
+  if ( !read_bytes( r, &tag, 1 ) ) { return false; }
+  a.tag = (char)tag;
+  a.i   = 0;
+  a.u   = 0;
+  a.d   = 0.0;
+  a.s.clear();
+  switch ( tag ) {
+  case GL_LOG_BIN_I32: {
+    int32_t v = 0;
+    read_bytes( r, &v, 4 );
+    a.i = v;
+    // as printf would see an int passed to %x / %u
+    a.u = (uint32_t)v;
+  } break;
+  case GL_LOG_BIN_I64: {
+    read_bytes( r, &a.i, 8 );
+    a.u = (uint64_t)a.i;
+  } break;
+  case GL_LOG_BIN_U32: {
+    uint32_t v = 0;
+    read_bytes( r, &v, 4 );
+    a.u = v;
+    a.i = (int32_t)v;
+  } break;
+  case GL_LOG_BIN_U64:
+  case GL_LOG_BIN_PTR: {
+    read_bytes( r, &a.u, 8 );
+    a.i = (int64_t)a.u;
+  } break;
+  case GL_LOG_BIN_F64: {
+    read_bytes( r, &a.d, 8 );
+    a.i = (int64_t)a.d;
+    a.u = (uint64_t)a.i;
+  } break;
+  case GL_LOG_BIN_STR: {
+    uint16_t n = 0;
+    if ( read_bytes( r, &n, 2 ) && (size_t)( r.end - r.p ) >= n ) {
+      a.s.assign( (const char*)r.p, n );
+      r.p += n;
+    } else {
+      r.ok = false;
+    }
+  } break;
+  default: r.ok = false;
+  }
+  if ( GL_LOG_BIN_F64 != tag ) { a.d = (double)a.i; }
+  return r.ok;
+}
+
+/* printf( format, args ) with the arguments from the file. each conversion
+is rebuilt with the length modifier for the type it was stored as, and '*'
+widths take the next argument like printf does */
+static std::string render( const std::string& format, const std::vector<decoded_arg>& args ) {
+  std::string out;
+  size_t next = 0;
+  char buf[2048];
+  for ( size_t i = 0; i < format.size(); i++ ) {
+    if ( format[i] != '%' ) {
+      out += format[i];
+      continue;
+    }
+    if ( i + 1 < format.size() && format[i + 1] == '%' ) {
+      out += '%';
+      i++;
+      continue;
+    }
+    std::string spec = "%";
+    size_t j         = i + 1;
+    // flags, width, precision
+    while ( j < format.size() && strchr( "-+ #0", format[j] ) ) { spec += format[j++]; }
+    for ( int part = 0; part < 2 && j < format.size(); part++ ) {
+      if ( 1 == part ) {
+        if ( format[j] != '.' ) { break; }
+        spec += format[j++];
+      }
+      if ( j < format.size() && format[j] == '*' ) {
+        spec += next < args.size() ? std::to_string( args[next++].i ) : "0";
+        j++;
+      }
+      while ( j < format.size() && format[j] >= '0' && format[j] <= '9' ) { spec += format[j++]; }
+    }
+    // the stored type decides the length modifier, not the format
+    while ( j < format.size() && strchr( "hlLqjzt", format[j] ) ) { j++; }
+    if ( j >= format.size() ) {
+      out += format.substr( i );
+      break;
+    }
+    char conv = format[j];
+    i         = j;
+    if ( 'n' == conv ) { continue; }
+    if ( next >= args.size() ) {
+      out += "<missing>";
+      continue;
+    }
+    const decoded_arg& a = args[next++];
+    switch ( conv ) {
+    case 'd':
+    case 'i': snprintf( buf, sizeof( buf ), ( spec + "lld" ).c_str(), (long long)a.i ); break;
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X': snprintf( buf, sizeof( buf ), ( spec + "ll" + conv ).c_str(), (unsigned long long)a.u ); break;
+    case 'c': snprintf( buf, sizeof( buf ), ( spec + "c" ).c_str(), (int)a.i ); break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A': snprintf( buf, sizeof( buf ), ( spec + conv ).c_str(), a.d ); break;
+    case 'p': snprintf( buf, sizeof( buf ), ( spec + "p" ).c_str(), (void*)(uintptr_t)a.u ); break;
+    case 's':
+      if ( GL_LOG_BIN_STR == a.tag ) {
+        snprintf( buf, sizeof( buf ), ( spec + "s" ).c_str(), a.s.c_str() );
+      } else {
+        snprintf( buf, sizeof( buf ), "<not a string>" );
+      }
+      break;
+    default: snprintf( buf, sizeof( buf ), "<bad conversion %%%c>", conv );
+    }
+    out += buf;
+  }
+  return out;
+}
+
+struct decoded_message {
+  uint64_t ns;
+  std::string text;
+};
+
+static bool earlier( const decoded_message& a, const decoded_message& b ) { return a.ns < b.ns; }
+
+static void print_session( FILE* out, std::vector<decoded_message>& messages, bool show_time ) {
+  std::stable_sort( messages.begin(), messages.end(), earlier );
+  for ( size_t i = 0; i < messages.size(); i++ ) {
+    if ( show_time ) { fprintf( out, "[%12.6f] ", (double)( messages[i].ns - messages[0].ns ) * 1e-9 ); }
+    fputs( messages[i].text.c_str(), out );
+  }
+  messages.clear();
+}
+
+int main( int argc, char** argv ) {
+  const char* in_file  = GL_LOG_BIN_FILE;
+  const char* out_file = NULL;
+  bool show_time       = true;
+  for ( int i = 1; i < argc; i++ ) {
+    if ( 0 == strcmp( argv[i], "--no-time" ) ) {
+      show_time = false;
+    } else if ( 0 == strcmp( argv[i], "--out" ) && i + 1 < argc ) {
+      out_file = argv[++i];
+    } else if ( argv[i][0] != '-' ) {
+      in_file = argv[i];
+    } else {
+      fprintf( stderr, "usage: %s [file] [--no-time] [--out file]\n", argv[0] );
+      return 1;
+    }
+  }
+
+  // mapped rather than read, logs can run to hundreds of megabytes
+  mapped_file data;
+  if ( !data.open( in_file ) ) {
+    fprintf( stderr, "ERROR: could not open %s\n", in_file );
+    return 1;
+  }
+
+  FILE* out = stdout;
+  if ( out_file ) {
+    out = fopen( out_file, "w" );
+    if ( !out ) {
+      fprintf( stderr, "ERROR: could not open %s for writing\n", out_file );
+      return 1;
+    }
+  }
+
+  const unsigned char* bytes = (const unsigned char*)data.data();
+  reader r = { bytes, bytes + data.size(), true };
+  char magic[4];
+  uint32_t version = 0;
+  if ( !read_bytes( r, magic, 4 ) || 0 != memcmp( magic, GL_LOG_BIN_MAGIC, 4 ) || !read_bytes( r, &version, 4 ) ) {
+    fprintf( stderr, "ERROR: %s is not a binary gl log\n", in_file );
+    return 1;
+  }
+  if ( version != GL_LOG_BIN_VERSION ) {
+    fprintf( stderr, "ERROR: %s is version %u, this decoder reads version %u\n", in_file, version, GL_LOG_BIN_VERSION );
+    return 1;
+  }
+
+  std::vector<std::string> formats;
+  std::vector<decoded_arg> args;
+  std::vector<decoded_message> session;
+  long messages = 0;
+  while ( r.ok && r.p < r.end ) {
+    unsigned char kind = 0;
+    read_bytes( r, &kind, 1 );
+    if ( GL_LOG_BIN_SESSION == kind ) {
+      int64_t when = 0;
+      if ( !read_bytes( r, &when, 8 ) ) { break; }
+      print_session( out, session, show_time );
+      time_t t = (time_t)when;
+      fprintf( out, "--- session started %s", ctime( &t ) );
+      formats.clear();
+    } else if ( GL_LOG_BIN_FORMAT == kind ) {
+      uint32_t id  = 0;
+      uint16_t len = 0;
+      // the writer numbers formats in order from 0 at each session, so an id
+      // past the next one is corruption, not a reason to grow the table
+      if ( !read_bytes( r, &id, 4 ) || !read_bytes( r, &len, 2 ) || (size_t)( r.end - r.p ) < len || id > formats.size() ) {
+        r.ok = false;
+        break;
+      }
+      if ( id == formats.size() ) { formats.push_back( std::string() ); }
+      formats[id].assign( (const char*)r.p, len );
+      r.p += len;
+    } else if ( GL_LOG_BIN_MESSAGE == kind ) {
+      uint32_t id   = 0;
+      uint64_t ns   = 0;
+      uint16_t size = 0;
+      if ( !read_bytes( r, &id, 4 ) || !read_bytes( r, &ns, 8 ) || !read_bytes( r, &size, 2 ) || (size_t)( r.end - r.p ) < size ) {
+        r.ok = false;
+        break;
+      }
+      reader ar = { r.p, r.p + size, true };
+      r.p += size;
+      args.clear();
+      while ( ar.ok && ar.p < ar.end ) {
+        decoded_arg a;
+        if ( read_arg( ar, a ) ) { args.push_back( a ); }
+      }
+      decoded_message m;
+      m.ns   = ns;
+      m.text = id < formats.size() ? render( formats[id], args ) : "<unknown format " + std::to_string( id ) + ">\n";
+      session.push_back( m );
+      messages++;
+    } else {
+      r.ok = false;
+    }
+  }
+  print_session( out, session, show_time );
+  if ( out != stdout ) { fclose( out ); }
+  if ( !r.ok ) {
+    fprintf( stderr, "WARNING: %s is truncated or corrupt after %ld messages\n", in_file, messages );
+    return 1;
+  }
+  return 0;
+}
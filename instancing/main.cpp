@@ -0,0 +1,167 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <cassert>
+#include <math.h>
+#include "math_funcs.h"
+#include "math_pack.h"
+#include "quat_batch.h"
+#include "gl_utils.h"
+#include "mesh.h"
+#include "shader_program.h"
+#include "shader_watch.h"
+#include "frame_uniforms.h"
+#include "stream_buffer.h"
+#include "logging.h"
+
+int g_gl_width = 640;
+int g_gl_height = 480;
+GLFWwindow* g_window;
+
+// a field of spinning triangles, one draw call for all of them
+#define INSTANCES_X 400
+#define INSTANCES_Y 250
+#define N_INSTANCES (INSTANCES_X * INSTANCES_Y)
+#define INSTANCE_SPACING 0.05f
+
+int main()
+{
+  assert(restart_gl_log());
+  if (!start_gl()) {
+    return 1;
+  }
+
+  // one small triangle, centred on its instance's position
+  GLfloat points[] = {
+		      0.0f, 0.02f, 0.0f,
+		      0.02f, -0.02f, 0.0f,
+		      -0.02f, -0.02f, 0.0f
+  };
+  GLfloat colours[] = {
+		       1.0f, 0.0f, 0.0f,
+		       0.0f, 1.0f, 0.0f,
+		       0.0f, 0.0f, 1.0f
+  };
+  uint16_t half_points[9];
+  encode_half(points, half_points, 9);
+  uint8_t byte_colours[3 * 4];
+  encode_colours_unorm8(colours, 3, byte_colours, 3);
+  vertex_layout layout;
+  layout.add_half(0, 3).add_colour_unorm8(1);
+  const void* streams[] = {half_points, byte_colours};
+  const uint32_t indices[] = {0, 1, 2};
+  mesh triangle;
+  if (!triangle.create(layout, streams, 3, indices, 3)) {
+    return 1;
+  }
+
+  // each instance is a model matrix, rewritten every frame into a stream
+  // buffer and read by the vertex shader's mat4 input at location 2
+  vertex_layout instance_layout;
+  instance_layout.add_mat4(2);
+  stream_buffer instances;
+  if (!instances.create(N_INSTANCES * sizeof(mat4))) {
+    return 1;
+  }
+
+  // before the build, so the program gets its frame_block bound
+  start_frame_uniforms();
+  shader_program programme;
+  programme.add_stage_file(GL_VERTEX_SHADER, "test7_vs.glsl");
+  programme.add_stage_file(GL_FRAGMENT_SHADER, "test7_fs.glsl");
+  if (!programme.build()) {
+    return 1;
+  }
+  // edits to the .glsl files are picked up while it runs
+  watch_shader_program(&programme);
+  bool result = is_valid(programme.id());
+  assert(result);
+
+  // a grid in the xy plane, every triangle spinning about its own axis at its
+  // own speed
+  static vec3 positions[N_INSTANCES];
+  static vec3 axes[N_INSTANCES];
+  static float speeds[N_INSTANCES];
+  static versor spins[N_INSTANCES];
+  static mat4 models[N_INSTANCES];
+  srand(1);
+  for (int y = 0; y < INSTANCES_Y; y++) {
+    for (int x = 0; x < INSTANCES_X; x++) {
+      int i = y * INSTANCES_X + x;
+      positions[i] = vec3(((float)x - 0.5f * INSTANCES_X) * INSTANCE_SPACING,
+			  ((float)y - 0.5f * INSTANCES_Y) * INSTANCE_SPACING,
+			  0.0f);
+      vec3 axis((float)rand() / RAND_MAX - 0.5f,
+		(float)rand() / RAND_MAX - 0.5f,
+		(float)rand() / RAND_MAX - 0.5f);
+      axes[i] = normalise(axis);
+      speeds[i] = 1.0f + 3.0f * (float)rand() / RAND_MAX;
+    }
+  }
+  gl_log("%i instances in 1 draw call\n", N_INSTANCES);
+
+  const float near = 0.1f; // clipping plane
+  const float far = 100.0f; // clipping plane
+  const float fov = 67.0f; // field of view in degrees
+  float aspect = (float)g_gl_width / (float)g_gl_height; // aspect ratio
+  mat4 proj_mat = perspective(fov, aspect, near, far);
+  // far enough back to see the whole grid
+  mat4 view_mat = translate(identity_mat4(), vec3(0.0f, 0.0f, -11.0f));
+
+  // the triangles turn, so both sides show
+  glDisable (GL_CULL_FACE);
+  glEnable (GL_DEPTH_TEST);
+  glDepthFunc(GL_LESS);
+
+  while(!gl_should_close()) {
+    // add a timer for amimation
+    static double previous_seconds = gl_get_time();
+    double current_seconds         = gl_get_time();
+    double elapsed_seconds          = current_seconds - previous_seconds;
+    previous_seconds               = current_seconds;
+    _update_fps_counter(g_window);
+
+    // built in ordinary memory and copied once: the mapping is write-combined,
+    // so it should be written front to back and never read
+    float t = (float)current_seconds;
+    for (int i = 0; i < N_INSTANCES; i++) {
+      spins[i] = quat_from_axis_rad(speeds[i] * t, axes[i].v[0], axes[i].v[1],
+				    axes[i].v[2]);
+    }
+    quat_to_mat4_batch(spins, models, N_INSTANCES);
+    for (int i = 0; i < N_INSTANCES; i++) {
+      models[i].m[12] = positions[i].v[0];
+      models[i].m[13] = positions[i].v[1];
+      models[i].m[14] = positions[i].v[2];
+    }
+    instances.next_frame();
+    GLintptr offset = instances.push(models, sizeof(models));
+
+    //wipe the drawing surface clear
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glViewport(0, 0, g_gl_width, g_gl_height);
+    update_frame_uniforms(view_mat, proj_mat, g_gl_width, g_gl_height,
+			  (float)current_seconds, (float)elapsed_seconds);
+    programme.use();
+    if (offset >= 0) {
+      triangle.set_instance_buffer(instance_layout, instances.buffer(), offset);
+      triangle.draw_instanced(N_INSTANCES);
+    }
+
+    if (gl_key_pressed(GLFW_KEY_ESCAPE))
+      {
+	gl_request_close();
+      }
+    //put the stuff we've been drawing onto the display, poll input
+    gl_end_frame();
+  }
+
+  // close GL context and any other GLFW resources
+  programme.destroy();
+  instances.destroy();
+  triangle.destroy();
+  stop_frame_uniforms();
+  stop_gl();
+  return 0;
+}
@@ -0,0 +1,8 @@
+#version 400
+
+in vec3 colour;
+out vec4 frag_colour;
+
+void main() {
+     frag_colour = vec4(colour, 1.0);
+}
\ No newline at end of file
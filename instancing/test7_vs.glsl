@@ -0,0 +1,23 @@
+#version 400
+
+layout(location = 0) in vec3 vertex_position;
+layout(location = 1) in vec3 vertex_colour;
+// per instance, from the instance buffer. takes locations 2 to 5
+layout(location = 2) in mat4 model;
+
+// filled once a frame by frame_uniforms.cpp
+layout(std140) uniform frame_block {
+  mat4 view;
+  mat4 proj;
+  mat4 view_proj;
+  vec4 viewport;
+  float time;
+  float delta_time;
+};
+
+out vec3 colour;
+
+void main() {
+     colour = vertex_colour;
+     gl_Position = view_proj * model * vec4 (vertex_position, 1.0);
+}
@@ -0,0 +1,284 @@
+/* micro-benchmarks for common/math_funcs.h and the batch kernels built on it.
+no GL needed - runs headless. results go to stdout and to a JSON file so runs
+from different compilers / SIMD backends can be compared.
+
+usage: math_bench [--filter substring] [--min-time seconds] [--out file.json]
+*/
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "math_batch.h"
+#include "frustum.h"
+#include "math_funcs.h"
+#include "math_pack.h"
+#include "quat_batch.h"
+#include "vec3_soa.h"
+
+#define DEFAULT_OUT_FILE "math_bench.json"
+// inputs are cycled through so nothing gets constant-folded
+#define N_INPUTS 1024
+#define BATCH_POINTS 65536
+#define BATCH_MATS 16384
+
+typedef std::chrono::steady_clock bench_clock;
+
+// stops the compiler from throwing away a result
+template <typename T> static inline void keep( const T& v ) {
+#if defined( __GNUC__ )
+  asm volatile( "" : : "r"( &v ) : "memory" );
+#else
+  static volatile const void* sink;
+  sink = &v;
+#endif
+}
+
+struct bench_result {
+  std::string name;
+  double ns_per_op;
+  // elements processed per op, > 1 for the batch cases
+  long items_per_op;
+  long iterations;
+};
+
+static std::vector<bench_result> g_results;
+static const char* g_filter = NULL;
+static double g_min_time    = 0.25;
+
+static float frand( float lo, float hi ) { return lo + ( hi - lo ) * ( (float)rand() / (float)RAND_MAX ); }
+
+/* runs fn( i ) in growing batches until min-time is reached, then reports
+the best of 3 such runs */
+template <typename F> static void run( const char* name, long items_per_op, F fn ) {
+  if ( g_filter && !strstr( name, g_filter ) ) { return; }
+  double best_ns = 1e30;
+  long best_iters = 0;
+  for ( int rep = 0; rep < 3; rep++ ) {
+    long iters = 1;
+    for ( ;; ) {
+      bench_clock::time_point t0 = bench_clock::now();
+      for ( long i = 0; i < iters; i++ ) { fn( i ); }
+      double secs = std::chrono::duration<double>( bench_clock::now() - t0 ).count();
+      if ( secs >= g_min_time ) {
+        double ns = secs * 1e9 / (double)iters;
+        if ( ns < best_ns ) {
+          best_ns    = ns;
+          best_iters = iters;
+        }
+        break;
+      }
+      iters = secs > 0.0 ? (long)( iters * 1.5 * g_min_time / secs ) + 1 : iters * 10;
+    }
+  }
+  bench_result r = { name, best_ns, items_per_op, best_iters };
+  g_results.push_back( r );
+  double items_per_sec = (double)items_per_op * 1e9 / best_ns;
+  printf( "%-28s %12.2f ns/op %14.3f M items/s\n", name, best_ns, items_per_sec / 1e6 );
+}
+
+static const char* simd_backend() {
+#if defined( MATHS_SIMD_SSE ) && defined( __AVX__ ) && defined( __FMA__ )
+  return "sse+avx+fma";
+#elif defined( MATHS_SIMD_SSE ) && defined( __AVX__ )
+  return "sse+avx";
+#elif defined( MATHS_SIMD_SSE )
+  return "sse";
+#elif defined( MATHS_SIMD_NEON )
+  return "neon";
+#else
+  return "scalar";
+#endif
+}
+
+static bool optimised() {
+#if defined( __OPTIMIZE__ ) || ( defined( _MSC_VER ) && defined( NDEBUG ) )
+  return true;
+#else
+  return false;
+#endif
+}
+
+static const char* compiler_id() {
+#if defined( __clang__ )
+  return "clang " __clang_version__;
+#elif defined( __GNUC__ )
+  return "gcc " __VERSION__;
+#elif defined( _MSC_VER )
+  return "msvc";
+#else
+  return "unknown";
+#endif
+}
+
+static bool write_json( const char* file_name ) {
+  FILE* f = fopen( file_name, "w" );
+  if ( !f ) {
+    fprintf( stderr, "ERROR: could not open %s for writing\n", file_name );
+    return false;
+  }
+  fprintf( f, "{\n  \"context\": {\n" );
+  fprintf( f, "    \"compiler\": \"%s\",\n", compiler_id() );
+  fprintf( f, "    \"simd\": \"%s\",\n", simd_backend() );
+  fprintf( f, "    \"optimised\": %s,\n", optimised() ? "true" : "false" );
+  fprintf( f, "    \"min_time_s\": %g\n  },\n", g_min_time );
+  fprintf( f, "  \"benchmarks\": [\n" );
+  for ( size_t i = 0; i < g_results.size(); i++ ) {
+    const bench_result& r = g_results[i];
+    fprintf( f, "    { \"name\": \"%s\", \"ns_per_op\": %.4f, \"items_per_op\": %ld, \"items_per_second\": %.1f, \"iterations\": %ld }%s\n", r.name.c_str(),
+      r.ns_per_op, r.items_per_op, (double)r.items_per_op * 1e9 / r.ns_per_op, r.iterations, i + 1 < g_results.size() ? "," : "" );
+  }
+  fprintf( f, "  ]\n}\n" );
+  fclose( f );
+  return true;
+}
+
+int main( int argc, char** argv ) {
+  const char* out_file = DEFAULT_OUT_FILE;
+  for ( int i = 1; i < argc; i++ ) {
+    if ( 0 == strcmp( argv[i], "--filter" ) && i + 1 < argc ) {
+      g_filter = argv[++i];
+    } else if ( 0 == strcmp( argv[i], "--min-time" ) && i + 1 < argc ) {
+      g_min_time = atof( argv[++i] );
+    } else if ( 0 == strcmp( argv[i], "--out" ) && i + 1 < argc ) {
+      out_file = argv[++i];
+    } else {
+      fprintf( stderr, "usage: %s [--filter substring] [--min-time seconds] [--out file.json]\n", argv[0] );
+      return 1;
+    }
+  }
+  printf( "math_bench. simd: %s compiler: %s\n", simd_backend(), compiler_id() );
+  if ( !optimised() ) { printf( "WARNING: unoptimised build, configure with -DCMAKE_BUILD_TYPE=Release\n" ); }
+
+  srand( 1 );
+  std::vector<mat4> mats( N_INPUTS ), affine( N_INPUTS );
+  std::vector<vec3> vecs( N_INPUTS );
+  std::vector<versor> quats( N_INPUTS );
+  for ( int i = 0; i < N_INPUTS; i++ ) {
+    for ( int j = 0; j < 16; j++ ) { mats[i].m[j] = frand( -1.0f, 1.0f ); }
+    vecs[i]   = vec3( frand( -10.0f, 10.0f ), frand( -10.0f, 10.0f ), frand( -10.0f, 10.0f ) );
+    quats[i]  = quat_from_axis_deg( frand( 0.0f, 360.0f ), 0.0f, 1.0f, 0.0f );
+    affine[i] = compose_trs( vecs[i], quats[i], vec3( 1.0f, 2.0f, 3.0f ) );
+  }
+  const int mask = N_INPUTS - 1;
+
+  run( "mat4_mul", 1, [&]( long i ) { keep( mats[i & mask] * mats[( i + 1 ) & mask] ); } );
+  run( "mat4_mul_vec4", 1, [&]( long i ) { keep( mats[i & mask] * vec4( vecs[i & mask], 1.0f ) ); } );
+  run( "mat4_mul_affine", 1, [&]( long i ) { keep( mul_affine( affine[i & mask], affine[( i + 1 ) & mask] ) ); } );
+  run( "transpose", 1, [&]( long i ) { keep( transpose( mats[i & mask] ) ); } );
+  run( "determinant", 1, [&]( long i ) { keep( determinant( mats[i & mask] ) ); } );
+  run( "inverse", 1, [&]( long i ) { keep( inverse( mats[i & mask] ) ); } );
+  run( "inverse_affine", 1, [&]( long i ) { keep( inverse_affine( affine[i & mask] ) ); } );
+  run( "inverse_rigid", 1, [&]( long i ) { keep( inverse_rigid( affine[i & mask] ) ); } );
+  run( "translate", 1, [&]( long i ) { keep( translate( affine[i & mask], vecs[i & mask] ) ); } );
+  run( "rotate_y_deg", 1, [&]( long i ) { keep( rotate_y_deg( affine[i & mask], (float)( i & 255 ) ) ); } );
+  run( "compose_trs", 1, [&]( long i ) { keep( compose_trs( vecs[i & mask], quats[i & mask], vecs[( i + 1 ) & mask] ) ); } );
+  run( "look_at", 1, [&]( long i ) { keep( look_at( vecs[i & mask], vecs[( i + 1 ) & mask], vec3( 0.0f, 1.0f, 0.0f ) ) ); } );
+  run( "perspective", 1, [&]( long i ) { keep( perspective( 40.0f + (float)( i & 63 ), 1.333f, 0.1f, 100.0f ) ); } );
+  run( "quat_to_mat4", 1, [&]( long i ) { keep( quat_to_mat4( quats[i & mask] ) ); } );
+  run( "slerp", 1, [&]( long i ) {
+    versor a = quats[i & mask], b = quats[( i + 1 ) & mask];
+    keep( slerp( a, b, 0.3f ) );
+  } );
+  run( "normalise_vec3", 1, [&]( long i ) { keep( normalise( vecs[i & mask] ) ); } );
+
+  // batch kernels
+  std::vector<vec3> pts( BATCH_POINTS ), pts_out( BATCH_POINTS );
+  for ( int i = 0; i < BATCH_POINTS; i++ ) { pts[i] = vecs[i & mask]; }
+  run( "transform_points_64k", BATCH_POINTS, [&]( long i ) {
+    transform_points( mats[i & mask], pts.data(), pts_out.data(), BATCH_POINTS );
+    keep( pts_out[0] );
+  } );
+  run( "transform_points_64k_mt", BATCH_POINTS, [&]( long i ) {
+    transform_points( mats[i & mask], pts.data(), pts_out.data(), BATCH_POINTS, 0 );
+    keep( pts_out[0] );
+  } );
+  // 4 threads whatever the core count, so the cost of handing out the work
+  // shows even on a small box
+  run( "transform_points_64k_4t", BATCH_POINTS, [&]( long i ) {
+    transform_points( mats[i & mask], pts.data(), pts_out.data(), BATCH_POINTS, 4 );
+    keep( pts_out[0] );
+  } );
+  std::vector<mat4> models( BATCH_MATS ), mvps( BATCH_MATS );
+  for ( int i = 0; i < BATCH_MATS; i++ ) { models[i] = affine[i & mask]; }
+  run( "mul_mat4_array_16k", BATCH_MATS, [&]( long i ) {
+    mul_mat4_array( mats[i & mask], models.data(), mvps.data(), BATCH_MATS );
+    keep( mvps[0] );
+  } );
+
+  std::vector<versor> keys_a( BATCH_MATS ), keys_b( BATCH_MATS ), pose( BATCH_MATS );
+  std::vector<float> blend( BATCH_MATS );
+  for ( int i = 0; i < BATCH_MATS; i++ ) {
+    keys_a[i] = quats[i & mask];
+    keys_b[i] = quats[( i + 7 ) & mask];
+    blend[i]  = frand( 0.0f, 1.0f );
+  }
+  run( "slerp_batch_16k", BATCH_MATS, [&]( long ) {
+    slerp_batch( keys_a.data(), keys_b.data(), blend.data(), pose.data(), BATCH_MATS );
+    keep( pose[0] );
+  } );
+  run( "nlerp_batch_16k", BATCH_MATS, [&]( long ) {
+    nlerp_batch( keys_a.data(), keys_b.data(), blend.data(), pose.data(), BATCH_MATS );
+    keep( pose[0] );
+  } );
+  run( "quat_to_mat4_batch_16k", BATCH_MATS, [&]( long ) {
+    quat_to_mat4_batch( keys_a.data(), models.data(), BATCH_MATS );
+    keep( models[0] );
+  } );
+
+  vec3_soa soa, soa_out;
+  vec3_soa_from_interleaved( soa, pts[0].v, BATCH_POINTS );
+  run( "normalise_soa_64k", BATCH_POINTS, [&]( long ) {
+    normalise( soa, soa_out );
+    keep( soa_out.x[0] );
+  } );
+
+  // camera at the origin looking down -z, inputs spread all round it so
+  // roughly 1 in 8 survive
+  frustum view_frustum = frustum_from_mat4( perspective( 67.0f, 1.333f, 0.1f, 100.0f ) );
+  std::vector<float> radii( BATCH_POINTS );
+  std::vector<int> visible( BATCH_POINTS );
+  for ( int i = 0; i < BATCH_POINTS; i++ ) { radii[i] = frand( 0.1f, 2.0f ); }
+  vec3_soa extents;
+  vec3_soa_resize( extents, BATCH_POINTS );
+  for ( int i = 0; i < BATCH_POINTS; i++ ) { vec3_soa_set( extents, i, vec3( radii[i], radii[i], radii[i] ) ); }
+  run( "cull_spheres_64k", BATCH_POINTS, [&]( long ) { keep( cull_spheres( view_frustum, soa, radii.data(), visible.data() ) ); } );
+  run( "cull_aabbs_64k", BATCH_POINTS, [&]( long ) { keep( cull_aabbs( view_frustum, soa, extents, visible.data() ) ); } );
+  vec3_soa_free( extents );
+
+  // vertex attribute encoders. pts are the inputs of unit length after normalise
+  std::vector<vec3> normals( BATCH_POINTS );
+  for ( int i = 0; i < BATCH_POINTS; i++ ) { normals[i] = normalise( pts[i] ); }
+  std::vector<uint16_t> halves( BATCH_POINTS * 3 );
+  std::vector<uint32_t> packed( BATCH_POINTS );
+  std::vector<int16_t> octs( BATCH_POINTS * 2 );
+  std::vector<uint8_t> bytes( BATCH_POINTS * 4 );
+  run( "encode_half_64k", BATCH_POINTS, [&]( long ) {
+    encode_half( pts[0].v, halves.data(), BATCH_POINTS * 3 );
+    keep( halves[0] );
+  } );
+  run( "decode_half_64k", BATCH_POINTS, [&]( long ) {
+    decode_half( halves.data(), pts_out[0].v, BATCH_POINTS * 3 );
+    keep( pts_out[0] );
+  } );
+  run( "encode_normals_2_10_10_10_64k", BATCH_POINTS, [&]( long ) {
+    encode_normals_2_10_10_10( normals.data(), packed.data(), BATCH_POINTS );
+    keep( packed[0] );
+  } );
+  run( "encode_normals_oct16_64k", BATCH_POINTS, [&]( long ) {
+    encode_normals_oct16( normals.data(), octs.data(), BATCH_POINTS );
+    keep( octs[0] );
+  } );
+  run( "encode_colours_unorm8_64k", BATCH_POINTS, [&]( long ) {
+    encode_colours_unorm8( normals[0].v, 3, bytes.data(), BATCH_POINTS );
+    keep( bytes[0] );
+  } );
+
+  vec3_soa_free( soa );
+  vec3_soa_free( soa_out );
+
+  if ( !write_json( out_file ) ) { return 1; }
+  printf( "results written to %s\n", out_file );
+  return 0;
+}
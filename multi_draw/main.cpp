@@ -0,0 +1,201 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <cassert>
+#include <math.h>
+#include <vector>
+#include "math_funcs.h"
+#include "math_pack.h"
+#include "frustum.h"
+#include "vec3_soa.h"
+#include "gl_utils.h"
+#include "mesh.h"
+#include "multi_draw.h"
+#include "shader_program.h"
+#include "shader_watch.h"
+#include "frame_uniforms.h"
+#include "stream_buffer.h"
+#include "logging.h"
+
+int g_gl_width = 640;
+int g_gl_height = 480;
+GLFWwindow* g_window;
+
+// a field of flat polygons all round the camera, 3 to 10 sided, as it turns
+// only the ones in front are drawn
+#define N_SHAPES 8
+#define N_OBJECTS 20000
+#define FIELD_RADIUS 40.0f
+
+int main()
+{
+  assert(restart_gl_log());
+  if (!start_gl()) {
+    return 1;
+  }
+
+  // every shape is a fan round its centre, radius 1, in one shared pool
+  vertex_layout layout;
+  layout.add_half(0, 3).add_colour_unorm8(1);
+  mesh_pool pool;
+  if (!pool.create(layout, 1024, 1024)) {
+    return 1;
+  }
+  for (int s = 0; s < N_SHAPES; s++) {
+    int sides = 3 + s;
+    std::vector<float> points(3 * (sides + 1));
+    std::vector<float> colours(3 * (sides + 1));
+    std::vector<uint32_t> indices;
+    colours[0] = colours[1] = colours[2] = 1.0f;
+    for (int i = 0; i < sides; i++) {
+      float a = TAU * (float)i / (float)sides;
+      float* p = &points[3 * (i + 1)];
+      p[0] = cosf(a);
+      p[1] = sinf(a);
+      float* c = &colours[3 * (i + 1)];
+      c[0] = 0.5f + 0.5f * cosf(a + (float)s);
+      c[1] = 0.5f + 0.5f * cosf(a + (float)s + TAU / 3.0f);
+      c[2] = 0.5f + 0.5f * cosf(a + (float)s + 2.0f * TAU / 3.0f);
+      indices.push_back(0);
+      indices.push_back(1 + i);
+      indices.push_back(1 + (i + 1) % sides);
+    }
+    std::vector<uint16_t> half_points(points.size());
+    encode_half(points.data(), half_points.data(), (int)points.size());
+    std::vector<uint8_t> byte_colours(4 * (sides + 1));
+    encode_colours_unorm8(colours.data(), 3, byte_colours.data(), sides + 1);
+    const void* streams[] = {half_points.data(), byte_colours.data()};
+    if (pool.add(streams, sides + 1, indices.data(), (int)indices.size()) < 0) {
+      return 1;
+    }
+  }
+
+  // the objects never move: one model matrix each in a static buffer, read
+  // by the mat4 input at location 2 from each command's base_instance
+  static int object_meshes[N_OBJECTS];
+  static mat4 models[N_OBJECTS];
+  static float radii[N_OBJECTS];
+  vec3_soa centres;
+  vec3_soa_resize(centres, N_OBJECTS);
+  srand(1);
+  for (int i = 0; i < N_OBJECTS; i++) {
+    float a = TAU * (float)rand() / RAND_MAX;
+    float d = 4.0f + (FIELD_RADIUS - 4.0f) * (float)rand() / RAND_MAX;
+    vec3 centre(d * cosf(a), 4.0f * ((float)rand() / RAND_MAX - 0.5f),
+		d * sinf(a));
+    float scale = 0.1f + 0.2f * (float)rand() / RAND_MAX;
+    versor spin = quat_from_axis_rad(TAU * (float)rand() / RAND_MAX, 0.0f,
+				     1.0f, 0.0f);
+    object_meshes[i] = rand() % N_SHAPES;
+    models[i] = compose_trs(centre, spin, vec3(scale, scale, scale));
+    vec3_soa_set(centres, i, centre);
+    radii[i] = scale;
+  }
+  vertex_layout instance_layout;
+  instance_layout.add_mat4(2);
+  GLuint model_buffer;
+  glGenBuffers(1, &model_buffer);
+  glBindBuffer(GL_ARRAY_BUFFER, model_buffer);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(models), models, GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  pool.set_instance_buffer(instance_layout, model_buffer, 0);
+
+  // culled on worker threads into commands, which go through a stream buffer
+  // to the GPU. or, G toggles it, culled by a compute shader on the GPU
+  static draw_elements_command commands[N_OBJECTS];
+  stream_buffer command_stream;
+  if (!command_stream.create(sizeof(commands))) {
+    return 1;
+  }
+  gpu_cull cull;
+  bool can_gpu_cull = pool.has_multi_draw_indirect() &&
+    gpu_cull::is_supported() &&
+    cull.create(pool, object_meshes, centres, radii);
+  bool use_gpu_cull = false;
+  bool g_was_down = false;
+
+  // before the build, so the program gets its frame_block bound
+  start_frame_uniforms();
+  shader_program programme;
+  programme.add_stage_file(GL_VERTEX_SHADER, "test8_vs.glsl");
+  programme.add_stage_file(GL_FRAGMENT_SHADER, "test8_fs.glsl");
+  if (!programme.build()) {
+    return 1;
+  }
+  // edits to the .glsl files are picked up while it runs
+  watch_shader_program(&programme);
+  bool result = is_valid(programme.id());
+  assert(result);
+
+  const float near = 0.1f; // clipping plane
+  const float far = 100.0f; // clipping plane
+  const float fov = 67.0f; // field of view in degrees
+  float aspect = (float)g_gl_width / (float)g_gl_height; // aspect ratio
+  mat4 proj_mat = perspective(fov, aspect, near, far);
+  float cam_yaw = 0.0f; // y-rotation degrees
+  float cam_yaw_speed = 10.0f; // 10 degrees per second
+
+  // the polygons face every way, so both sides show
+  glDisable (GL_CULL_FACE);
+  glEnable (GL_DEPTH_TEST);
+  glDepthFunc(GL_LESS);
+
+  while(!gl_should_close()) {
+    // add a timer for amimation
+    static double previous_seconds = gl_get_time();
+    double current_seconds         = gl_get_time();
+    double elapsed_seconds          = current_seconds - previous_seconds;
+    previous_seconds               = current_seconds;
+    _update_fps_counter(g_window);
+
+    cam_yaw += cam_yaw_speed * (float)elapsed_seconds;
+    mat4 view_mat = rotate_y_deg(identity_mat4(), -cam_yaw);
+    frustum view_frustum = frustum_from_mat4(proj_mat * view_mat);
+
+    //wipe the drawing surface clear
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glViewport(0, 0, g_gl_width, g_gl_height);
+    update_frame_uniforms(view_mat, proj_mat, g_gl_width, g_gl_height,
+			  (float)current_seconds, (float)elapsed_seconds);
+    if (use_gpu_cull) {
+      cull.run(view_frustum);
+      programme.use();
+      pool.draw(cull.command_buffer(), 0, NULL, cull.object_count());
+    } else {
+      int n = build_draw_commands(pool, view_frustum, object_meshes, centres,
+				  radii, commands, 0);
+      command_stream.next_frame();
+      GLintptr offset = command_stream.push(commands,
+					    n * sizeof(draw_elements_command));
+      programme.use();
+      if (offset >= 0) {
+	pool.draw(command_stream.buffer(), offset, commands, n);
+      }
+    }
+
+    // G switches between culling on the CPU and on the GPU
+    bool g_down = gl_key_pressed(GLFW_KEY_G);
+    if (g_down && !g_was_down && can_gpu_cull) {
+      use_gpu_cull = !use_gpu_cull;
+      gl_log("culling on the %s\n", use_gpu_cull ? "GPU" : "CPU");
+    }
+    g_was_down = g_down;
+    if (gl_key_pressed(GLFW_KEY_ESCAPE))
+      {
+	gl_request_close();
+      }
+    //put the stuff we've been drawing onto the display, poll input
+    gl_end_frame();
+  }
+
+  // close GL context and any other GLFW resources
+  cull.destroy();
+  command_stream.destroy();
+  pool.destroy();
+  glDeleteBuffers(1, &model_buffer);
+  vec3_soa_free(centres);
+  stop_frame_uniforms();
+  stop_gl();
+  return 0;
+}
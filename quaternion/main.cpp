@@ -0,0 +1,184 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <stdio.h>
+#include <cassert>
+#include <math.h>
+#include "math_funcs.h"
+#include "math_pack.h"
+#include "quat_batch.h"
+#include "gl_utils.h"
+#include "mesh.h"
+#include "shader_program.h"
+#include "shader_watch.h"
+#include "frame_uniforms.h"
+#include "logging.h"
+
+int g_gl_width = 640;
+int g_gl_height = 480;
+GLFWwindow* g_window;
+
+// a ring of jointed arms, every joint has its own keyframed rotation track
+#define N_ARMS 12
+#define N_JOINTS 16
+#define N_KEYS 5
+#define CLIP_SECONDS 4.0f
+#define SEGMENT_LENGTH 0.1f
+
+int main()
+{
+  assert(restart_gl_log());
+  if (!start_gl()) {
+    return 1;
+  }
+
+  // one arm segment, pointing up +y from the joint
+  GLfloat points[] = {
+		      0.0f, SEGMENT_LENGTH, 0.0f, // tip
+		      0.03f, 0.0f, 0.0f, // joint right
+		      -0.03f, 0.0f, 0.0f  // joint left
+  };
+
+  GLfloat colours[] = {
+		       1.0f, 0.0f, 0.0f,
+		       0.0f, 1.0f, 0.0f,
+		       0.0f, 0.0f, 1.0f
+  };
+
+  // half-float positions and byte colours, interleaved: 12 bytes a vertex
+  // where the two float buffers took 24
+  uint16_t half_points[9];
+  encode_half(points, half_points, 9);
+  uint8_t byte_colours[3 * 4];
+  encode_colours_unorm8(colours, 3, byte_colours, 3);
+  vertex_layout layout;
+  layout.add_half(0, 3).add_colour_unorm8(1);
+  const void* streams[] = {half_points, byte_colours};
+  const uint32_t indices[] = {0, 1, 2};
+  mesh segment;
+  if (!segment.create(layout, streams, 3, indices, 3)) {
+    return 1;
+  }
+
+
+  // before the build, so the program gets its frame_block bound
+  start_frame_uniforms();
+  shader_program programme;
+  programme.add_stage_file(GL_VERTEX_SHADER, "test6_vs.glsl");
+  programme.add_stage_file(GL_FRAGMENT_SHADER, "test6_fs.glsl");
+  if (!programme.build()) {
+    return 1;
+  }
+  // edits to the .glsl files are picked up while it runs
+  watch_shader_program(&programme);
+  bool result = is_valid(programme.id());
+  assert(result);
+
+  // animation clip. every joint swings about z and twists a little about y,
+  // the phase runs down the arm so each arm ripples like a tentacle. the last
+  // key repeats the first so the clip loops
+  const int n_tracks = N_ARMS * N_JOINTS;
+  static float key_times[N_KEYS];
+  static versor keys[n_tracks][N_KEYS];
+  static quat_track tracks[n_tracks];
+  for (int k = 0; k < N_KEYS; k++) {
+    key_times[k] = CLIP_SECONDS * (float)k / (float)(N_KEYS - 1);
+  }
+  for (int arm = 0; arm < N_ARMS; arm++) {
+    for (int j = 0; j < N_JOINTS; j++) {
+      int track = arm * N_JOINTS + j;
+      float phase = (float)j * 0.4f + (float)arm * 0.7f;
+      for (int k = 0; k < N_KEYS; k++) {
+	float a = phase + TAU * (float)k / (float)(N_KEYS - 1);
+	versor swing = quat_from_axis_deg(25.0f * sinf(a), 0.0f, 0.0f, 1.0f);
+	versor twist = quat_from_axis_deg(40.0f * cosf(a), 0.0f, 1.0f, 0.0f);
+	keys[track][k] = swing * twist;
+      }
+      tracks[track].times = key_times;
+      tracks[track].keys = keys[track];
+      tracks[track].count = N_KEYS;
+    }
+  }
+  quat_sampler sampler;
+  static versor pose[n_tracks];
+  static mat4 joint_mats[n_tracks];
+  static mat4 world_mats[n_tracks];
+  bool use_nlerp = false;
+  bool n_was_down = false;
+
+  // arms start evenly spaced round the centre
+  static mat4 arm_roots[N_ARMS];
+  for (int arm = 0; arm < N_ARMS; arm++) {
+    arm_roots[arm] = rotate_z_deg(identity_mat4(), 360.0f * (float)arm / (float)N_ARMS);
+  }
+
+  const float near = 0.1f; // clipping plane
+  const float far = 100.0f; // clipping plane
+  const float fov = 67.0f; // field of view in degrees
+  float aspect = (float)g_gl_width / (float)g_gl_height; // aspect ratio
+  mat4 proj_mat = perspective(fov, aspect, near, far);
+  mat4 view_mat = translate(identity_mat4(), vec3(0.0f, 0.0f, -3.0f));
+
+  // the arms twist so both sides of the segments show
+  glDisable (GL_CULL_FACE);
+
+  float clip_time = 0.0f;
+
+  while(!gl_should_close()) {
+    // add a timer for amimation
+    static double previous_seconds = gl_get_time();
+    double current_seconds         = gl_get_time();
+    double elapsed_seconds          = current_seconds - previous_seconds;
+    previous_seconds               = current_seconds;
+
+    _update_fps_counter(g_window);
+
+    // sample every joint at once, then build the hierarchy root to tip
+    clip_time = fmodf(clip_time + (float)elapsed_seconds, CLIP_SECONDS);
+    quat_sampler_sample(sampler, tracks, n_tracks, clip_time, pose, use_nlerp);
+    quat_to_mat4_batch(pose, joint_mats, n_tracks);
+    for (int arm = 0; arm < N_ARMS; arm++) {
+      mat4 parent = arm_roots[arm];
+      for (int j = 0; j < N_JOINTS; j++) {
+	int track = arm * N_JOINTS + j;
+	// joints sit at the tip of the previous segment
+	if (j > 0) {
+	  joint_mats[track].m[13] = SEGMENT_LENGTH;
+	}
+	world_mats[track] = mul_affine(parent, joint_mats[track]);
+	parent = world_mats[track];
+      }
+    }
+
+    //wipe the drawing surface clear
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glViewport(0, 0, g_gl_width, g_gl_height);
+    update_frame_uniforms(view_mat, proj_mat, g_gl_width, g_gl_height,
+			  (float)current_seconds, (float)elapsed_seconds);
+
+    // looked up each frame, a shader reload can move it
+    GLint model_mat_location = programme.uniform("model");
+    programme.use();
+    for (int i = 0; i < n_tracks; i++) {
+      programme.set_uniform(model_mat_location, world_mats[i]);
+      segment.draw();
+    }
+    // N toggles between slerp and the cheaper nlerp
+    bool n_down = gl_key_pressed(GLFW_KEY_N);
+    if (n_down && !n_was_down) {
+      use_nlerp = !use_nlerp;
+      gl_log("sampling with %s\n", use_nlerp ? "nlerp" : "slerp");
+    }
+    n_was_down = n_down;
+    if (gl_key_pressed(GLFW_KEY_ESCAPE))
+      {
+	gl_request_close();
+      }
+    //put the stuff we've been drawing onto the display, poll input
+    gl_end_frame();
+  }
+
+  // close GL context and any other GLFW resources
+  stop_frame_uniforms();
+  stop_gl();
+  return 0;
+}
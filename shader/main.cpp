@@ -3,6 +3,8 @@
 #include <stdio.h>
 #include <cassert>
 #include "logging.h"
+#include "shader_program.h"
+#include "shader_watch.h"
 
 int g_gl_width = 640;
 int g_gl_height = 480;
@@ -105,17 +107,6 @@ static const char* GL_type_to_string(GLenum type) {
   return "other";
 }
 
-// Print the shader info log
-static void _print_shader_info_log(GLuint shader_index) {
-  int max_length = 2048;
-  int actual_length = 0;
-  char log[2048];
-  glGetShaderInfoLog(shader_index, max_length, &actual_length,
-		     log);
-  printf("shader info log for GL index %u\n%s\n",
-	 shader_index, log);
-}
-
 // Print the program info log
 static void _print_programme_info_log(GLuint programme) {
   int max_length = 2048;
@@ -204,31 +195,6 @@ static bool is_valid (GLuint programme) {
   return true;
 }
 
-/* load plain text shader to a character array */
-bool parse_file_into_str(const char* file_name, char* shader_str,
-			 int max_len) {
-  FILE* file = fopen(file_name, "r");
-  if(!file) {
-    gl_log_err("ERROR: opening file for reading: %s\n", file_name);
-    return false;
-  }
-
-  size_t cnt = fread(shader_str, 1, max_len - 1, file);
-  if ((int)cnt >= max_len -1) {
-    gl_log_err("WARNING: file %s too big - truncated.\n", file_name);
-  }
-  if (ferror(file)) {
-    gl_log_err("ERROR: reading shader file %s\n", file_name);
-    fclose(file);
-    return false;
-  }
-  // append \0 to end of string
-  shader_str[cnt] = 0;
-  fclose(file);
-  return true;
-}
-
-
 int main()
 {
   assert(restart_gl_log());
@@ -291,14 +257,12 @@ int main()
   };
 
   GLuint vbo = 0; // our vertex buffer
-  char vertex_shader[1024 * 256];
   glGenBuffers (1, &vbo); // set as the current buffer
   glBindBuffer (GL_ARRAY_BUFFER, vbo);
   // copy our points into the currently bound buffer
   glBufferData (GL_ARRAY_BUFFER, sizeof (points), points, GL_STATIC_DRAW);
 
   GLuint vao = 0; // our mesh aka vertext array
-  char fragment_shader[1024 * 256];
   glGenVertexArrays (1, &vao); // turn vao into a mesh
   glBindVertexArray(vao); // make it current mesh
   glEnableVertexAttribArray(0);
@@ -320,59 +284,25 @@ int main()
     "  frag_colour = vec4 (0.5, 0.0, 0.5, 1.0);"
     "}";
   */
-  parse_file_into_str("test_vs.glsl", vertex_shader, 1024 * 256);
-  parse_file_into_str("test_fs.glsl", fragment_shader, 1024 * 256);
-
-  const GLchar* p;
-  
-  GLuint vs = glCreateShader (GL_VERTEX_SHADER);
-  p = (const GLchar*)vertex_shader;
-  glShaderSource (vs, 1, &p, NULL);
-  glCompileShader(vs);
-
-  // check for compile errors
-  int params = -1;
-  glGetShaderiv(vs, GL_COMPILE_STATUS, &params);
-  if (GL_TRUE != params) {
-    fprintf(stderr, "ERROR: GL shader index %i did not compile\n",
-	    vs);
-    _print_shader_info_log(vs);
-    return -1;
-  }
-  
-  GLuint fs = glCreateShader (GL_FRAGMENT_SHADER);
-  p = (const GLchar*)fragment_shader;
-  glShaderSource (fs, 1, &p, NULL);
-  glCompileShader(fs);
-  params = -1;
-  glGetShaderiv(vs, GL_COMPILE_STATUS, &params);
-  if (GL_TRUE != params) {
-    fprintf(stderr, "ERROR: GL shader index %i did not compile\n",
-	    fs);
-    _print_shader_info_log(fs);
-    return -1;
-  }
-  GLuint shader_programme = glCreateProgram();
-  glAttachShader (shader_programme, fs);
-  glAttachShader (shader_programme, vs);
-  glLinkProgram (shader_programme);
-  params = -1;
-  glGetProgramiv(shader_programme, GL_LINK_STATUS, &params);
-  if (GL_TRUE != params) {
-    fprintf(stderr, "ERROR: could not link shader programm GL index %u\n",
-	    shader_programme);
-    _print_programme_info_log(shader_programme);
+  shader_program programme;
+  programme.add_stage_file(GL_VERTEX_SHADER, "test_vs.glsl");
+  programme.add_stage_file(GL_FRAGMENT_SHADER, "test_fs.glsl");
+  if (!programme.build()) {
     return -1;
   }
-  print_all(shader_programme);
-  bool result = is_valid(shader_programme);
+  // edits to the .glsl files are picked up while it runs
+  watch_shader_program(&programme);
+  print_all(programme.id());
+  bool result = is_valid(programme.id());
   assert(result);
 
   GLint colour_loc;
-  colour_loc = glGetUniformLocation(shader_programme, "inputColour");
+  colour_loc = programme.uniform("inputColour");
   assert(colour_loc > -1);
-  glUseProgram(shader_programme);
-  glUniform4f(colour_loc, 1.0f, 0.0f, 0.0f, 1.0f);
+  // set once: a shader reload carries the value over to the new program by
+  // name, wherever the uniform ends up
+  programme.use();
+  programme.set_uniform(colour_loc, vec4(1.0f, 0.0f, 0.0f, 1.0f));
 
   // draw our triangle
   while(!glfwWindowShouldClose (window)) {
@@ -380,7 +310,7 @@ int main()
       //wipe the drawing surface clear
       glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
       glViewport(0, 0, g_gl_width, g_gl_height);
-      glUseProgram(shader_programme);
+      programme.use();
       glBindVertexArray(vao);
       //draw points 0-3 from the currently bound VAO with current in-use shader
       glDrawArrays(GL_TRIANGLES, 0, 3);
@@ -390,11 +320,13 @@ int main()
 	{
 	  glfwSetWindowShouldClose(window, 1);
 	}
+      apply_shader_reloads();
       //put the stuff we've been drawing onto the display
       glfwSwapBuffers (window);
     }
   
   // close GL context and any other GLFW resources
+  stop_shader_watch();
   glfwTerminate();
   return 0;
 }
@@ -0,0 +1,37 @@
+/******************************************************************************\
+| The little the tests need: CHECK counts a failure and says where, and each   |
+| test program returns check_result() from main, so ctest sees a non-zero      |
+| exit when anything failed.                                                   |
+\******************************************************************************/
+#ifndef _CHECK_H_
+#define _CHECK_H_
+
+#include <math.h>
+#include <stdio.h>
+
+static int g_check_failures = 0;
+
+#define CHECK( cond )                                                          \
+  do {                                                                         \
+    if ( !( cond ) ) {                                                         \
+      fprintf( stderr, "%s:%i: CHECK( %s ) failed\n", __FILE__, __LINE__, #cond ); \
+      g_check_failures++;                                                      \
+    }                                                                          \
+  } while ( 0 )
+
+// a and b agree to within tol, scaled up for large values
+inline bool check_near( float a, float b, float tol ) {
+  float scale = fabsf( a ) > fabsf( b ) ? fabsf( a ) : fabsf( b );
+  return fabsf( a - b ) <= tol * ( scale > 1.0f ? scale : 1.0f );
+}
+
+inline int check_result( const char* name ) {
+  if ( g_check_failures ) {
+    fprintf( stderr, "%s: %i check(s) failed\n", name, g_check_failures );
+    return 1;
+  }
+  printf( "%s: ok\n", name );
+  return 0;
+}
+
+#endif
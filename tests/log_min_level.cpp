@@ -0,0 +1,13 @@
+/* built into log_test with the compile-time floor at warn, to show plain
+gl_log is compiled out along with its arguments while gl_log_err stays */
+#define GL_LOG_MIN_LEVEL 3
+#include "logging.h"
+
+// how many of the two calls' arguments were evaluated
+int log_below_min_level()
+{
+  int evaluated = 0;
+  gl_log("compiled out %i\n", ++evaluated);
+  gl_log_err("kept %i\n", ++evaluated);
+  return evaluated;
+}
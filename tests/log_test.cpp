@@ -0,0 +1,283 @@
+/* checks the lock-free ring behind gl_log: with several threads logging at
+once every message is either written whole or counted as dropped, and each
+thread's messages come out in the order it logged them. also that
+GL_LOG_LEVELS and GL_LOG_MIN_LEVEL reach plain gl_log, that the writer
+lives through a log file it can't reopen, and that a log file that can't be
+opened at all isn't retried on every call. writes gl.log in the working
+directory.
+
+usage: log_test */
+#include <chrono>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "check.h"
+#include "logging.h"
+
+#define N_THREADS 8
+#define N_MESSAGES 5000
+
+// gl.log as it is on disk now
+static std::vector<std::string> read_log_lines()
+{
+  std::vector<std::string> lines;
+  FILE* f = fopen(GL_LOG_FILE, "r");
+  if (!f) {
+    return lines;
+  }
+  char line[GL_LOG_MSG_MAX + 2];
+  while (fgets(line, sizeof(line), f)) {
+    lines.push_back(line);
+  }
+  fclose(f);
+  return lines;
+}
+
+static bool log_contains(const char* text)
+{
+  for (const std::string& line : read_log_lines()) {
+    if (line.find(text) != std::string::npos) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// in log_min_level.cpp
+int log_below_min_level();
+
+// main sets GL_LOG_LEVELS=gl=warn before anything logs
+static void test_env_levels()
+{
+  CHECK(restart_gl_log());
+  CHECK(gl_log("info under gl=warn\n"));
+  gl_log_err("error under gl=warn\n");
+  gl_log_flush();
+  CHECK(!log_contains("info under gl=warn"));
+  CHECK(log_contains("error under gl=warn"));
+  CHECK(1 == log_below_min_level());
+  gl_log_set_level("gl", GL_LOG_LEVEL_TRACE);
+}
+
+// flush with a time limit, false if it never came back
+static bool flush_returns()
+{
+  std::atomic<bool> done(false);
+  std::thread flusher([&done]() {
+    gl_log_flush();
+    done = true;
+  });
+  for (int i = 0; i < 500 && !done; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  if (!done) {
+    fprintf(stderr, "gl_log_flush hung\n");
+    exit(1);
+  }
+  flusher.join();
+  return true;
+}
+
+/* swaps gl.log for a directory the rotation can neither remove nor open, so
+its fopen fails. the writer should carry on, flushes should still return,
+and once the file can be opened again logging resumes with a note of what
+was lost */
+static void test_failed_reopen()
+{
+  CHECK(restart_gl_log());
+  CHECK(gl_log("before the reopen fails\n"));
+  CHECK(flush_returns());
+  // the writer's handle outlives the name
+  remove(GL_LOG_FILE);
+  CHECK(0 == mkdir(GL_LOG_FILE, 0755));
+  FILE* f = fopen(GL_LOG_FILE "/keep", "w");
+  CHECK(f);
+  if (f) {
+    fclose(f);
+  }
+  // rotate before the next message, keeping no old files
+  gl_log_set_rotation(1, 0, 0);
+  unsigned long dropped_before = gl_log_dropped();
+  gl_log("lost while the file is shut\n");
+  gl_log("lost while the file is shut\n");
+  CHECK(flush_returns());
+  CHECK(gl_log_dropped() > dropped_before);
+  gl_log_set_rotation(8L * 1024 * 1024, 0, 5);
+  remove(GL_LOG_FILE "/keep");
+  CHECK(0 == rmdir(GL_LOG_FILE));
+  // the writer retries about once a second
+  std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+  CHECK(gl_log("after the file is back\n"));
+  CHECK(flush_returns());
+  CHECK(log_contains("after the file is back"));
+  CHECK(log_contains("[gl_log] dropped"));
+}
+
+/* with the writer stopped and gl.log a directory, the lazy start fails. the
+calls after it are dropped without trying the file again, even once it could
+be opened, until the retry time. restart_gl_log doesn't wait for that */
+static void test_failed_start()
+{
+  stop_gl_log();
+  remove(GL_LOG_FILE);
+  CHECK(0 == mkdir(GL_LOG_FILE, 0755));
+  FILE* f = fopen(GL_LOG_FILE "/keep", "w");
+  CHECK(f);
+  if (f) {
+    fclose(f);
+  }
+  unsigned long dropped_before = gl_log_dropped();
+  int logged = 0;
+  for (int i = 0; i < 1000; i++) {
+    logged += gl_log("no file to log to\n") ? 1 : 0;
+  }
+  CHECK(0 == logged);
+  CHECK(gl_log_dropped() - dropped_before == 1000);
+  remove(GL_LOG_FILE "/keep");
+  CHECK(0 == rmdir(GL_LOG_FILE));
+  CHECK(!gl_log("still waiting to retry\n"));
+  struct stat st;
+  CHECK(stat(GL_LOG_FILE, &st) != 0);
+  CHECK(restart_gl_log());
+  CHECK(gl_log("after the restart\n"));
+  gl_log_flush();
+  CHECK(log_contains("after the restart"));
+}
+
+static void test_ring()
+{
+  CHECK(restart_gl_log());
+  unsigned long dropped_before = gl_log_dropped();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < N_THREADS; t++) {
+    threads.emplace_back([t]() {
+      for (int i = 0; i < N_MESSAGES; i++) {
+	gl_log("ring %i %i\n", t, i);
+      }
+    });
+  }
+  for (std::thread& th : threads) {
+    th.join();
+  }
+  gl_log_flush();
+
+  int last[N_THREADS];
+  for (int t = 0; t < N_THREADS; t++) {
+    last[t] = -1;
+  }
+  long written = 0;
+  bool in_order = true;
+  bool whole = true;
+  for (const std::string& line : read_log_lines()) {
+    if (line.compare(0, 5, "ring ") != 0) {
+      continue;
+    }
+    int t = -1, i = -1;
+    char end = 0;
+    if (sscanf(line.c_str(), "ring %i %i%c", &t, &i, &end) != 3 ||
+	'\n' != end || t < 0 || t >= N_THREADS) {
+      whole = false;
+      continue;
+    }
+    in_order = in_order && i > last[t];
+    last[t] = i;
+    written++;
+  }
+  unsigned long dropped = gl_log_dropped() - dropped_before;
+  printf("%li written, %lu dropped\n", written, dropped);
+  CHECK(whole);
+  CHECK(in_order);
+  CHECK(written + (long)dropped == (long)N_THREADS * N_MESSAGES);
+}
+
+/* GL_LOG_BIN from several threads at once, enough to fill each thread's
+buffer many times over. every message is in gl.log.bin in its thread's
+order, or counted as dropped */
+static void test_bin()
+{
+  CHECK(restart_gl_log_bin());
+  unsigned long dropped_before = gl_log_dropped();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < N_THREADS; t++) {
+    threads.emplace_back([t]() {
+      for (int i = 0; i < N_MESSAGES; i++) {
+	GL_LOG_BIN("bin %i %i\n", t, i);
+      }
+    });
+  }
+  for (std::thread& th : threads) {
+    th.join();
+  }
+  gl_log_bin_flush();
+
+  FILE* f = fopen(GL_LOG_BIN_FILE, "rb");
+  CHECK(f);
+  if (!f) {
+    return;
+  }
+  std::vector<unsigned char> file;
+  unsigned char chunk[4096];
+  size_t got;
+  while ((got = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+    file.insert(file.end(), chunk, chunk + got);
+  }
+  fclose(f);
+  CHECK(file.size() >= 8 && 0 == memcmp(file.data(), GL_LOG_BIN_MAGIC, 4));
+
+  int last[N_THREADS];
+  for (int t = 0; t < N_THREADS; t++) {
+    last[t] = -1;
+  }
+  long written = 0;
+  bool in_order = true;
+  bool whole = true;
+  size_t at = 8;
+  while (whole && at < file.size()) {
+    unsigned char kind = file[at];
+    if (GL_LOG_BIN_SESSION == kind && at + 9 <= file.size()) {
+      at += 9;
+    } else if (GL_LOG_BIN_FORMAT == kind && at + 7 <= file.size()) {
+      uint16_t len;
+      memcpy(&len, &file[at + 5], 2);
+      at += 7 + len;
+    } else if (GL_LOG_BIN_MESSAGE == kind && at + 25 <= file.size() &&
+	       10 == file[at + 13] && 0 == file[at + 14] &&
+	       GL_LOG_BIN_I32 == file[at + 15] &&
+	       GL_LOG_BIN_I32 == file[at + 20]) {
+      int32_t t, i;
+      memcpy(&t, &file[at + 16], 4);
+      memcpy(&i, &file[at + 21], 4);
+      if (t < 0 || t >= N_THREADS) {
+	whole = false;
+	break;
+      }
+      in_order = in_order && i > last[t];
+      last[t] = i;
+      written++;
+      at += 25;
+    } else {
+      whole = false;
+    }
+  }
+  unsigned long dropped = gl_log_dropped() - dropped_before;
+  printf("bin: %li written, %lu dropped\n", written, dropped);
+  CHECK(whole);
+  CHECK(in_order);
+  CHECK(written + (long)dropped == (long)N_THREADS * N_MESSAGES);
+}
+
+int main()
+{
+  setenv("GL_LOG_LEVELS", "gl=warn", 1);
+  test_env_levels();
+  test_ring();
+  test_bin();
+  test_failed_reopen();
+  test_failed_start();
+  stop_gl_log();
+  return check_result("log_test");
+}
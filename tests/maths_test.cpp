@@ -0,0 +1,374 @@
+/* checks the mat4 kernels in math_funcs.h and math_batch.h against plain
+scalar loops written out here, and the half encoders in math_pack.h. built
+twice by CMake, once with the default SIMD backend and once with
+MATHS_NO_SIMD, so both backends are held to the same reference.
+
+usage: maths_test */
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "check.h"
+#include "math_batch.h"
+#include "math_funcs.h"
+#include "math_pack.h"
+#include "quat_batch.h"
+
+#define N_MATS 1000
+// not a multiple of 4 and past the batch threading threshold
+#define N_POINTS 70001
+#define TOL 1e-5f
+
+#if defined( MATHS_SIMD_SSE )
+#define BACKEND_NAME "sse"
+#elif defined( MATHS_SIMD_NEON )
+#define BACKEND_NAME "neon"
+#else
+#define BACKEND_NAME "scalar"
+#endif
+
+static float frand( float lo, float hi ) { return lo + ( hi - lo ) * ( (float)rand() / (float)RAND_MAX ); }
+
+static mat4 random_mat4() {
+  mat4 m;
+  for ( int i = 0; i < 16; i++ ) { m.m[i] = frand( -2.0f, 2.0f ); }
+  return m;
+}
+
+static mat4 random_affine() {
+  versor q = quat_from_axis_rad( frand( 0.0f, TAU ), frand( -1.0f, 1.0f ), frand( -1.0f, 1.0f ), frand( -1.0f, 1.0f ) );
+  q        = normalise( q );
+  return compose_trs( vec3( frand( -10.0f, 10.0f ), frand( -10.0f, 10.0f ), frand( -10.0f, 10.0f ) ), q,
+    vec3( frand( 0.5f, 2.0f ), frand( 0.5f, 2.0f ), frand( 0.5f, 2.0f ) ) );
+}
+
+/*-------------------------------REFERENCE------------------------------------*/
+// column-major like mat4, all in double so the library is the only error
+static void ref_mul( const mat4& a, const mat4& b, double* r ) {
+  for ( int col = 0; col < 4; col++ ) {
+    for ( int row = 0; row < 4; row++ ) {
+      double s = 0.0;
+      for ( int k = 0; k < 4; k++ ) { s += (double)a.m[k * 4 + row] * (double)b.m[col * 4 + k]; }
+      r[col * 4 + row] = s;
+    }
+  }
+}
+
+static void ref_mul_vec( const mat4& m, const float* v, double* r ) {
+  for ( int row = 0; row < 4; row++ ) {
+    double s = 0.0;
+    for ( int k = 0; k < 4; k++ ) { s += (double)m.m[k * 4 + row] * (double)v[k]; }
+    r[row] = s;
+  }
+}
+
+// Gauss-Jordan with partial pivoting. false when singular
+static bool ref_inverse( const mat4& m, double* r ) {
+  double a[4][8];
+  for ( int row = 0; row < 4; row++ ) {
+    for ( int col = 0; col < 4; col++ ) {
+      a[row][col]     = m.m[col * 4 + row];
+      a[row][col + 4] = row == col ? 1.0 : 0.0;
+    }
+  }
+  for ( int col = 0; col < 4; col++ ) {
+    int pivot = col;
+    for ( int row = col + 1; row < 4; row++ ) {
+      if ( fabs( a[row][col] ) > fabs( a[pivot][col] ) ) { pivot = row; }
+    }
+    if ( 0.0 == a[pivot][col] ) { return false; }
+    for ( int k = 0; k < 8; k++ ) {
+      double t    = a[col][k];
+      a[col][k]   = a[pivot][k];
+      a[pivot][k] = t;
+    }
+    double inv = 1.0 / a[col][col];
+    for ( int k = 0; k < 8; k++ ) { a[col][k] *= inv; }
+    for ( int row = 0; row < 4; row++ ) {
+      if ( row == col ) { continue; }
+      double f = a[row][col];
+      for ( int k = 0; k < 8; k++ ) { a[row][k] -= f * a[col][k]; }
+    }
+  }
+  for ( int row = 0; row < 4; row++ ) {
+    for ( int col = 0; col < 4; col++ ) { r[col * 4 + row] = a[row][col + 4]; }
+  }
+  return true;
+}
+
+static double ref_determinant( const mat4& m ) {
+  // Laplace expansion down column 0
+  double det = 0.0;
+  for ( int row = 0; row < 4; row++ ) {
+    double sub[9];
+    int n = 0;
+    for ( int col = 1; col < 4; col++ ) {
+      for ( int r = 0; r < 4; r++ ) {
+        if ( r != row ) { sub[n++] = m.m[col * 4 + r]; }
+      }
+    }
+    double minor = sub[0] * ( sub[4] * sub[8] - sub[7] * sub[5] ) - sub[3] * ( sub[1] * sub[8] - sub[7] * sub[2] ) +
+                   sub[6] * ( sub[1] * sub[5] - sub[4] * sub[2] );
+    det += ( row & 1 ? -1.0 : 1.0 ) * m.m[row] * minor;
+  }
+  return det;
+}
+
+static bool near_mat( const mat4& m, const double* r, float tol ) {
+  for ( int i = 0; i < 16; i++ ) {
+    if ( !check_near( m.m[i], (float)r[i], tol ) ) { return false; }
+  }
+  return true;
+}
+
+static bool near_mats( const mat4& a, const mat4& b, float tol ) {
+  for ( int i = 0; i < 16; i++ ) {
+    if ( !check_near( a.m[i], b.m[i], tol ) ) { return false; }
+  }
+  return true;
+}
+
+/*--------------------------------MAT4 TESTS----------------------------------*/
+static void test_mat4_ops() {
+  for ( int i = 0; i < N_MATS; i++ ) {
+    mat4 a = random_mat4();
+    mat4 b = random_mat4();
+    double r[16];
+    ref_mul( a, b, r );
+    CHECK( near_mat( a * b, r, TOL ) );
+
+    float v[4] = { frand( -5.0f, 5.0f ), frand( -5.0f, 5.0f ), frand( -5.0f, 5.0f ), frand( -5.0f, 5.0f ) };
+    vec4 mv    = a * vec4( v[0], v[1], v[2], v[3] );
+    double rv[4];
+    ref_mul_vec( a, v, rv );
+    for ( int k = 0; k < 4; k++ ) { CHECK( check_near( mv.v[k], (float)rv[k], TOL ) ); }
+
+    mat4 t = transpose( a );
+    for ( int col = 0; col < 4; col++ ) {
+      for ( int row = 0; row < 4; row++ ) { CHECK( t.m[col * 4 + row] == a.m[row * 4 + col] ); }
+    }
+
+    double det = ref_determinant( a );
+    CHECK( check_near( determinant( a ), (float)det, 1e-4f ) );
+    // well away from singular, so the float inverse is well conditioned
+    if ( fabs( det ) > 0.5 ) {
+      CHECK( ref_inverse( a, r ) );
+      CHECK( near_mat( inverse( a ), r, 1e-3f ) );
+    }
+  }
+}
+
+static void test_affine() {
+  for ( int i = 0; i < N_MATS; i++ ) {
+    mat4 a = random_affine();
+    mat4 b = random_affine();
+    CHECK( is_affine( a ) );
+    double r[16];
+    ref_mul( a, b, r );
+    CHECK( near_mat( mul_affine( a, b ), r, TOL ) );
+    CHECK( ref_inverse( a, r ) );
+    CHECK( near_mat( inverse_affine( a ), r, 1e-4f ) );
+    CHECK( near_mat( inverse( a ), r, 1e-4f ) );
+    bool invertible = false;
+    inverse_affine( a, &invertible );
+    CHECK( invertible );
+  }
+  // a flattened scale has no inverse: identity and a flag, not a guess
+  mat4 flat       = scale( translate( identity_mat4(), vec3( 1.0f, 2.0f, 3.0f ) ), vec3( 1.0f, 0.0f, 1.0f ) );
+  bool invertible = true;
+  CHECK( near_mats( inverse_affine( flat, &invertible ), identity_mat4(), 0.0f ) );
+  CHECK( !invertible );
+}
+
+/*-------------------------------BATCH TESTS----------------------------------*/
+static void test_batches() {
+  mat4 m = random_mat4();
+  std::vector<vec3> points( N_POINTS );
+  for ( int i = 0; i < N_POINTS; i++ ) { points[i] = vec3( frand( -5.0f, 5.0f ), frand( -5.0f, 5.0f ), frand( -5.0f, 5.0f ) ); }
+  // single threaded, threaded, and every tail length
+  int threads[] = { 1, 4 };
+  for ( int t = 0; t < 2; t++ ) {
+    std::vector<vec3> out( N_POINTS );
+    std::vector<vec3> dirs( N_POINTS );
+    transform_points( m, points.data(), out.data(), N_POINTS, threads[t] );
+    transform_directions( m, points.data(), dirs.data(), N_POINTS, threads[t] );
+    int bad = 0;
+    for ( int i = 0; i < N_POINTS; i++ ) {
+      float p[4] = { points[i].v[0], points[i].v[1], points[i].v[2], 1.0f };
+      double r[4];
+      ref_mul_vec( m, p, r );
+      double d[4];
+      p[3] = 0.0f;
+      ref_mul_vec( m, p, d );
+      for ( int k = 0; k < 3; k++ ) {
+        if ( !check_near( out[i].v[k], (float)r[k], TOL ) ) { bad++; }
+        if ( !check_near( dirs[i].v[k], (float)d[k], TOL ) ) { bad++; }
+      }
+    }
+    CHECK( 0 == bad );
+  }
+  // batch_for_chunks: every element once, chunks on their boundaries, and a
+  // call from inside a chunk runs there rather than waiting on the pool
+  std::vector<int> hits( N_POINTS, 0 );
+  int misaligned = 0;
+  batch_for_chunks( N_POINTS, 1000, 4, [&]( int begin, int end ) {
+    if ( begin % 1000 != 0 || end - begin > 1000 ) { misaligned++; }
+    batch_for_chunks( end - begin, 100, 4, [&]( int b, int e ) {
+      for ( int i = begin + b; i < begin + e; i++ ) { hits[i]++; }
+    } );
+  } );
+  int wrong = 0;
+  for ( int i = 0; i < N_POINTS; i++ ) {
+    if ( 1 != hits[i] ) { wrong++; }
+  }
+  CHECK( 0 == misaligned );
+  CHECK( 0 == wrong );
+
+  // empty input doesn't touch in[0]
+  transform_points( m, (const vec3*)NULL, (vec3*)NULL, 0, 4 );
+  transform_directions( m, (const vec3*)NULL, (vec3*)NULL, 0, 4 );
+  for ( int count = 0; count < 9; count++ ) {
+    std::vector<float> flat( 3 * 9 );
+    for ( int i = 0; i < 3 * 9; i++ ) { flat[i] = frand( -5.0f, 5.0f ); }
+    std::vector<float> out( 3 * 9, 123.0f );
+    transform_points( m, flat.data(), out.data(), count );
+    for ( int i = 0; i < count; i++ ) {
+      float p[4] = { flat[i * 3], flat[i * 3 + 1], flat[i * 3 + 2], 1.0f };
+      double r[4];
+      ref_mul_vec( m, p, r );
+      for ( int k = 0; k < 3; k++ ) { CHECK( check_near( out[i * 3 + k], (float)r[k], TOL ) ); }
+    }
+    // nothing past count is touched
+    for ( int i = count * 3; i < 3 * 9; i++ ) { CHECK( 123.0f == out[i] ); }
+  }
+
+  std::vector<mat4> a( N_MATS ), b( N_MATS ), out( N_MATS ), out2( N_MATS );
+  for ( int i = 0; i < N_MATS; i++ ) {
+    a[i] = random_mat4();
+    b[i] = random_mat4();
+  }
+  mul_mat4_array( m, a.data(), out.data(), N_MATS, 4 );
+  mul_mat4_arrays( a.data(), b.data(), out2.data(), N_MATS, 4 );
+  int bad = 0;
+  for ( int i = 0; i < N_MATS; i++ ) {
+    double r[16];
+    ref_mul( m, a[i], r );
+    if ( !near_mat( out[i], r, TOL ) ) { bad++; }
+    ref_mul( a[i], b[i], r );
+    if ( !near_mat( out2[i], r, TOL ) ) { bad++; }
+  }
+  CHECK( 0 == bad );
+
+  std::vector<versor> q( 13 );
+  std::vector<mat4> qm( 13 );
+  for ( int i = 0; i < 13; i++ ) {
+    q[i] = quat_from_axis_rad( frand( 0.0f, TAU ), frand( -1.0f, 1.0f ), frand( -1.0f, 1.0f ), frand( -1.0f, 1.0f ) );
+    q[i] = normalise( q[i] );
+  }
+  quat_to_mat4_batch( q.data(), qm.data(), 13 );
+  for ( int i = 0; i < 13; i++ ) { CHECK( near_mats( qm[i], quat_to_mat4( q[i] ), TOL ) ); }
+}
+
+/*--------------------------------HALF TESTS----------------------------------*/
+static uint32_t float_bits( float f ) {
+  uint32_t x;
+  memcpy( &x, &f, 4 );
+  return x;
+}
+
+static float bits_float( uint32_t x ) {
+  float f;
+  memcpy( &f, &x, 4 );
+  return f;
+}
+
+static bool is_half_nan( uint16_t h ) { return ( h & 0x7c00u ) == 0x7c00u && ( h & 0x3ffu ); }
+
+static void test_half() {
+  // every half survives a trip through float, nans stay nans
+  std::vector<uint16_t> all( 65536 );
+  std::vector<float> decoded( 65536 );
+  for ( int i = 0; i < 65536; i++ ) { all[i] = (uint16_t)i; }
+  decode_half( all.data(), decoded.data(), 65536 );
+  int bad = 0;
+  for ( int i = 0; i < 65536; i++ ) {
+    uint16_t h = (uint16_t)i;
+    float f    = half_to_float( h );
+    if ( float_bits( f ) != float_bits( decoded[i] ) ) { bad++; }
+    uint16_t back = float_to_half( f );
+    if ( is_half_nan( h ) ? !is_half_nan( back ) : back != h ) { bad++; }
+  }
+  CHECK( 0 == bad );
+  std::vector<uint16_t> encoded( 65536 );
+  encode_half( decoded.data(), encoded.data(), 65536 );
+  bad = 0;
+  for ( int i = 0; i < 65536; i++ ) {
+    if ( is_half_nan( all[i] ) ? !is_half_nan( encoded[i] ) : encoded[i] != all[i] ) { bad++; }
+  }
+  CHECK( 0 == bad );
+
+  // round to nearest even, at normal and subnormal ties
+  CHECK( 0x3c00u == float_to_half( 1.0f + 1.0f / 2048.0f ) );
+  CHECK( 0x3c02u == float_to_half( 1.0f + 3.0f / 2048.0f ) );
+  CHECK( 0x3c01u == float_to_half( bits_float( float_bits( 1.0f + 1.0f / 2048.0f ) + 1 ) ) );
+  CHECK( 0x0001u == float_to_half( ldexpf( 1.0f, -24 ) ) );
+  CHECK( 0x0000u == float_to_half( ldexpf( 1.0f, -25 ) ) );
+  CHECK( 0x0001u == float_to_half( bits_float( float_bits( ldexpf( 1.0f, -25 ) ) + 1 ) ) );
+  CHECK( 0x0002u == float_to_half( ldexpf( 3.0f, -25 ) ) );
+  CHECK( 0x8000u == float_to_half( -0.0f ) );
+  // overflow
+  CHECK( 0x7bffu == float_to_half( 65504.0f ) );
+  CHECK( 0x7bffu == float_to_half( 65519.0f ) );
+  CHECK( 0x7c00u == float_to_half( 65520.0f ) );
+  CHECK( 0xfc00u == float_to_half( -1e10f ) );
+
+  // the batch encoder (F16C where built with it) against the scalar one, on
+  // arbitrary bit patterns
+  std::vector<float> in( 100003 );
+  for ( size_t i = 0; i < in.size(); i++ ) { in[i] = bits_float( ( (uint32_t)rand() << 16 ) ^ (uint32_t)rand() ); }
+  std::vector<uint16_t> out( in.size() );
+  encode_half( in.data(), out.data(), (int)in.size() );
+  bad = 0;
+  for ( size_t i = 0; i < in.size(); i++ ) {
+    uint16_t h = float_to_half( in[i] );
+    if ( is_half_nan( h ) ? !is_half_nan( out[i] ) : out[i] != h ) { bad++; }
+  }
+  CHECK( 0 == bad );
+}
+
+/*------------------------------CONSTEXPR LIBM--------------------------------*/
+static bool same_float( float a, float b ) { return a != a ? b != b : float_bits( a ) == float_bits( b ); }
+
+static void test_constexpr_libm() {
+  // the compile-time sqrt against sqrtf, edges then arbitrary positive floats
+  float edges[] = { 0.0f, -0.0f, -1.0f, 1e-45f, 1e-38f, 0.25f, 1.0f, 2.0f, 3.999999f, 4.0f, 1e37f, 3e38f, 3.4028235e38f, INFINITY, -INFINITY, NAN };
+  for ( float x : edges ) { CHECK( same_float( maths_sqrt_newton( x ), sqrtf( x ) ) ); }
+  int bad = 0;
+  for ( int i = 0; i < 100000; i++ ) {
+    float x = bits_float( ( ( (uint32_t)rand() << 16 ) ^ (uint32_t)rand() ) & 0x7fffffffu );
+    if ( !same_float( maths_sqrt_newton( x ), sqrtf( x ) ) ) { bad++; }
+    if ( !same_float( maths_sqrt( x ), sqrtf( x ) ) ) { bad++; }
+  }
+  CHECK( 0 == bad );
+  for ( int i = -80; i <= 80; i++ ) {
+    float x = (float)i / 100.0f;
+    CHECK( check_near( maths_tan_series( x ), tanf( x ), 1e-6f ) );
+    CHECK( same_float( maths_tan( x ), tanf( x ) ) );
+  }
+#if defined( MATHS_IS_CONSTANT_EVALUATED )
+  constexpr float root = maths_sqrt( 3e38f );
+  CHECK( same_float( root, sqrtf( 3e38f ) ) );
+  constexpr mat4 proj = perspective( 67.0f, 1.333f, 0.1f, 100.0f );
+  CHECK( near_mats( proj, perspective( 67.0f, 1.0f * 1.333f, 0.1f, 100.0f ), 1e-6f ) );
+#endif
+}
+
+int main() {
+  srand( 1 );
+  printf( "maths backend: %s\n", BACKEND_NAME );
+  test_mat4_ops();
+  test_affine();
+  test_batches();
+  test_half();
+  test_constexpr_libm();
+  return check_result( "maths_test" );
+}
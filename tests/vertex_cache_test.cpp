@@ -0,0 +1,118 @@
+/* checks the index optimisers in vertex_cache.h only ever permute: the
+cache pass keeps every triangle (and its winding), the fetch pass is a
+renumbering.
+
+usage: vertex_cache_test */
+#include <algorithm>
+#include <stdlib.h>
+#include <vector>
+#include "check.h"
+#include "vertex_cache.h"
+
+#define GRID 64
+
+// a GRID x GRID quad grid, triangles shuffled so there's work to do
+static std::vector<uint32_t> shuffled_grid()
+{
+  std::vector<uint32_t> tris;
+  for (int y = 0; y < GRID; y++) {
+    for (int x = 0; x < GRID; x++) {
+      uint32_t i = y * (GRID + 1) + x;
+      uint32_t quad[6] = {i, i + 1, i + GRID + 1, i + 1, i + GRID + 2,
+			  i + GRID + 1};
+      tris.insert(tris.end(), quad, quad + 6);
+    }
+  }
+  int n = (int)tris.size() / 3;
+  for (int i = n - 1; i > 0; i--) {
+    int j = rand() % (i + 1);
+    for (int k = 0; k < 3; k++) {
+      std::swap(tris[i * 3 + k], tris[j * 3 + k]);
+    }
+  }
+  return tris;
+}
+
+// each triangle rotated to start at its smallest index, winding kept, sorted
+static std::vector<std::vector<uint32_t> >
+canonical(const std::vector<uint32_t>& indices)
+{
+  std::vector<std::vector<uint32_t> > out;
+  for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+    const uint32_t* p = &indices[t];
+    int first = 0;
+    if (p[1] < p[first]) {
+      first = 1;
+    }
+    if (p[2] < p[first]) {
+      first = 2;
+    }
+    out.push_back({p[first], p[(first + 1) % 3], p[(first + 2) % 3]});
+  }
+  std::sort(out.begin(), out.end());
+  return out;
+}
+
+static void test_cache()
+{
+  std::vector<uint32_t> before = shuffled_grid();
+  std::vector<uint32_t> after = before;
+  int vertex_count = (GRID + 1) * (GRID + 1);
+  optimize_vertex_cache(after.data(), (int)after.size(), vertex_count);
+  CHECK(canonical(before) == canonical(after));
+  float acmr_before = vertex_cache_acmr(before.data(), (int)before.size(), 16);
+  float acmr_after = vertex_cache_acmr(after.data(), (int)after.size(), 16);
+  printf("grid acmr %.3f -> %.3f\n", acmr_before, acmr_after);
+  CHECK(acmr_after < acmr_before);
+  CHECK(acmr_after < 1.0f);
+
+  // too little to reorder, left alone
+  uint32_t one[3] = {2, 0, 1};
+  optimize_vertex_cache(one, 3, 3);
+  CHECK(2 == one[0] && 0 == one[1] && 1 == one[2]);
+}
+
+static void test_fetch()
+{
+  std::vector<uint32_t> before = shuffled_grid();
+  std::vector<uint32_t> after = before;
+  // a few vertices nothing uses, which go last
+  int vertex_count = (GRID + 1) * (GRID + 1) + 5;
+  std::vector<uint32_t> remap(vertex_count);
+  optimize_vertex_fetch(after.data(), (int)after.size(), vertex_count,
+			remap.data());
+  std::vector<bool> seen(vertex_count, false);
+  bool permutation = true;
+  for (int v = 0; v < vertex_count; v++) {
+    if (remap[v] >= (uint32_t)vertex_count || seen[remap[v]]) {
+      permutation = false;
+      break;
+    }
+    seen[remap[v]] = true;
+  }
+  CHECK(permutation);
+  for (int v = vertex_count - 5; v < vertex_count; v++) {
+    CHECK(remap[v] >= (uint32_t)(vertex_count - 5));
+  }
+  bool mapped = true;
+  bool first_use_order = true;
+  uint32_t next = 0;
+  for (size_t i = 0; i < before.size(); i++) {
+    mapped = mapped && after[i] == remap[before[i]];
+    if (after[i] == next) {
+      next++;
+    } else if (after[i] > next) {
+      first_use_order = false;
+    }
+  }
+  CHECK(mapped);
+  CHECK(first_use_order);
+}
+
+int main()
+{
+  srand(1);
+  test_cache();
+  test_fetch();
+  return check_result("vertex_cache_test");
+}
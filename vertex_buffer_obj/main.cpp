@@ -4,6 +4,10 @@
 #include <cassert>
 #include "logging.h"
 #include "gl_utils.h"
+#include "math_pack.h"
+#include "mesh.h"
+#include "shader_program.h"
+#include "shader_watch.h"
 
 int g_gl_width = 640;
 int g_gl_height = 480;
@@ -15,7 +19,9 @@ int main()
   
   assert(restart_gl_log());
   restart_gl_log();
-  start_gl();
+  if (!start_gl()) {
+    return 1;
+  }
   
 
   // tell GL to only draw onto a pixel if the shape is closer to the viewer
@@ -34,82 +40,30 @@ int main()
 		       0.0f, 0.0f, 1.0f
   };
 
-  GLuint points_vbo = 0; // our vertex buffer
-  glGenBuffers (1, &points_vbo); // set as the current buffer
-  glBindBuffer (GL_ARRAY_BUFFER, points_vbo);
-  glBufferData (GL_ARRAY_BUFFER, 9 * sizeof (GLfloat), points, GL_STATIC_DRAW);
-
-  GLuint colours_vbo = 0;
-  glGenBuffers(1, &colours_vbo);
-  glBindBuffer(GL_ARRAY_BUFFER, colours_vbo);
-  glBufferData(GL_ARRAY_BUFFER, 9 * sizeof (GLfloat), colours, GL_STATIC_DRAW);
-
-  GLuint vao = 0; 
-  glGenVertexArrays (1, &vao); 
-  glBindVertexArray(vao); 
-  glBindBuffer(GL_ARRAY_BUFFER, points_vbo); 
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-  glBindBuffer(GL_ARRAY_BUFFER, colours_vbo);
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-
-  glEnableVertexAttribArray(0); // points_vbo
-  glEnableVertexAttribArray(1); // colours_vbo
-
-  char vertex_shader[1024 * 256];
-  char fragment_shader[1024 * 256];  
-  parse_file_into_str("test2_vs.glsl", vertex_shader, 1024 * 256);
-  parse_file_into_str("test2_fs.glsl", fragment_shader, 1024 * 256);
-
-  const GLchar* p;
-  
-  GLuint vs = glCreateShader (GL_VERTEX_SHADER);
-  p = (const GLchar*)vertex_shader;
-  glShaderSource (vs, 1, &p, NULL);
-  glCompileShader(vs);
-
-  // check for compile errors
-  int params = -1;
-  glGetShaderiv(vs, GL_COMPILE_STATUS, &params);
-  if (GL_TRUE != params) {
-    fprintf(stderr, "ERROR: GL shader index %i did not compile\n",
-	    vs);
-    _print_shader_info_log(vs);
-    return -1;
-  }
-  
-  GLuint fs = glCreateShader (GL_FRAGMENT_SHADER);
-  p = (const GLchar*)fragment_shader;
-  glShaderSource (fs, 1, &p, NULL);
-  glCompileShader(fs);
-  params = -1;
-  glGetShaderiv(vs, GL_COMPILE_STATUS, &params);
-  if (GL_TRUE != params) {
-    fprintf(stderr, "ERROR: GL shader index %i did not compile\n",
-	    fs);
-    _print_shader_info_log(fs);
-    return false;
+  // half-float positions and byte colours, interleaved: 12 bytes a vertex
+  // where the two float buffers took 24
+  uint16_t half_points[9];
+  encode_half(points, half_points, 9);
+  uint8_t byte_colours[3 * 4];
+  encode_colours_unorm8(colours, 3, byte_colours, 3);
+  vertex_layout layout;
+  layout.add_half(0, 3).add_colour_unorm8(1);
+  const void* streams[] = {half_points, byte_colours};
+  const uint32_t indices[] = {0, 1, 2};
+  mesh triangle;
+  if (!triangle.create(layout, streams, 3, indices, 3)) {
+    return 1;
   }
-  
-  GLuint shader_programme = glCreateProgram();
-  glAttachShader (shader_programme, fs);
-  glAttachShader (shader_programme, vs);
 
-  // location binding code
-  glBindAttribLocation (shader_programme, 0, "vertex_position");
-  glBindAttribLocation (shader_programme, 1, "vertex_colour");
-  
-  glLinkProgram (shader_programme);
-
-  params = -1;
-  glGetProgramiv(shader_programme, GL_LINK_STATUS, &params);
-  if (GL_TRUE != params) {
-    fprintf(stderr, "ERROR: could not link shader programm GL index %u\n",
-	    shader_programme);
-    _print_programme_info_log(shader_programme);
-    return false;
+  shader_program programme;
+  programme.add_stage_file(GL_VERTEX_SHADER, "test2_vs.glsl");
+  programme.add_stage_file(GL_FRAGMENT_SHADER, "test2_fs.glsl");
+  if (!programme.build()) {
+    return 1;
   }
-  
-  bool result = is_valid(shader_programme);
+  // edits to the .glsl files are picked up while it runs
+  watch_shader_program(&programme);
+  bool result = is_valid(programme.id());
   assert(result);
 
   glEnable (GL_CULL_FACE); // cull face
@@ -117,25 +71,22 @@ int main()
   glFrontFace (GL_CW); // GL_CCW for counter clock-wise
 
   // draw our triangle
-  while(!glfwWindowShouldClose (g_window)) {
+  while(!gl_should_close()) {
     //    _update_fps_counter(window);
       //wipe the drawing surface clear
       glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
       glViewport(0, 0, g_gl_width, g_gl_height);
-      glUseProgram(shader_programme);
-      glBindVertexArray(vao);
-      glDrawArrays(GL_TRIANGLES, 0, 3);
-      //update other events like input handling
-      glfwPollEvents();
-      if (GLFW_PRESS == glfwGetKey(g_window, GLFW_KEY_ESCAPE))
+      programme.use();
+      triangle.draw();
+      if (gl_key_pressed(GLFW_KEY_ESCAPE))
 	{
-	  glfwSetWindowShouldClose(g_window, 1);
+	  gl_request_close();
 	}
-      //put the stuff we've been drawing onto the display
-      glfwSwapBuffers (g_window);
+      //put the stuff we've been drawing onto the display, poll input
+      gl_end_frame();
     }
   
   // close GL context and any other GLFW resources
-  glfwTerminate();
+  stop_gl();
   return 0;
 }
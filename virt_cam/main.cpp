@@ -5,7 +5,13 @@
 #define _USE_MATH_DEFINES
 #include <math.h>
 #include "math_funcs.h"
+#include "math_pack.h"
+#include "frustum.h"
 #include "gl_utils.h"
+#include "mesh.h"
+#include "shader_program.h"
+#include "shader_watch.h"
+#include "frame_uniforms.h"
 #include "logging.h"
 
 int g_gl_width = 640;
@@ -15,8 +21,9 @@ GLFWwindow* g_window;
 int main()
 {
   assert(restart_gl_log());
-  gl_log("starting GLFW\n%s\n", glfwGetVersionString());
-  start_gl();
+  if (!start_gl()) {
+    return 1;
+  }
 
   GLfloat points[] = {
 		      0.0f, 0.5f, 0.0f, // top point
@@ -30,102 +37,43 @@ int main()
 		       0.0f, 0.0f, 1.0f
   };
 
-  GLuint points_vbo = 0; // our vertex buffer
-  glGenBuffers (1, &points_vbo); // set as the current buffer
-  glBindBuffer (GL_ARRAY_BUFFER, points_vbo);
-  glBufferData (GL_ARRAY_BUFFER, 9 * sizeof (GLfloat),
-		points, GL_STATIC_DRAW);
-
-  GLuint colours_vbo = 0; // our vertex buffer
-  glGenBuffers (1, &colours_vbo); // set as the current buffer
-  glBindBuffer (GL_ARRAY_BUFFER, colours_vbo);
-  glBufferData (GL_ARRAY_BUFFER, 9 * sizeof (GLfloat),
-		colours, GL_STATIC_DRAW);
-
-  
-  GLuint vao = 0; // our mesh aka vertext array
-  glGenVertexArrays (1, &vao); // turn vao into a mesh
-  glBindVertexArray(vao); // make it current mesh
-  glBindBuffer(GL_ARRAY_BUFFER, points_vbo);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-  glBindBuffer(GL_ARRAY_BUFFER, colours_vbo);
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-  glEnableVertexAttribArray(0);
-  glEnableVertexAttribArray(1);
-
-
-  char vertex_shader[1024 * 256];
-  char fragment_shader[1024 * 256];
-  parse_file_into_str("test5_vs.glsl", vertex_shader, 1024 * 256);
-  parse_file_into_str("test5_fs.glsl", fragment_shader, 1024 * 256);
-  
-  
-  const GLchar* p = NULL;
-  
-  GLuint vs = glCreateShader (GL_VERTEX_SHADER);
-  p = (const GLchar*)vertex_shader;
-  glShaderSource (vs, 1, &p, NULL);
-  glCompileShader(vs);
-
-  // check for compile errors
-  int params = -1;
-  glGetShaderiv(vs, GL_COMPILE_STATUS, &params);
-  if (GL_TRUE != params) {
-    fprintf(stderr, "ERROR: GL shader index %i did not compile\n",
-	    vs);
-    _print_shader_info_log(vs);
-    return -1;
+  // half-float positions and byte colours, interleaved: 12 bytes a vertex
+  // where the two float buffers took 24
+  uint16_t half_points[9];
+  encode_half(points, half_points, 9);
+  uint8_t byte_colours[3 * 4];
+  encode_colours_unorm8(colours, 3, byte_colours, 3);
+  vertex_layout layout;
+  layout.add_half(0, 3).add_colour_unorm8(1);
+  const void* streams[] = {half_points, byte_colours};
+  const uint32_t indices[] = {0, 1, 2};
+  mesh triangle;
+  if (!triangle.create(layout, streams, 3, indices, 3)) {
+    return 1;
   }
-  
-  GLuint fs = glCreateShader (GL_FRAGMENT_SHADER);
-  p = (const GLchar*)fragment_shader;
-  glShaderSource (fs, 1, &p, NULL);
-  glCompileShader(fs);
 
-  
-  glGetShaderiv(vs, GL_COMPILE_STATUS, &params);
-  if (GL_TRUE != params) {
-    fprintf(stderr, "ERROR: GL shader index %i did not compile\n",
-	    fs);
-    _print_shader_info_log(fs);
-    return false;
-  }
-  
-  GLuint shader_programme = glCreateProgram();
-  glAttachShader (shader_programme, fs);
-  glAttachShader (shader_programme, vs);
-  glLinkProgram (shader_programme);
-
-  glGetProgramiv(shader_programme, GL_LINK_STATUS, &params);
-  if (GL_TRUE != params) {
-    fprintf(stderr, "ERROR: could not link shader programm GL index %u\n",
-	    shader_programme);
-    _print_programme_info_log(shader_programme);
-    return false;
+
+  // before the build, so the program gets its frame_block bound
+  start_frame_uniforms();
+  shader_program programme;
+  programme.add_stage_file(GL_VERTEX_SHADER, "test5_vs.glsl");
+  programme.add_stage_file(GL_FRAGMENT_SHADER, "test5_fs.glsl");
+  if (!programme.build()) {
+    return 1;
   }
-  
-  bool result = is_valid(shader_programme);
+  // edits to the .glsl files are picked up while it runs
+  watch_shader_program(&programme);
+  bool result = is_valid(programme.id());
   assert(result);
 
-    // input variables
-  float near = 0.1f; // clipping plane
-  float far = 100.0f; // clipping plane
-  float fov = 67.0f * ONE_DEG_IN_RAD; // convert 67 deg to rad
+  // input variables
+  const float near = 0.1f; // clipping plane
+  const float far = 100.0f; // clipping plane
+  const float fov = 67.0f; // field of view in degrees
   float aspect = (float)g_gl_width / (float)g_gl_height; // aspect ratio
-  // matrix components
-  float inverse_range = 1.0f/tan (fov * 0.5f);
-  float Sx = inverse_range / aspect;
-  float Sy = inverse_range;
-  float Sz = -(far + near) / (far - near);
-  float Pz = -(2.0f * far * near) / (far - near);
-
-
-  GLfloat proj_mat[] = {
-		      Sx, 0.0f, 0.0f, 0.0f,
-		      0.0f, Sy, 0.0f, 0.0f,
-		      0.0f, 0.0f, Sz, -1.0f,
-		      0.0f, 0.0f, Pz, 0.0f
-  };
+  // perspective() is constexpr, with a constant aspect this is a
+  // compile-time matrix
+  mat4 proj_mat = perspective(fov, aspect, near, far);
 
 
   // virtual camera section
@@ -137,24 +85,23 @@ int main()
   mat4 T = translate(identity_mat4(), vec3(-cam_pos[0], -cam_pos[1],
 					 -cam_pos[2]));
   mat4 R = rotate_y_deg(identity_mat4(), -cam_yaw);
-  mat4 view_mat = R * T;
+  mat4 view_mat = mul_affine( R, T );
 
 
-  GLint view_mat_location = glGetUniformLocation(shader_programme, "view");
-  GLint proj_mat_location = glGetUniformLocation(shader_programme, "proj");
-  glUseProgram(shader_programme);
-  glUniformMatrix4fv(view_mat_location, 1, GL_FALSE, view_mat.m);
-  glUniformMatrix4fv(proj_mat_location, 1, GL_FALSE, proj_mat);
+  // skip the draw when the triangle's bounding sphere is off screen
+  const vec3 tri_centre(0.0f, 0.0f, 0.0f);
+  const float tri_radius = 0.71f; // corners are at most sqrt(0.5) away
+  frustum view_frustum = frustum_from_mat4(proj_mat * view_mat);
 
   glEnable (GL_CULL_FACE); // cull face
   glCullFace (GL_BACK); // cull back face
   glFrontFace (GL_CW); // GL_CCW for counter clock-wise
 
   // draw our triangle
-  while(!glfwWindowShouldClose (g_window)) {
+  while(!gl_should_close()) {
     // add a timer for amimation
-    static double previous_seconds = glfwGetTime();
-    double current_seconds         = glfwGetTime();
+    static double previous_seconds = gl_get_time();
+    double current_seconds         = gl_get_time();
     double elapsed_seconds          = current_seconds - previous_seconds;
     previous_seconds               = current_seconds;
     
@@ -162,46 +109,45 @@ int main()
     //wipe the drawing surface clear
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glViewport(0, 0, g_gl_width, g_gl_height);
+    update_frame_uniforms(view_mat, proj_mat, g_gl_width, g_gl_height,
+			  (float)current_seconds, (float)elapsed_seconds);
 
-
-    glUseProgram(shader_programme);
+    programme.use();
     
 
-    glBindVertexArray(vao);
-    //draw points 0-3 from the currently bound VAO with current in-use shader
-    glDrawArrays(GL_TRIANGLES, 0, 3);
-    //update other events like input handling
-    glfwPollEvents();
+    if (frustum_sphere_visible(view_frustum, tri_centre, tri_radius)) {
+      triangle.draw();
+    }
     bool cam_moved = false;
-    if ( glfwGetKey( g_window, GLFW_KEY_A ) ) {
+    if ( gl_key_pressed( GLFW_KEY_A ) ) {
       cam_pos[0] -= cam_speed * elapsed_seconds;
       cam_moved = true;
     }
-    if ( glfwGetKey( g_window, GLFW_KEY_D ) ) {
+    if ( gl_key_pressed( GLFW_KEY_D ) ) {
       cam_pos[0] += cam_speed * elapsed_seconds;
       cam_moved = true;
     }
-    if ( glfwGetKey( g_window, GLFW_KEY_PAGE_UP ) ) {
+    if ( gl_key_pressed( GLFW_KEY_PAGE_UP ) ) {
       cam_pos[1] += cam_speed * elapsed_seconds;
       cam_moved = true;
     }
-    if ( glfwGetKey( g_window, GLFW_KEY_PAGE_DOWN ) ) {
+    if ( gl_key_pressed( GLFW_KEY_PAGE_DOWN ) ) {
       cam_pos[1] -= cam_speed * elapsed_seconds;
       cam_moved = true;
     }
-    if ( glfwGetKey( g_window, GLFW_KEY_W ) ) {
+    if ( gl_key_pressed( GLFW_KEY_W ) ) {
       cam_pos[2] -= cam_speed * elapsed_seconds;
       cam_moved = true;
     }
-    if ( glfwGetKey( g_window, GLFW_KEY_S ) ) {
+    if ( gl_key_pressed( GLFW_KEY_S ) ) {
       cam_pos[2] += cam_speed * elapsed_seconds;
       cam_moved = true;
     }
-    if ( glfwGetKey( g_window, GLFW_KEY_LEFT ) ) {
+    if ( gl_key_pressed( GLFW_KEY_LEFT ) ) {
       cam_yaw += cam_yaw_speed * elapsed_seconds;
       cam_moved = true;
     }
-    if ( glfwGetKey( g_window, GLFW_KEY_RIGHT ) ) {
+    if ( gl_key_pressed( GLFW_KEY_RIGHT ) ) {
       cam_yaw -= cam_yaw_speed * elapsed_seconds;
       cam_moved = true;
     }
@@ -213,19 +159,20 @@ int main()
 				-cam_pos[2] ) ); // cam translation
       mat4 R = rotate_y_deg( identity_mat4(),
 			     -cam_yaw );     //
-      mat4 view_mat = R * T;
-      glUniformMatrix4fv( view_mat_location, 1, GL_FALSE, view_mat.m );
+      view_mat = mul_affine( R, T );
+      view_frustum = frustum_from_mat4( proj_mat * view_mat );
     }
 
-    if (GLFW_PRESS == glfwGetKey(g_window, GLFW_KEY_ESCAPE))
+    if (gl_key_pressed(GLFW_KEY_ESCAPE))
       {
-	glfwSetWindowShouldClose(g_window, 1);
+	gl_request_close();
       }
-    //put the stuff we've been drawing onto the display
-    glfwSwapBuffers (g_window);
+    //put the stuff we've been drawing onto the display, poll input
+    gl_end_frame();
   }
   
   // close GL context and any other GLFW resources
-  glfwTerminate();
+  stop_frame_uniforms();
+  stop_gl();
   return 0;
 }